@@ -0,0 +1,559 @@
+/*
+    Benchmark suite, built with optimisations by `make bench`. Measures
+    training and inference throughput for several topologies, per layer
+    GFLOP/s, and the data loading and generation functions. Prints a summary
+    and writes the results as JSON, by default to bench.json, for tracking
+    regressions between versions.
+
+    Also checks that a steady state training step makes no heap allocations,
+    by counting every call to the global operator new. Exits with status 1 if
+    any step allocates.
+
+    Usage: ./bin/bench.out [output.json] [mnist data directory]
+*/
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "src/neural_network.h"
+#include "src/data_parallel.h"
+#include "src/inference.h"
+#include "src/quantized.h"
+#include "src/sparse_network.h"
+#include "src/static_network.h"
+#include "src/load_data.h"
+#include "src/tank_counting.h"
+#include "src/counter_rng.h"
+#include "src/kernels/kernels.h"
+
+// =======================================
+// Allocation Counting
+// =======================================
+
+// Calls to the global operator new on any thread, AlignedVector included
+std::atomic<long> g_allocations{0};
+
+void* operator new(std::size_t size) {
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    void* ptr = std::malloc(size == 0 ? 1 : size);
+    if (ptr == nullptr) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment) {
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    // aligned_alloc requires the size to be a multiple of the alignment
+    const std::size_t align = static_cast<std::size_t>(alignment);
+    const std::size_t bytes = (size + align - 1) / align * align;
+    void* ptr = std::aligned_alloc(align, bytes == 0 ? align : bytes);
+    if (ptr == nullptr) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+void operator delete(void* ptr, std::size_t) noexcept { std::free(ptr); }
+void operator delete(void* ptr, std::align_val_t) noexcept { std::free(ptr); }
+void operator delete(void* ptr, std::size_t, std::align_val_t) noexcept {
+    std::free(ptr);
+}
+
+namespace {
+
+// Minimum time spent measuring each result
+constexpr double kMinSeconds = 0.1;
+// Samples per batch of the batched measurements
+constexpr int kBatchSize = 64;
+// Fraction of the weights pruned for the sparse inference measurements
+constexpr double kBenchSparsity = 0.9;
+// Seed of every random input, so each run measures the same values
+constexpr uint64_t kBenchSeed = 1;
+
+/// @brief Calls fn repeatedly, doubling the number of calls until they take
+///        at least kMinSeconds, after one untimed warm up call
+/// @return mean seconds per call
+template<typename Function>
+double SecondsPerCall(Function&& fn) {
+    using Clock = std::chrono::steady_clock;
+    fn();
+    long calls = 1;
+    while (true) {
+        const auto start = Clock::now();
+        for (long i = 0; i < calls; i++) {
+            fn();
+        }
+        const double seconds = std::chrono::duration<double>(
+                                            Clock::now() - start).count();
+        if (seconds >= kMinSeconds) {
+            return seconds / calls;
+        }
+        calls *= 2;
+    }
+}
+
+template<typename T> const char* PrecisionName();
+template<> const char* PrecisionName<float>() { return "float"; }
+template<> const char* PrecisionName<double>() { return "double"; }
+
+std::string TopologyName(const int& inputs, const std::vector<int>& hidden,
+                         const int& outputs) {
+    std::string name = std::to_string(inputs);
+    for (const int& size : hidden) {
+        name += "-" + std::to_string(size);
+    }
+    return name + "-" + std::to_string(outputs);
+}
+
+/// @brief Collects results as JSON objects in named arrays
+class JsonResults {
+private:
+    struct Section {
+        std::string name;
+        std::vector<std::string> entries;
+    };
+    std::vector<Section> sections;
+    std::vector<std::string> fields;
+
+public:
+    /// @brief Adds a string field to the entry being built
+    void Field(const std::string& key, const std::string& value) {
+        fields.push_back("\"" + key + "\": \"" + value + "\"");
+    }
+
+    /// @brief Adds a numeric field to the entry being built
+    void Field(const std::string& key, const double& value) {
+        char buffer[64];
+        snprintf(buffer, sizeof(buffer), "%.6g", value);
+        fields.push_back("\"" + key + "\": " + buffer);
+    }
+
+    /// @brief Finishes the entry being built and adds it to a section
+    void Add(const std::string& section) {
+        std::string entry = "{";
+        for (size_t i = 0; i < fields.size(); i++) {
+            entry += (i > 0 ? ", " : "") + fields[i];
+        }
+        entry += "}";
+        fields.clear();
+
+        for (Section& existing : sections) {
+            if (existing.name == section) {
+                existing.entries.push_back(entry);
+                return;
+            }
+        }
+        sections.push_back({section, {entry}});
+    }
+
+    /// @brief Writes every section to a file. Returns false on failure.
+    bool Write(const std::string& path) const {
+        FILE* file = fopen(path.c_str(), "w");
+        if (file == nullptr) {
+            return false;
+        }
+        fprintf(file, "{\n  \"version\": 1,\n");
+        fprintf(file, "  \"simd_level\": \"%s\",\n",
+                kernels::SimdLevelName(kernels::ActiveSimdLevel()));
+        fprintf(file, "  \"exp_mode\": \"%s\"",
+                kernels::ExpModeName(kernels::ActiveExpMode()));
+        for (const Section& section : sections) {
+            fprintf(file, ",\n  \"%s\": [\n", section.name.c_str());
+            for (size_t i = 0; i < section.entries.size(); i++) {
+                fprintf(file, "    %s%s\n", section.entries[i].c_str(),
+                        i + 1 < section.entries.size() ? "," : "");
+            }
+            fprintf(file, "  ]");
+        }
+        fprintf(file, "\n}\n");
+        return fclose(file) == 0;
+    }
+};
+
+// Stream of the next call to RandomValues. The benchmarks run in a fixed
+// order, so each block of values is the same from run to run.
+uint64_t next_random_stream = 0;
+
+template<typename T>
+std::vector<T> RandomValues(const size_t& count) {
+    std::vector<T> values(count);
+    kernels::RandomUniform(count, kBenchSeed,
+                RandomStream(RandomDomain::kBenchInputs,
+                             next_random_stream++), 0, T(0), T(1),
+                values.data());
+    return values;
+}
+
+// =======================================
+// Network Benchmarks
+// =======================================
+
+/// @brief Training and inference samples per second, at a batch size of one
+///        and of kBatchSize
+template<typename T>
+void BenchNetwork(const int& inputs, const std::vector<int>& hidden,
+                  const int& outputs, JsonResults& results) {
+    const std::string topology = TopologyName(inputs, hidden, outputs);
+    NeuralNetwork<T> network(inputs, outputs, hidden);
+    const std::vector<T> input = RandomValues<T>(
+                                static_cast<size_t>(kBatchSize) * inputs);
+    const std::vector<T> target = RandomValues<T>(
+                                static_cast<size_t>(kBatchSize) * outputs);
+
+    for (const int& batch_size : {1, kBatchSize}) {
+        const double forwards = SecondsPerCall([&]() {
+            network.ForwardsBatch(input.data(), batch_size);
+        });
+        const double training = SecondsPerCall([&]() {
+            network.ForwardsBatch(input.data(), batch_size);
+            network.BackwardsBatch(target.data());
+        });
+        printf("%-16s %-6s batch %2d  forwards %10.0f samples/s  "
+               "training %10.0f samples/s\n", topology.c_str(),
+               PrecisionName<T>(), batch_size, batch_size / forwards,
+               batch_size / training);
+
+        results.Field("topology", topology);
+        results.Field("precision", PrecisionName<T>());
+        results.Field("batch_size", batch_size);
+        results.Field("forwards_samples_per_second", batch_size / forwards);
+        results.Field("training_samples_per_second", batch_size / training);
+        results.Add("training");
+    }
+
+    const CompiledNetwork<T> compiled(network);
+    InferenceSession<T> session(compiled, kBatchSize);
+    std::vector<T> output(static_cast<size_t>(kBatchSize) * outputs);
+    for (const int& batch_size : {1, kBatchSize}) {
+        const double seconds = SecondsPerCall([&]() {
+            session.PredictBatch(input.data(), batch_size, output.data());
+        });
+        printf("%-16s %-6s batch %2d  inference %9.0f samples/s\n",
+               topology.c_str(), PrecisionName<T>(), batch_size,
+               batch_size / seconds);
+
+        results.Field("topology", topology);
+        results.Field("precision", PrecisionName<T>());
+        results.Field("engine", "session");
+        results.Field("batch_size", batch_size);
+        results.Field("samples_per_second", batch_size / seconds);
+        results.Add("inference");
+    }
+
+    // Calibrated on the benchmark inputs themselves
+    const QuantizedNetwork<T> quantized(compiled, input.data(), kBatchSize,
+                                        QuantizationScheme::kPerChannel);
+    QuantizedSession<T> quantized_session(quantized);
+    for (const int& batch_size : {1, kBatchSize}) {
+        const double seconds = SecondsPerCall([&]() {
+            quantized_session.PredictBatch(input.data(), batch_size,
+                                           output.data());
+        });
+        printf("%-16s %-6s batch %2d  int8 inference %9.0f samples/s\n",
+               topology.c_str(), PrecisionName<T>(), batch_size,
+               batch_size / seconds);
+
+        results.Field("topology", topology);
+        results.Field("precision", PrecisionName<T>());
+        results.Field("engine", "int8");
+        results.Field("batch_size", batch_size);
+        results.Field("samples_per_second", batch_size / seconds);
+        results.Add("inference");
+    }
+
+    // The same network with 90% of each layer's weights pruned
+    PruningConfig pruning;
+    pruning.sparsity = kBenchSparsity;
+    network.Prune(pruning);
+    const CompiledNetwork<T> pruned(network);
+    const SparseNetwork<T> sparse(pruned);
+    SparseSession<T> sparse_session(sparse, kBatchSize);
+    for (const int& batch_size : {1, kBatchSize}) {
+        const double seconds = SecondsPerCall([&]() {
+            sparse_session.PredictBatch(input.data(), batch_size,
+                                        output.data());
+        });
+        printf("%-16s %-6s batch %2d  sparse inference %9.0f samples/s\n",
+               topology.c_str(), PrecisionName<T>(), batch_size,
+               batch_size / seconds);
+
+        results.Field("topology", topology);
+        results.Field("precision", PrecisionName<T>());
+        results.Field("engine", "sparse");
+        results.Field("sparsity", kBenchSparsity);
+        results.Field("batch_size", batch_size);
+        results.Field("samples_per_second", batch_size / seconds);
+        results.Add("inference");
+    }
+}
+
+/// @brief Inference samples per second of the tank model compiled as a
+///        StaticNetwork
+template<typename T>
+void BenchStaticNetwork(JsonResults& results) {
+    using TankNetwork = StaticNetwork<T, 5,
+                                      Dense<16, ActivationType::kSigmoid>,
+                                      Dense<1, ActivationType::kSigmoid>>;
+    NeuralNetwork<T> network(5, 1, {16});
+    TankNetwork tank_network;
+    tank_network.LoadWeights(network);
+
+    const std::vector<T> input = RandomValues<T>(
+                                static_cast<size_t>(kBatchSize) * 5);
+    std::vector<T> output(kBatchSize);
+    for (const int& batch_size : {1, kBatchSize}) {
+        const double seconds = SecondsPerCall([&]() {
+            tank_network.PredictBatch(input.data(), batch_size,
+                                      output.data());
+        });
+        printf("%-16s %-6s batch %2d  static inference %9.0f samples/s\n",
+               "5-16-1", PrecisionName<T>(), batch_size,
+               batch_size / seconds);
+
+        results.Field("topology", "5-16-1");
+        results.Field("precision", PrecisionName<T>());
+        results.Field("engine", "static");
+        results.Field("batch_size", batch_size);
+        results.Field("samples_per_second", batch_size / seconds);
+        results.Add("inference");
+    }
+}
+
+/// @brief Forwards and backwards GFLOP/s of each layer at kBatchSize
+template<typename T>
+void BenchLayers(const int& inputs, const std::vector<int>& hidden,
+                 const int& outputs, JsonResults& results) {
+    const std::string topology = TopologyName(inputs, hidden, outputs);
+    const NeuralNetwork<T> network(inputs, outputs, hidden);
+    const std::vector<Layer<T>>& layers = network.Layers();
+
+    for (size_t i = 0; i < layers.size(); i++) {
+        const Layer<T>& layer = layers[i];
+        Workspace<T> network_workspace = network.CreateWorkspace(kBatchSize);
+        LayerWorkspace<T>& workspace = network_workspace.layers[i];
+        const std::vector<T> input = RandomValues<T>(
+                    static_cast<size_t>(kBatchSize) * layer.NumInputs());
+        const std::vector<T> dCost_dOutput = RandomValues<T>(
+                    static_cast<size_t>(kBatchSize) * layer.NumNeurons());
+
+        const double forwards = SecondsPerCall([&]() {
+            layer.ForwardsBatch(input.data(), kBatchSize, workspace);
+        });
+        // Weight gradients plus the cost to the previous layer
+        const double backwards = SecondsPerCall([&]() {
+            layer.BackwardsBatch(input.data(), dCost_dOutput.data(),
+                                 kBatchSize, workspace, true);
+        });
+        const double flops = 2.0 * kBatchSize * layer.NumInputs()
+                             * layer.NumNeurons();
+        printf("%-16s %-6s layer %zu (%4d x %4d)  forwards %6.2f GFLOP/s  "
+               "backwards %6.2f GFLOP/s\n", topology.c_str(),
+               PrecisionName<T>(), i, layer.NumInputs(), layer.NumNeurons(),
+               flops / forwards * 1e-9, 2 * flops / backwards * 1e-9);
+
+        results.Field("topology", topology);
+        results.Field("precision", PrecisionName<T>());
+        results.Field("layer", static_cast<double>(i));
+        results.Field("inputs", layer.NumInputs());
+        results.Field("neurons", layer.NumNeurons());
+        results.Field("batch_size", kBatchSize);
+        results.Field("forwards_gflops", flops / forwards * 1e-9);
+        results.Field("backwards_gflops", 2 * flops / backwards * 1e-9);
+        results.Add("layers");
+    }
+}
+
+/// @brief Heap allocations made by steady state training steps, after a
+///        few warm up steps, at a batch size of one and of kBatchSize, single
+///        threaded and data parallel
+/// @return total allocations over every measured step, expected to be zero
+template<typename T>
+long BenchAllocations(const int& inputs, const std::vector<int>& hidden,
+                      const int& outputs, JsonResults& results) {
+    constexpr int kWarmUpSteps = 3;
+    constexpr int kSteps = 100;
+    const std::string topology = TopologyName(inputs, hidden, outputs);
+    NeuralNetwork<T> network(inputs, outputs, hidden);
+    OptimizerConfig optimizer;
+    optimizer.type = OptimizerType::kAdam;
+    network.SetOptimizer(optimizer);
+    DataParallelTrainer<T> trainer(network, 2, kBatchSize);
+    const std::vector<T> input = RandomValues<T>(
+                                static_cast<size_t>(kBatchSize) * inputs);
+    const std::vector<T> target = RandomValues<T>(
+                                static_cast<size_t>(kBatchSize) * outputs);
+
+    long total = 0;
+    for (const bool& parallel : {false, true}) {
+        for (const int& batch_size : {1, kBatchSize}) {
+            auto step = [&]() {
+                if (parallel) {
+                    trainer.TrainBatch(input.data(), target.data(),
+                                       batch_size);
+                    trainer.LastBatchError();
+                }
+                else {
+                    network.ForwardsBatch(input.data(), batch_size);
+                    network.CalculateBatchError(target.data());
+                    network.BackwardsBatch(target.data());
+                }
+            };
+            for (int i = 0; i < kWarmUpSteps; i++) {
+                step();
+            }
+            const long start = g_allocations.load();
+            for (int i = 0; i < kSteps; i++) {
+                step();
+            }
+            const long allocations = g_allocations.load() - start;
+            total += allocations;
+
+            const char* engine = parallel ? "parallel" : "network";
+            printf("%-16s %-6s batch %2d  %-8s %ld allocations in %d "
+                   "training steps\n", topology.c_str(), PrecisionName<T>(),
+                   batch_size, engine, allocations, kSteps);
+
+            results.Field("topology", topology);
+            results.Field("precision", PrecisionName<T>());
+            results.Field("engine", engine);
+            results.Field("batch_size", batch_size);
+            results.Field("steps", kSteps);
+            results.Field("allocations", allocations);
+            results.Add("allocations");
+        }
+    }
+    return total;
+}
+
+// =======================================
+// Data Benchmarks
+// =======================================
+
+void AddDataResult(const std::string& name, const double& seconds,
+                   JsonResults& results) {
+    printf("%-34s %12.1f ns/call\n", name.c_str(), seconds * 1e9);
+    results.Field("name", name);
+    results.Field("seconds_per_call", seconds);
+    results.Add("data");
+}
+
+/// @brief Opening the MNIST training set, and assembling a batch from it.
+///        Skipped if the files are not found.
+void BenchMnist(const std::string& data_dir, JsonResults& results) {
+    const std::string images = data_dir + "/train-images-idx3-ubyte";
+    const std::string labels = data_dir + "/train-labels-idx1-ubyte";
+    std::unique_ptr<MnistDataset> dataset;
+    try {
+        dataset.reset(new MnistDataset(images, labels));
+    }
+    catch (const std::runtime_error& e) {
+        printf("Skipping MNIST benchmarks: %s\n", e.what());
+        return;
+    }
+
+    AddDataResult("MnistDataset", SecondsPerCall([&]() {
+        MnistDataset opened(images, labels);
+    }), results);
+
+    std::vector<int> indices(kBatchSize);
+    CounterRng generator(kBenchSeed,
+                         RandomStream(RandomDomain::kSamplePicks, 0));
+    std::uniform_int_distribution<int> pick(0, dataset->Size() - 1);
+    for (int& index : indices) {
+        index = pick(generator);
+    }
+    std::vector<float> inputs(static_cast<size_t>(kBatchSize)
+                              * dataset->ImageSize());
+    std::vector<float> targets(static_cast<size_t>(kBatchSize)
+                               * MnistDataset::kNumClasses);
+    AddDataResult("MnistDataset::FillBatch", SecondsPerCall([&]() {
+        dataset->FillBatch(indices.data(), kBatchSize, inputs.data(),
+                           targets.data());
+    }), results);
+}
+
+/// @brief Tank exercise generation and the frequentist estimate
+void BenchTank(JsonResults& results) {
+    volatile int sink = 0;
+    AddDataResult("CreateTankPopulationExercise", SecondsPerCall([&]() {
+        sink = CreateTankPopulationExercise(100, 1000, 5).true_population;
+    }), results);
+
+    TankExerciseGenerator generator(100, 1000, 5, kBenchSeed);
+    std::vector<float> inputs(static_cast<size_t>(kBatchSize) * 5);
+    std::vector<float> targets(kBatchSize);
+    AddDataResult("TankExerciseGenerator::FillBatch", SecondsPerCall([&]() {
+        generator.FillBatch(kBatchSize, inputs.data(), targets.data());
+    }), results);
+
+    const std::vector<int> peeks = generator.CreateExercise().population_peeks;
+    AddDataResult("FrequentistPrediction", SecondsPerCall([&]() {
+        sink = FrequentistPrediction(peeks);
+    }), results);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    const std::string output_path = argc > 1 ? argv[1] : "bench.json";
+    const std::string data_dir = argc > 2 ? argv[2] : "data";
+
+    printf("SIMD level: %s\n",
+           kernels::SimdLevelName(kernels::ActiveSimdLevel()));
+
+    JsonResults results;
+    struct Topology {
+        int inputs;
+        std::vector<int> hidden;
+        int outputs;
+    };
+    const std::vector<Topology> topologies = {
+        {5, {16}, 1},
+        {5, {100, 100}, 1},
+        {784, {100, 100}, 10},
+    };
+    for (const Topology& topology : topologies) {
+        BenchNetwork<float>(topology.inputs, topology.hidden,
+                            topology.outputs, results);
+        BenchNetwork<double>(topology.inputs, topology.hidden,
+                             topology.outputs, results);
+    }
+    BenchStaticNetwork<float>(results);
+    BenchStaticNetwork<double>(results);
+    for (const Topology& topology : topologies) {
+        BenchLayers<float>(topology.inputs, topology.hidden,
+                           topology.outputs, results);
+        BenchLayers<double>(topology.inputs, topology.hidden,
+                            topology.outputs, results);
+    }
+    long allocations = 0;
+    for (const Topology& topology : topologies) {
+        allocations += BenchAllocations<float>(topology.inputs,
+                            topology.hidden, topology.outputs, results);
+        allocations += BenchAllocations<double>(topology.inputs,
+                            topology.hidden, topology.outputs, results);
+    }
+    BenchMnist(data_dir, results);
+    BenchTank(results);
+
+    if (!results.Write(output_path)) {
+        printf("Failed to write \"%s\"\n", output_path.c_str());
+        return 1;
+    }
+    printf("Results written to %s\n", output_path.c_str());
+    if (allocations != 0) {
+        printf("Steady state training made %ld heap allocations, expected "
+               "none\n", allocations);
+        return 1;
+    }
+    return 0;
+}
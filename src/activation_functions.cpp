@@ -1,36 +1,181 @@
 #include <algorithm>
-#include <math.h>
+#include <cmath>
+#include <stdexcept>
+#include <string>
 #include "activation_functions.h"
+#include "kernels/kernels.h"
 
 /// @brief Sigmoid function, y = 1 / (1 + e^-x)
 /// @param input x
 /// @return y
-double SigmoidForward(double input) {
-    return 1.0 / (1.0 + std::exp(-input));
+template<typename T>
+T SigmoidForward(T input) {
+    return T(1) / (T(1) + std::exp(-input));
 }
 
 /// @brief Derivative of the Sigmoid function, y' = sig(x) * (1 - sig(x)), where
 ///        sig(x) is the output of the Sigmoid function
 /// @param sigmoid_x sig(x), NOT x
 /// @return y'
-double SigmoidDerivative(double sigmoid_x) {
-    return sigmoid_x * (1.0 - sigmoid_x);
+template<typename T>
+T SigmoidDerivative(T sigmoid_x) {
+    return sigmoid_x * (T(1) - sigmoid_x);
+}
+
+/// @brief Hyperbolic tangent, y = (e^x - e^-x) / (e^x + e^-x)
+/// @param input x
+/// @return y
+template<typename T>
+T TanhForward(T input) {
+    return std::tanh(input);
+}
+
+/// @brief Derivative of the hyperbolic tangent, y' = 1 - tanh(x)^2
+/// @param tanh_x tanh(x), NOT x
+/// @return y'
+template<typename T>
+T TanhDerivative(T tanh_x) {
+    return T(1) - tanh_x * tanh_x;
 }
 
 /// @brief Rectified linear unit, y = x for x > 0 and y = 0 for x < 0
 /// @param input x
 /// @return y
-double ReluForward(double input) {
+template<typename T>
+T ReluForward(T input) {
     return input < 0 ? 0 : input;
 }
 
+/// @brief Derivative of the rectified linear unit, y' = 1 for x > 0 and
+///        y' = 0 otherwise
+/// @param relu_x relu(x), NOT x
+/// @return y'
+template<typename T>
+T ReluDerivative(T relu_x) {
+    return relu_x > 0 ? 1 : 0;
+}
+
 /// @brief No activation function, y = x
 /// @param input x
 /// @return y
-double IdentityForward(double input) {
+template<typename T>
+T IdentityForward(T input) {
     return input;
 }
 
-ActivationFunction Sigmoid {SigmoidForward, SigmoidDerivative};
-ActivationFunction Relu {ReluForward, ReluForward};
-ActivationFunction Identity {IdentityForward, IdentityForward};
\ No newline at end of file
+/// @brief Derivative of no activation function, y' = 1
+/// @param identity_x x
+/// @return y'
+template<typename T>
+T IdentityDerivative(T /*identity_x*/) {
+    return 1;
+}
+
+// =======================================
+// Batch Functions
+// =======================================
+
+template<typename T>
+void SigmoidForwardBatch(const T* inputs, T* outputs, size_t n) {
+    kernels::Sigmoid(n, inputs, outputs);
+}
+
+template<typename T>
+void SigmoidBackwardBatch(const T* outputs, const T* dCost_dOutput, T* delta,
+                          size_t n) {
+    kernels::SigmoidBackward(n, outputs, dCost_dOutput, delta);
+}
+
+template<typename T>
+void TanhForwardBatch(const T* inputs, T* outputs, size_t n) {
+    kernels::Tanh(n, inputs, outputs);
+}
+
+template<typename T>
+void TanhBackwardBatch(const T* outputs, const T* dCost_dOutput, T* delta,
+                       size_t n) {
+    kernels::TanhBackward(n, outputs, dCost_dOutput, delta);
+}
+
+template<typename T>
+void ReluForwardBatch(const T* inputs, T* outputs, size_t n) {
+    kernels::Relu(n, inputs, outputs);
+}
+
+template<typename T>
+void ReluBackwardBatch(const T* outputs, const T* dCost_dOutput, T* delta,
+                       size_t n) {
+    kernels::ReluBackward(n, outputs, dCost_dOutput, delta);
+}
+
+template<typename T>
+void IdentityForwardBatch(const T* inputs, T* outputs, size_t n) {
+    if (inputs != outputs) {
+        std::copy(inputs, inputs + n, outputs);
+    }
+}
+
+template<typename T>
+void IdentityBackwardBatch(const T* /*outputs*/, const T* dCost_dOutput,
+                           T* delta, size_t n) {
+    if (dCost_dOutput != delta) {
+        std::copy(dCost_dOutput, dCost_dOutput + n, delta);
+    }
+}
+
+template<typename T>
+const ActivationFunction<T>& GetActivation(const ActivationType& type) {
+    switch (type) {
+        case ActivationType::kSigmoid: return Sigmoid<T>;
+        case ActivationType::kRelu: return Relu<T>;
+        case ActivationType::kIdentity: return Identity<T>;
+        case ActivationType::kTanh: return Tanh<T>;
+    }
+    throw std::runtime_error("Unknown activation type "
+                    + std::to_string(static_cast<uint32_t>(type)));
+}
+
+template float SigmoidForward<float>(float);
+template double SigmoidForward<double>(double);
+template float SigmoidDerivative<float>(float);
+template double SigmoidDerivative<double>(double);
+template float TanhForward<float>(float);
+template double TanhForward<double>(double);
+template float TanhDerivative<float>(float);
+template double TanhDerivative<double>(double);
+template float ReluForward<float>(float);
+template double ReluForward<double>(double);
+template float IdentityForward<float>(float);
+template double IdentityForward<double>(double);
+template float ReluDerivative<float>(float);
+template double ReluDerivative<double>(double);
+template float IdentityDerivative<float>(float);
+template double IdentityDerivative<double>(double);
+template void SigmoidForwardBatch<float>(const float*, float*, size_t);
+template void SigmoidForwardBatch<double>(const double*, double*, size_t);
+template void SigmoidBackwardBatch<float>(const float*, const float*, float*,
+                                          size_t);
+template void SigmoidBackwardBatch<double>(const double*, const double*,
+                                           double*, size_t);
+template void TanhForwardBatch<float>(const float*, float*, size_t);
+template void TanhForwardBatch<double>(const double*, double*, size_t);
+template void TanhBackwardBatch<float>(const float*, const float*, float*,
+                                       size_t);
+template void TanhBackwardBatch<double>(const double*, const double*, double*,
+                                        size_t);
+template void ReluForwardBatch<float>(const float*, float*, size_t);
+template void ReluForwardBatch<double>(const double*, double*, size_t);
+template void ReluBackwardBatch<float>(const float*, const float*, float*,
+                                       size_t);
+template void ReluBackwardBatch<double>(const double*, const double*, double*,
+                                        size_t);
+template void IdentityForwardBatch<float>(const float*, float*, size_t);
+template void IdentityForwardBatch<double>(const double*, double*, size_t);
+template void IdentityBackwardBatch<float>(const float*, const float*, float*,
+                                           size_t);
+template void IdentityBackwardBatch<double>(const double*, const double*,
+                                            double*, size_t);
+template const ActivationFunction<float>& GetActivation<float>(
+                                                const ActivationType&);
+template const ActivationFunction<double>& GetActivation<double>(
+                                                const ActivationType&);
@@ -1,8 +1,94 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/// @brief Identifies an activation function, e.g. in saved model files. Values
+///        are stored on disk and must not be renumbered.
+enum class ActivationType : uint32_t {
+    kSigmoid = 0,
+    kRelu = 1,
+    kIdentity = 2,
+    kTanh = 3,
+};
+
+/// @brief An activation function and its derivative, per element and over
+///        spans of elements. The derivative takes the activated output rather
+///        than the weighted sum. The span functions are vectorised, and
+///        sigmoid and tanh evaluate their exponential according to
+///        kernels::ActiveExpMode().
+/// @tparam T float or double
+template<typename T>
 struct ActivationFunction {
-    double (*Forwards)(double);
-    double (*Derivative)(double);
+    T (*Forwards)(T);
+    T (*Derivative)(T);
+    /// @brief outputs = f(inputs) over n elements, may be in place
+    void (*ForwardsBatch)(const T* inputs, T* outputs, size_t n);
+    /// @brief delta = dCost_dOutput * f'(outputs) over n elements, given the
+    ///        activated outputs. delta may alias dCost_dOutput.
+    void (*BackwardsBatch)(const T* outputs, const T* dCost_dOutput, T* delta,
+                           size_t n);
+    ActivationType type;
 };
 
-extern ActivationFunction Sigmoid;
-extern ActivationFunction Relu;
-extern ActivationFunction Identity;
\ No newline at end of file
+template<typename T> T SigmoidForward(T input);
+template<typename T> T SigmoidDerivative(T sigmoid_x);
+template<typename T> T TanhForward(T input);
+template<typename T> T TanhDerivative(T tanh_x);
+template<typename T> T ReluForward(T input);
+template<typename T> T ReluDerivative(T relu_x);
+template<typename T> T IdentityForward(T input);
+template<typename T> T IdentityDerivative(T identity_x);
+
+template<typename T>
+void SigmoidForwardBatch(const T* inputs, T* outputs, size_t n);
+template<typename T>
+void SigmoidBackwardBatch(const T* outputs, const T* dCost_dOutput, T* delta,
+                          size_t n);
+template<typename T>
+void TanhForwardBatch(const T* inputs, T* outputs, size_t n);
+template<typename T>
+void TanhBackwardBatch(const T* outputs, const T* dCost_dOutput, T* delta,
+                       size_t n);
+template<typename T>
+void ReluForwardBatch(const T* inputs, T* outputs, size_t n);
+template<typename T>
+void ReluBackwardBatch(const T* outputs, const T* dCost_dOutput, T* delta,
+                       size_t n);
+template<typename T>
+void IdentityForwardBatch(const T* inputs, T* outputs, size_t n);
+template<typename T>
+void IdentityBackwardBatch(const T* outputs, const T* dCost_dOutput, T* delta,
+                           size_t n);
+
+template<typename T>
+inline const ActivationFunction<T> Sigmoid {SigmoidForward<T>,
+                                            SigmoidDerivative<T>,
+                                            SigmoidForwardBatch<T>,
+                                            SigmoidBackwardBatch<T>,
+                                            ActivationType::kSigmoid};
+template<typename T>
+inline const ActivationFunction<T> Tanh {TanhForward<T>,
+                                         TanhDerivative<T>,
+                                         TanhForwardBatch<T>,
+                                         TanhBackwardBatch<T>,
+                                         ActivationType::kTanh};
+template<typename T>
+inline const ActivationFunction<T> Relu {ReluForward<T>,
+                                         ReluDerivative<T>,
+                                         ReluForwardBatch<T>,
+                                         ReluBackwardBatch<T>,
+                                         ActivationType::kRelu};
+template<typename T>
+inline const ActivationFunction<T> Identity {IdentityForward<T>,
+                                             IdentityDerivative<T>,
+                                             IdentityForwardBatch<T>,
+                                             IdentityBackwardBatch<T>,
+                                             ActivationType::kIdentity};
+
+/// @brief Looks up an activation function by type. Throws runtime_error for
+///        unknown types.
+/// @param type type of the activation function
+/// @return the activation function
+template<typename T>
+const ActivationFunction<T>& GetActivation(const ActivationType& type);
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+/// @brief Cache line size in bytes. Contiguous weight and activation buffers
+///        are aligned to this so that rows start on a cache line and SIMD
+///        loads never straddle two lines.
+constexpr std::size_t kCacheLineSize = 64;
+
+/// @brief Minimal STL allocator returning memory aligned to Alignment bytes.
+/// @tparam T element type
+/// @tparam Alignment alignment in bytes, must be a power of two
+template<typename T, std::size_t Alignment = kCacheLineSize>
+class AlignedAllocator {
+public:
+    using value_type = T;
+
+    template<typename U> struct rebind {
+        using other = AlignedAllocator<U, Alignment>;
+    };
+
+    AlignedAllocator() noexcept = default;
+    template<typename U>
+    AlignedAllocator(const AlignedAllocator<U, Alignment>&) noexcept {}
+
+    // Allocates through the global aligned operator new, so replacing it,
+    // e.g. to count allocations, also covers aligned buffers
+    T* allocate(std::size_t n) {
+        std::size_t bytes = (n * sizeof(T) + Alignment - 1)
+                            / Alignment * Alignment;
+        return static_cast<T*>(::operator new(bytes == 0 ? Alignment : bytes,
+                                              std::align_val_t(Alignment)));
+    }
+
+    void deallocate(T* ptr, std::size_t) noexcept {
+        ::operator delete(ptr, std::align_val_t(Alignment));
+    }
+
+    template<typename U>
+    bool operator==(const AlignedAllocator<U, Alignment>&) const noexcept {
+        return true;
+    }
+    template<typename U>
+    bool operator!=(const AlignedAllocator<U, Alignment>&) const noexcept {
+        return false;
+    }
+};
+
+/// @brief std::vector whose storage is aligned to a cache line.
+template<typename T>
+using AlignedVector = std::vector<T, AlignedAllocator<T>>;
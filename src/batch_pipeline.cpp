@@ -0,0 +1,156 @@
+#include <algorithm>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <string>
+
+#include "batch_pipeline.h"
+#include "counter_rng.h"
+#include "metrics.h"
+
+template<typename T>
+BatchPipeline<T>::BatchPipeline(const int& num_samples, const int& epochs,
+                                const int& samples_per_epoch,
+                                const int& mini_batch_size,
+                                const int& input_size, const int& target_size,
+                                FillFunction fill, const int& num_threads,
+                                const uint64_t& seed) :
+                                mini_batch_size(mini_batch_size),
+                                seed(seed), fill(std::move(fill)) {
+    if (num_samples <= 0 || samples_per_epoch <= 0 || mini_batch_size <= 0
+        || epochs < 0 || num_threads <= 0) {
+        throw std::runtime_error("Invalid BatchPipeline configuration. "
+                    + std::to_string(num_samples) + " samples, "
+                    + std::to_string(samples_per_epoch) + " per epoch, "
+                    + std::to_string(mini_batch_size) + " per batch, "
+                    + std::to_string(epochs) + " epochs, "
+                    + std::to_string(num_threads) + " threads");
+    }
+
+    this->samples_per_epoch = std::min(samples_per_epoch, num_samples);
+    batches_per_epoch = (this->samples_per_epoch + mini_batch_size - 1)
+                        / mini_batch_size;
+    total_batches = static_cast<long>(epochs) * batches_per_epoch;
+
+    // One slot per thread filling plus the one being trained on
+    slots.resize(num_threads + 1);
+    for (Slot& slot : slots) {
+        slot.inputs.resize(static_cast<size_t>(mini_batch_size) * input_size);
+        slot.targets.resize(static_cast<size_t>(mini_batch_size)
+                            * target_size);
+        slot.indices.resize(mini_batch_size);
+    }
+    permutation.resize(num_samples);
+
+    for (int i = 0; i < num_threads; i++) {
+        workers.emplace_back(&BatchPipeline::WorkerLoop, this);
+    }
+}
+
+template<typename T>
+BatchPipeline<T>::~BatchPipeline() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    slot_free.notify_all();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+template<typename T>
+void BatchPipeline<T>::ShuffleEpoch(const int& epoch) {
+    // Start from the identity each epoch, so each permutation depends only on
+    // the seed and the epoch number
+    std::iota(permutation.begin(), permutation.end(), 0);
+    CounterRng generator(seed, RandomStream(RandomDomain::kEpochShuffle,
+                                            static_cast<uint64_t>(epoch)));
+    std::shuffle(permutation.begin(), permutation.end(), generator);
+    permutation_epoch = epoch;
+}
+
+template<typename T>
+void BatchPipeline<T>::WorkerLoop() {
+    while (true) {
+        Slot* slot = nullptr;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            // Batches are claimed in order, each into the slot its sequence
+            // number maps to once the consumer has released it
+            slot_free.wait(lock, [&] {
+                return stopping || next_to_fill >= total_batches
+                       || slots[next_to_fill % slots.size()].state
+                          == SlotState::kFree;
+            });
+            if (stopping || next_to_fill >= total_batches) {
+                return;
+            }
+
+            const long sequence = next_to_fill++;
+            slot = &slots[sequence % slots.size()];
+            slot->state = SlotState::kFilling;
+            slot->sequence = sequence;
+
+            const int epoch = static_cast<int>(sequence / batches_per_epoch);
+            const int batch_idx = static_cast<int>(sequence % batches_per_epoch);
+            if (epoch != permutation_epoch) {
+                ShuffleEpoch(epoch);
+            }
+            const int start = batch_idx * mini_batch_size;
+            const int count = std::min(mini_batch_size,
+                                       samples_per_epoch - start);
+            std::copy(permutation.begin() + start,
+                      permutation.begin() + start + count,
+                      slot->indices.begin());
+
+            slot->batch.inputs = slot->inputs.data();
+            slot->batch.targets = slot->targets.data();
+            slot->batch.indices = slot->indices.data();
+            slot->batch.count = count;
+            slot->batch.epoch = epoch;
+            slot->batch.last_in_epoch = batch_idx + 1 == batches_per_epoch;
+        }
+
+        // The expensive part runs without the lock
+        fill(slot->indices.data(), slot->batch.count, slot->inputs.data(),
+             slot->targets.data());
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            slot->state = SlotState::kReady;
+        }
+        batch_ready.notify_one();
+    }
+}
+
+template<typename T>
+const typename BatchPipeline<T>::Batch& BatchPipeline<T>::Next() {
+    if (!HasNext()) {
+        throw std::runtime_error("BatchPipeline::Next called after the last "
+                    "batch. " + std::to_string(total_batches)
+                    + " batches were produced");
+    }
+
+    METRICS_SCOPE(metrics::Counter::kBatchWait);
+    std::unique_lock<std::mutex> lock(mutex);
+    // The caller is done with the batch it was given last time
+    if (consumer_slot >= 0) {
+        slots[consumer_slot].state = SlotState::kFree;
+    }
+
+    const int slot_idx = static_cast<int>(next_to_consume % slots.size());
+    Slot& slot = slots[slot_idx];
+    slot_free.notify_all();
+    batch_ready.wait(lock, [&] {
+        return slot.state == SlotState::kReady
+               && slot.sequence == next_to_consume;
+    });
+    consumer_slot = slot_idx;
+    next_to_consume++;
+
+    return slot.batch;
+}
+
+template class BatchPipeline<float>;
+template class BatchPipeline<double>;
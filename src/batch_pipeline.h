@@ -0,0 +1,136 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "aligned_allocator.h"
+
+/// @brief Producer/consumer pipeline assembling training mini-batches on
+///        background threads while the current batch trains. Each epoch
+///        draws its samples without replacement from a permutation of the
+///        dataset, shuffled with a seed derived from the pipeline seed and the
+///        epoch number, so runs with the same seed see the same batches.
+///        Batches are built into a ring of preallocated contiguous blocks, one
+///        more than the number of background threads, so with one thread the
+///        blocks are double buffered.
+///        Example usage:
+///
+///    BatchPipeline<float> pipeline(dataset.Size(), epochs, batch_size,
+///                mini_batch_size, 784, 10, fill_batch, 1, seed);
+///    while (pipeline.HasNext()) {
+///        const BatchPipeline<float>::Batch& batch = pipeline.Next();
+///        trainer.TrainBatch(batch.inputs, batch.targets, batch.count);
+///    }
+template<typename T>
+class BatchPipeline {
+public:
+    /// @brief Writes count samples into contiguous blocks: fill(indices,
+    ///        count, inputs, targets). Called on the background threads, so
+    ///        must be safe to call concurrently and must not throw.
+    using FillFunction = std::function<void(const int*, const int&, T*, T*)>;
+
+    /// @brief One assembled mini-batch
+    struct Batch {
+        // count x input_size row-major block of samples
+        const T* inputs = nullptr;
+        // count x target_size row-major block of targets
+        const T* targets = nullptr;
+        // Dataset index of each sample in the batch
+        const int* indices = nullptr;
+        // Number of samples in the batch
+        int count = 0;
+        // Epoch the batch belongs to
+        int epoch = 0;
+        // Whether this is the last batch of its epoch
+        bool last_in_epoch = false;
+    };
+
+private:
+    enum class SlotState { kFree, kFilling, kReady };
+
+    // Preallocated buffers of one batch in the ring
+    struct Slot {
+        AlignedVector<T> inputs;
+        AlignedVector<T> targets;
+        std::vector<int> indices;
+        Batch batch;
+        SlotState state = SlotState::kFree;
+        // Sequence number of the batch held, to keep batches in order
+        long sequence = -1;
+    };
+
+    int samples_per_epoch = 0;
+    int mini_batch_size = 0;
+    int batches_per_epoch = 0;
+    long total_batches = 0;
+    uint64_t seed = 0;
+    FillFunction fill;
+
+    std::vector<Slot> slots;
+    std::vector<std::thread> workers;
+
+    std::mutex mutex;
+    // Signalled when a slot is filled
+    std::condition_variable batch_ready;
+    // Signalled when a slot is released by the consumer
+    std::condition_variable slot_free;
+    bool stopping = false;
+
+    // Next batch for a producer to claim and for the consumer to take
+    long next_to_fill = 0;
+    long next_to_consume = 0;
+    // Slot handed to the consumer by the last call to Next, if any
+    int consumer_slot = -1;
+
+    // Shuffled dataset indices of the epoch being claimed. Only touched with
+    // the mutex held.
+    std::vector<int> permutation;
+    int permutation_epoch = -1;
+
+    /// @brief Main loop of each background thread
+    void WorkerLoop();
+
+    /// @brief Shuffles the dataset indices for an epoch
+    void ShuffleEpoch(const int& epoch);
+
+public:
+    /// @brief Constructor. Starts the background threads, which begin
+    ///        assembling the first batches immediately.
+    /// @param num_samples number of samples in the dataset
+    /// @param epochs number of epochs to produce
+    /// @param samples_per_epoch samples drawn without replacement per epoch,
+    ///                          at most num_samples
+    /// @param mini_batch_size largest number of samples per batch
+    /// @param input_size values per sample input
+    /// @param target_size values per sample target
+    /// @param fill writes samples into a batch
+    /// @param num_threads background threads assembling batches, at least one
+    /// @param seed seed of the per-epoch permutations
+    BatchPipeline(const int& num_samples, const int& epochs,
+                  const int& samples_per_epoch, const int& mini_batch_size,
+                  const int& input_size, const int& target_size,
+                  FillFunction fill, const int& num_threads,
+                  const uint64_t& seed);
+
+    /// @brief Stops and joins the background threads
+    ~BatchPipeline();
+
+    BatchPipeline(const BatchPipeline&) = delete;
+    BatchPipeline& operator=(const BatchPipeline&) = delete;
+
+    /// @brief Whether any batches remain to be taken with Next
+    bool HasNext() const { return next_to_consume < total_batches; }
+
+    /// @brief Takes the next batch in order, waiting if it is not ready yet.
+    ///        The batch returned by the previous call is released for reuse.
+    ///        Throws runtime_error if no batches remain.
+    /// @return next batch, valid until the following call to Next
+    const Batch& Next();
+
+    /// @brief Number of batches in each epoch
+    int BatchesPerEpoch() const { return batches_per_epoch; }
+};
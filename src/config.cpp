@@ -1,4 +1,6 @@
+#include <algorithm>
 #include <fstream>
+#include <stdexcept>
 
 #include "config.h"
 
@@ -11,10 +13,55 @@ Config::Config(const std::string& filename) {
         // Skip comments and empty lines
         if (line.empty() || line[0] == '#' || line[0] == ';') continue;
 
-        std::istringstream iss(line);
-        std::string key, value;
-        if (std::getline(iss, key, '=') && std::getline(iss, value)) {
+        // Values may be empty, e.g. an unset optional file path
+        const size_t separator = line.find('=');
+        if (separator != std::string::npos && separator > 0) {
+            const std::string key = line.substr(0, separator);
+            const std::string value = line.substr(separator + 1);
             values[key] = value;
+
+            // A repeated key replaces the earlier value, swept or not
+            swept_keys.erase(std::remove(swept_keys.begin(), swept_keys.end(),
+                                         key), swept_keys.end());
+            if (value.find(kSweepSeparator) != std::string::npos) {
+                swept_keys.push_back(key);
+            }
+        }
+    }
+}
+
+std::vector<Config> Config::Combinations() const {
+    Config single = *this;
+    single.swept_keys.clear();
+    std::vector<Config> combinations = {single};
+
+    // Each swept key multiplies the combinations so far by its values, so
+    // the last key varies fastest
+    for (const std::string& key : swept_keys) {
+        std::vector<std::string> options;
+        std::istringstream ss(values.at(key));
+        std::string option;
+        while (std::getline(ss, option, kSweepSeparator)) {
+            options.push_back(option);
         }
+
+        std::vector<Config> expanded;
+        expanded.reserve(combinations.size() * options.size());
+        for (const Config& combination : combinations) {
+            for (const std::string& value : options) {
+                expanded.push_back(combination);
+                expanded.back().values[key] = value;
+            }
+        }
+        combinations = std::move(expanded);
+    }
+    return combinations;
+}
+
+const std::string& Config::Text(const std::string& key) const {
+    auto it = values.find(key);
+    if (it == values.end()) {
+        throw std::runtime_error("Missing expected key: " + key);
     }
+    return it->second;
 }
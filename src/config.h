@@ -8,6 +8,10 @@
 using ConfigValueType = std::variant<int*, double*, std::string*, 
                                      std::vector<int>*>;
 
+// Separates the values of a key swept over several settings, e.g.
+// learning_rate=0.01|0.1. Values of a list are still separated by commas.
+constexpr char kSweepSeparator = '|';
+
 // Struct used to map from the name of a config item to local storage
 struct FieldMapping {
     std::string key;
@@ -37,10 +41,17 @@ struct FieldMapping {
 ///        {"activation", &general_cfg.activation},
 ///        {"hidden_layers", &general_cfg.hidden_layers},
 ///    });
+///
+///        A key may list several values separated by kSweepSeparator, e.g.
+///        hidden_layers=100,100|256. Combinations() then expands the config
+///        into one config per combination of the listed values, each of which
+///        is loaded as above.
 class Config {
 private:
     /// Contains the loaded INI data
     std::unordered_map<std::string, std::string> values;
+    /// Keys listing several values, in the order they appear in the file
+    std::vector<std::string> swept_keys;
 
     /// @brief Returns config data as the specified type. 
     ///        Throws runtime_error if the key doesn't exist.
@@ -63,17 +74,35 @@ public:
     /// @param filename INI file to read
     Config(const std::string& filename);
 
+    /// @brief Keys listing several values separated by kSweepSeparator, in
+    ///        the order they appear in the file
+    const std::vector<std::string>& SweptKeys() const { return swept_keys; }
+
+    /// @brief Expands the swept keys into every combination of their values,
+    ///        the first swept key varying slowest. Keys with a single value
+    ///        are shared by every combination.
+    /// @return one config per combination, each without swept keys. A config
+    ///         without swept keys returns only itself.
+    std::vector<Config> Combinations() const;
+
+    /// @brief Returns the unparsed text of a key's value, e.g. to label a
+    ///        combination. Throws runtime_error if the key doesn't exist.
+    /// @param key string key of the data
+    /// @return value as written in the file
+    const std::string& Text(const std::string& key) const;
+
     /// @brief Populates an arbitrary struct with data loaded from the INI
     ///        config file. Supports int, double, string, and vector<int>
     /// @tparam Struct arbitrary struct to populate
     /// @param s arbitrary struct to populate
     /// @param fields mapping from keys to struct fields
     template<typename Struct> void LoadStructFromConfig(Struct& s,
-                                            std::vector<FieldMapping> fields);
+                                    std::vector<FieldMapping> fields) const;
 };
 
 template<typename Struct>
-void Config::LoadStructFromConfig(Struct& s, std::vector<FieldMapping> fields) {
+void Config::LoadStructFromConfig(Struct& s,
+                                  std::vector<FieldMapping> fields) const {
     for (auto& f : fields) {
         std::visit([&](auto* memberPtr) {
             using T = std::decay_t<decltype(*memberPtr)>;
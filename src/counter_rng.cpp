@@ -0,0 +1,16 @@
+#include "counter_rng.h"
+#include "kernels/kernels.h"
+
+CounterRng::CounterRng(const uint64_t& seed, const uint64_t& stream) :
+                       seed_(seed), stream_(stream) {
+}
+
+CounterRng::result_type CounterRng::operator()() {
+    if (position == 2 * kBufferBlocks) {
+        kernels::Philox(kBufferBlocks, seed_, stream_, next_block, words);
+        next_block += kBufferBlocks;
+        position = 0;
+    }
+    const uint32_t* pair = &words[2 * position++];
+    return static_cast<uint64_t>(pair[0]) << 32 | pair[1];
+}
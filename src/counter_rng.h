@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+
+/// @brief Independent uses of one seed. Each forms the high 32 bits of the
+///        streams it draws from, so no two uses ever share random numbers.
+enum class RandomDomain : uint32_t {
+    // Initial weights and biases, index 2 * layer for the weights and
+    // 2 * layer + 1 for the biases
+    kWeightInit = 1,
+    // Permutation of the training set, index the epoch
+    kEpochShuffle = 2,
+    // Tank exercises, index the generator's stream
+    kTankExercises = 3,
+    // Test samples printed with their predictions, or benchmarked
+    kSamplePicks = 4,
+    // Benchmark inputs, index the order they are drawn in
+    kBenchInputs = 5,
+};
+
+/// @brief Stream of one use of a seed
+/// @param domain what the numbers are used for
+/// @param index e.g. the layer or epoch, below 2^32
+/// @return stream for CounterRng or kernels::RandomUniform
+inline uint64_t RandomStream(const RandomDomain& domain,
+                             const uint64_t& index) {
+    return static_cast<uint64_t>(domain) << 32 | (index & 0xffffffffull);
+}
+
+/// @brief Random bit generator over the Philox4x32-10 counter-based
+///        generator, see kernels::Philox, usable with the standard library
+///        distributions and algorithms, e.g. std::shuffle. Its output is
+///        fixed by the seed and stream alone, so a generator can be created
+///        on whichever thread needs the stream, and each thread can have its
+///        own stream without any shared state. Blocks are generated a few at
+///        a time with the vectorised kernel. Example usage:
+///
+///    CounterRng generator(seed, RandomStream(RandomDomain::kEpochShuffle,
+///                                            epoch));
+///    std::shuffle(indices.begin(), indices.end(), generator);
+class CounterRng {
+public:
+    using result_type = uint64_t;
+
+private:
+    // Blocks generated per refill, two values per block
+    static constexpr int kBufferBlocks = 16;
+
+    uint64_t seed_ = 0;
+    uint64_t stream_ = 0;
+    // Index of the next block to generate
+    uint64_t next_block = 0;
+    uint32_t words[4 * kBufferBlocks] = {};
+    // Next value of the buffer to return
+    int position = 2 * kBufferBlocks;
+
+public:
+    /// @brief Constructor
+    /// @param seed key shared by every stream of a run
+    /// @param stream independent sequence for the seed, see RandomStream
+    CounterRng(const uint64_t& seed, const uint64_t& stream);
+
+    /// @brief Next 64 random bits
+    result_type operator()();
+
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() {
+        return std::numeric_limits<result_type>::max();
+    }
+};
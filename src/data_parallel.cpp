@@ -0,0 +1,97 @@
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+#include "data_parallel.h"
+
+template<typename T>
+DataParallelTrainer<T>::DataParallelTrainer(NeuralNetwork<T>& network,
+                                            const int& num_threads,
+                                            const int& max_batch_size) :
+                                            network_(network),
+                                            pool(num_threads),
+                                            max_batch_size_(max_batch_size) {
+    const int num_slices = pool.NumThreads();
+    const int slice_size = (max_batch_size + num_slices - 1) / num_slices;
+    for (int i = 0; i < num_slices; i++) {
+        workspaces.push_back(network_.CreateWorkspace(slice_size));
+    }
+    outputs.resize(static_cast<size_t>(max_batch_size)
+                   * network_.NumOutputs());
+    slice_errors.resize(num_slices);
+}
+
+template<typename T>
+const T* DataParallelTrainer<T>::TrainBatch(const T* inputs, const T* targets,
+                                            const int& batch_size) {
+    // Checked here on the calling thread, a throw from inside ParallelFor
+    // would take down the worker running the slice
+    if (batch_size <= 0 || batch_size > max_batch_size_) {
+        throw std::runtime_error("Invalid batch size in DataParallelTrainer::"
+                    "TrainBatch. Batch size is " + std::to_string(batch_size)
+                    + ", max batch size is "
+                    + std::to_string(max_batch_size_));
+    }
+
+    const int num_inputs = network_.NumInputs();
+    const int num_outputs = network_.NumOutputs();
+    const int num_slices = std::min(pool.NumThreads(), batch_size);
+    batch_size_ = batch_size;
+
+    // Forwards and backwards over each slice into its own workspace
+    pool.ParallelFor(num_slices, [&](const int& slice) {
+        const int start = static_cast<int>(
+                    static_cast<long>(batch_size) * slice / num_slices);
+        const int end = static_cast<int>(
+                    static_cast<long>(batch_size) * (slice + 1) / num_slices);
+        const int count = end - start;
+        const T* slice_targets = targets
+                                 + static_cast<size_t>(start) * num_outputs;
+        Workspace<T>& workspace = workspaces[slice];
+
+        workspace.ResetGradients();
+        const T* slice_outputs = network_.ForwardsBatch(
+                    inputs + static_cast<size_t>(start) * num_inputs, count,
+                    workspace);
+        network_.AccumulateGradients(slice_targets, workspace);
+
+        std::copy(slice_outputs, slice_outputs
+                  + static_cast<size_t>(count) * num_outputs,
+                  outputs.begin() + static_cast<size_t>(start) * num_outputs);
+        slice_errors[slice] = workspace.loss * count;
+    });
+
+    ReduceGradients(num_slices);
+    network_.ApplyGradients(workspaces[0], batch_size);
+
+    std::fill(slice_errors.begin() + num_slices, slice_errors.end(), 0.0);
+    return outputs.data();
+}
+
+template<typename T>
+void DataParallelTrainer<T>::ReduceGradients(const int& num_slices) {
+    // Level by level, slice i adds slice i + stride where i is a multiple of
+    // 2 * stride, until slice 0 holds the sum of every slice
+    for (int stride = 1; stride < num_slices; stride *= 2) {
+        const int num_pairs = (num_slices + 2 * stride - 1) / (2 * stride);
+        pool.ParallelFor(num_pairs, [&](const int& pair) {
+            const int destination = pair * 2 * stride;
+            const int source = destination + stride;
+            if (source < num_slices) {
+                workspaces[destination].AddGradients(workspaces[source]);
+            }
+        });
+    }
+}
+
+template<typename T>
+double DataParallelTrainer<T>::LastBatchError() const {
+    double error = 0.0;
+    for (const double& slice_error : slice_errors) {
+        error += slice_error;
+    }
+    return batch_size_ > 0 ? error / batch_size_ : 0.0;
+}
+
+template class DataParallelTrainer<float>;
+template class DataParallelTrainer<double>;
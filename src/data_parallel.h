@@ -0,0 +1,74 @@
+#pragma once
+
+#include <vector>
+
+#include "neural_network.h"
+#include "thread_pool.h"
+
+/// @brief Trains a NeuralNetwork on mini-batches split across threads. Each
+///        thread runs the forwards and backwards pass over its own slice of
+///        the batch, accumulating gradients into its own Workspace. The
+///        gradients of every slice are then summed with a tree reduction and
+///        applied to the weights once per batch, giving the same update as
+///        NeuralNetwork::BackwardsBatch over the whole batch.
+///        Example usage:
+///
+///    DataParallelTrainer<float> trainer(network, 8, mini_batch_size);
+///    const float* outputs = trainer.TrainBatch(inputs, targets, count);
+///    double loss = trainer.LastBatchError();
+template<typename T>
+class DataParallelTrainer {
+private:
+    // Network being trained. Must outlive the trainer.
+    NeuralNetwork<T>& network_;
+    ThreadPool pool;
+
+    // One workspace per slice of the batch, slice i is always processed
+    // with workspace i so results do not depend on thread scheduling
+    std::vector<Workspace<T>> workspaces;
+    // Network outputs of the last batch gathered from every slice,
+    // batch_size x num_outputs
+    AlignedVector<T> outputs;
+    // Loss of each slice of the last batch, weighted by the number of
+    // samples in the slice
+    std::vector<double> slice_errors;
+    // Number of samples in the last batch
+    int batch_size_ = 0;
+    // Largest batch the workspaces and outputs are sized for
+    int max_batch_size_;
+
+    /// @brief Sums the gradients of every slice into the first workspace,
+    ///        adding pairs of workspaces in parallel at each level of the tree
+    /// @param num_slices number of slices holding gradients
+    void ReduceGradients(const int& num_slices);
+
+public:
+    /// @brief Constructor
+    /// @param network network to train
+    /// @param num_threads threads to split each batch across, including the
+    ///                    calling thread
+    /// @param max_batch_size largest batch passed to TrainBatch, used to size
+    ///                       the buffers up front
+    DataParallelTrainer(NeuralNetwork<T>& network, const int& num_threads,
+                        const int& max_batch_size);
+
+    /// @brief Runs the forwards and backwards pass over a batch and updates
+    ///        the weights once with the mean gradient
+    /// @param inputs batch_size x num_inputs row-major block of samples
+    /// @param targets batch_size x num_outputs block of target results
+    /// @param batch_size number of samples in the batch, at most the
+    ///                   max_batch_size given to the constructor
+    /// @return batch_size x num_outputs block of network outputs from the
+    ///         forwards pass. Valid until the next call.
+    const T* TrainBatch(const T* inputs, const T* targets,
+                        const int& batch_size);
+
+    /// @brief Loss of the outputs of the last batch, computed along with the
+    ///        gradients
+    /// @return mean over the batch of the network's loss, see
+    ///         NeuralNetwork::CalculateBatchError
+    double LastBatchError() const;
+
+    /// @brief Threads each batch is split across
+    int NumThreads() const { return pool.NumThreads(); }
+};
@@ -0,0 +1,158 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+
+#include "evaluation.h"
+
+// =======================================
+// ClassificationReport
+// =======================================
+
+long ClassificationReport::NumSamples() const {
+    long total = 0;
+    for (const long& count : confusion) {
+        total += count;
+    }
+    return total;
+}
+
+long ClassificationReport::NumCorrect() const {
+    long correct = 0;
+    for (int label = 0; label < num_classes; label++) {
+        correct += confusion[static_cast<size_t>(label) * num_classes
+                             + label];
+    }
+    return correct;
+}
+
+double ClassificationReport::Accuracy() const {
+    const long total = NumSamples();
+    return total > 0 ? static_cast<double>(NumCorrect()) / total : 0.0;
+}
+
+double ClassificationReport::Recall(const int& label) const {
+    const long* row = &confusion[static_cast<size_t>(label) * num_classes];
+    long total = 0;
+    for (int prediction = 0; prediction < num_classes; prediction++) {
+        total += row[prediction];
+    }
+    return total > 0 ? static_cast<double>(row[label]) / total : 0.0;
+}
+
+double ClassificationReport::SamplesPerSecond() const {
+    return seconds > 0.0 ? NumSamples() / seconds : 0.0;
+}
+
+void ClassificationReport::Print(const char* name) const {
+    printf("%s: %ld / %ld correct, accuracy %.2f%% (%.0f images/s on %d "
+           "threads)\n", name, NumCorrect(), NumSamples(), 100 * Accuracy(),
+           SamplesPerSecond(), threads);
+    printf("Confusion matrix, one row per label and one column per "
+           "prediction:\n      ");
+    for (int prediction = 0; prediction < num_classes; prediction++) {
+        printf(" %5d", prediction);
+    }
+    printf("  recall\n");
+    for (int label = 0; label < num_classes; label++) {
+        printf("%5d:", label);
+        for (int prediction = 0; prediction < num_classes; prediction++) {
+            printf(" %5ld", confusion[static_cast<size_t>(label)
+                                      * num_classes + prediction]);
+        }
+        printf("  %5.1f%%\n", 100 * Recall(label));
+    }
+}
+
+// =======================================
+// MnistEvaluator
+// =======================================
+
+template<typename T>
+MnistEvaluator<T>::MnistEvaluator(const MnistDataset& dataset,
+                                  const int& num_threads,
+                                  const int& batch_size) :
+                                  dataset_(dataset), pool(num_threads),
+                                  batch_size_(batch_size) {
+    if (batch_size <= 0) {
+        throw std::runtime_error("Invalid batch size in MnistEvaluator. "
+                    "Batch size is " + std::to_string(batch_size));
+    }
+    const int kNumClasses = MnistDataset::kNumClasses;
+    const int num_slices = pool.NumThreads();
+    slice_inputs.resize(num_slices);
+    slice_outputs.resize(num_slices);
+    slice_confusion.resize(num_slices);
+    for (int i = 0; i < num_slices; i++) {
+        slice_inputs[i].resize(static_cast<size_t>(batch_size)
+                               * dataset.ImageSize());
+        slice_outputs[i].resize(static_cast<size_t>(batch_size)
+                                * kNumClasses);
+        slice_confusion[i].resize(kNumClasses * kNumClasses);
+    }
+}
+
+template<typename T>
+ClassificationReport MnistEvaluator<T>::Evaluate(
+                                        const CompiledNetwork<T>& network) {
+    using Clock = std::chrono::steady_clock;
+    const int kImageSize = dataset_.ImageSize();
+    const int kNumClasses = MnistDataset::kNumClasses;
+    if (network.NumInputs() != kImageSize
+        || network.NumOutputs() != kNumClasses) {
+        throw std::runtime_error("Cannot evaluate a network of "
+                    + std::to_string(network.NumInputs()) + " inputs and "
+                    + std::to_string(network.NumOutputs()) + " outputs on "
+                    "images of " + std::to_string(kImageSize) + " pixels and "
+                    + std::to_string(kNumClasses) + " classes");
+    }
+
+    const Clock::time_point start_time = Clock::now();
+    const int size = dataset_.Size();
+    const int num_slices = pool.NumThreads();
+    pool.ParallelFor(num_slices, [&](const int& slice) {
+        const int start = static_cast<int>(
+                    static_cast<long>(size) * slice / num_slices);
+        const int end = static_cast<int>(
+                    static_cast<long>(size) * (slice + 1) / num_slices);
+        T* inputs = slice_inputs[slice].data();
+        T* outputs = slice_outputs[slice].data();
+        std::vector<long>& confusion = slice_confusion[slice];
+        std::fill(confusion.begin(), confusion.end(), 0);
+
+        InferenceSession<T> session(network, batch_size_);
+        for (int first = start; first < end; first += batch_size_) {
+            const int count = std::min(batch_size_, end - first);
+            for (int i = 0; i < count; i++) {
+                dataset_.NormaliseImage(first + i, inputs
+                                        + static_cast<size_t>(i) * kImageSize);
+            }
+            session.PredictBatch(inputs, count, outputs);
+            for (int i = 0; i < count; i++) {
+                const T* output = outputs + i * kNumClasses;
+                const int prediction = static_cast<int>(
+                            std::max_element(output, output + kNumClasses)
+                            - output);
+                confusion[dataset_.Label(first + i) * kNumClasses
+                          + prediction]++;
+            }
+        }
+    });
+
+    ClassificationReport report;
+    report.num_classes = kNumClasses;
+    report.confusion.assign(kNumClasses * kNumClasses, 0);
+    for (const std::vector<long>& confusion : slice_confusion) {
+        for (size_t i = 0; i < confusion.size(); i++) {
+            report.confusion[i] += confusion[i];
+        }
+    }
+    report.seconds = std::chrono::duration<double>(
+                                    Clock::now() - start_time).count();
+    report.threads = num_slices;
+    return report;
+}
+
+template class MnistEvaluator<float>;
+template class MnistEvaluator<double>;
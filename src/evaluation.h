@@ -0,0 +1,98 @@
+#pragma once
+
+#include <vector>
+
+#include "aligned_allocator.h"
+#include "inference.h"
+#include "load_data.h"
+#include "thread_pool.h"
+
+// Default samples per batch passed through the network by MnistEvaluator
+constexpr int kDefaultEvaluationBatchSize = 128;
+
+/// @brief Datasets classified in full, e.g. loaded from config.ini
+struct EvaluationConfig {
+    // Test set, after every epoch and once training completes
+    bool test = false;
+    // Training set, once training completes
+    bool train = false;
+};
+
+/// @brief Results of classifying every sample of a dataset: a confusion
+///        matrix of labels against predictions, and the time taken
+struct ClassificationReport {
+    int num_classes = 0;
+    // num_classes x num_classes counts, one row per label and one column per
+    // prediction, so correct predictions lie on the diagonal
+    std::vector<long> confusion;
+    // Wall time taken to classify every sample
+    double seconds = 0.0;
+    // Threads the samples were split across
+    int threads = 0;
+
+    /// @brief Number of samples classified
+    long NumSamples() const;
+
+    /// @brief Number of samples classified as their label
+    long NumCorrect() const;
+
+    /// @brief Fraction of samples classified as their label
+    double Accuracy() const;
+
+    /// @brief Fraction of the samples of one label classified as it, or zero
+    ///        if there are none
+    /// @param label class to report
+    double Recall(const int& label) const;
+
+    /// @brief Samples classified per second of wall time
+    double SamplesPerSecond() const;
+
+    /// @brief Prints the accuracy and throughput, then the confusion matrix
+    ///        with the recall of each label
+    /// @param name name of the dataset, e.g. "Test set"
+    void Print(const char* name) const;
+};
+
+/// @brief Classifies every image of an MNIST dataset with batched inference
+///        split across threads. Each thread takes a contiguous slice of the
+///        dataset, normalises its images a batch at a time into its own
+///        buffers, and counts its predictions into its own confusion matrix,
+///        so the threads never share writable data. The buffers are
+///        allocated by the constructor, so one evaluator can be reused every
+///        epoch. Example usage:
+///
+///    MnistEvaluator<float> evaluator(test, 4);
+///    evaluator.Evaluate(CompiledNetwork<float>(network)).Print("Test set");
+template<typename T>
+class MnistEvaluator {
+private:
+    // Dataset to classify. Must outlive the evaluator.
+    const MnistDataset& dataset_;
+    ThreadPool pool;
+    int batch_size_ = 0;
+
+    // Per slice buffers: a batch of normalised images and their outputs,
+    // and a confusion matrix
+    std::vector<AlignedVector<T>> slice_inputs;
+    std::vector<AlignedVector<T>> slice_outputs;
+    std::vector<std::vector<long>> slice_confusion;
+
+public:
+    /// @brief Constructor
+    /// @param dataset images and labels to classify
+    /// @param num_threads threads to split the dataset across, including the
+    ///                    calling thread
+    /// @param batch_size samples per batch passed through the network
+    MnistEvaluator(const MnistDataset& dataset, const int& num_threads,
+                   const int& batch_size = kDefaultEvaluationBatchSize);
+
+    /// @brief Classifies every image in the dataset as its largest output.
+    ///        Throws runtime_error if the network does not take one input per
+    ///        pixel and give one output per class.
+    /// @param network network to evaluate
+    /// @return confusion matrix and time taken
+    ClassificationReport Evaluate(const CompiledNetwork<T>& network);
+
+    /// @brief Threads the dataset is split across
+    int NumThreads() const { return pool.NumThreads(); }
+};
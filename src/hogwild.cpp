@@ -0,0 +1,68 @@
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+#include "hogwild.h"
+
+template<typename T>
+HogwildTrainer<T>::HogwildTrainer(NeuralNetwork<T>& network,
+                                  const int& num_threads,
+                                  const int& batch_size) :
+                                  network_(network), pool(num_threads),
+                                  batch_size_(batch_size) {
+    if (batch_size <= 0) {
+        throw std::runtime_error("Invalid batch size in HogwildTrainer. "
+                    "Batch size is " + std::to_string(batch_size));
+    }
+    const int num_workers = pool.NumThreads();
+    for (int i = 0; i < num_workers; i++) {
+        workspaces.push_back(network_.CreateWorkspace(batch_size));
+        thread_inputs.emplace_back(static_cast<size_t>(batch_size)
+                                   * network_.NumInputs());
+        thread_targets.emplace_back(static_cast<size_t>(batch_size)
+                                    * network_.NumOutputs());
+    }
+    thread_losses.resize(num_workers);
+}
+
+template<typename T>
+void HogwildTrainer<T>::Train(const int* indices, const int& count,
+                              const FillFunction& fill) {
+    count_ = count;
+    next_sample.store(0, std::memory_order_relaxed);
+
+    const int num_workers = pool.NumThreads();
+    pool.ParallelFor(num_workers, [&](const int& worker) {
+        Workspace<T>& workspace = workspaces[worker];
+        T* inputs = thread_inputs[worker].data();
+        T* targets = thread_targets[worker].data();
+        double loss = 0.0;
+        while (true) {
+            const int start = next_sample.fetch_add(batch_size_,
+                                                    std::memory_order_relaxed);
+            if (start >= count) {
+                break;
+            }
+            const int batch_count = std::min(batch_size_, count - start);
+            fill(indices + start, batch_count, inputs, targets);
+
+            network_.ForwardsBatch(inputs, batch_count, workspace);
+            network_.AccumulateGradients(targets, workspace);
+            network_.ApplyGradientsHogwild(workspace, batch_count);
+            loss += workspace.loss * batch_count;
+        }
+        thread_losses[worker] = loss;
+    });
+}
+
+template<typename T>
+double HogwildTrainer<T>::LastLoss() const {
+    double loss = 0.0;
+    for (const double& thread_loss : thread_losses) {
+        loss += thread_loss;
+    }
+    return count_ > 0 ? loss / count_ : 0.0;
+}
+
+template class HogwildTrainer<float>;
+template class HogwildTrainer<double>;
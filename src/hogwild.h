@@ -0,0 +1,74 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <vector>
+
+#include "neural_network.h"
+#include "thread_pool.h"
+
+/// @brief Lock-free asynchronous SGD (Hogwild). Every thread repeatedly
+///        claims the next few samples, runs the forwards and backwards pass
+///        over them in its own Workspace against the shared weights, and
+///        applies the resulting SGD step straight to those weights with
+///        NeuralNetwork::ApplyGradientsHogwild, without waiting for the other
+///        threads. Updates only touch weights with a nonzero gradient, e.g.
+///        not those of blank MNIST pixels, so threads rarely write the same
+///        cache lines. With one thread and one sample per update this is
+///        NeuralNetwork::Backwards applied sample by sample.
+///        The passes read the weights with plain loads while other threads
+///        write them; on x86 an aligned float or double is never torn.
+///        Example usage:
+///
+///    HogwildTrainer<float> trainer(network, 8);
+///    trainer.Train(indices, count, fill);
+///    double loss = trainer.LastLoss();
+template<typename T>
+class HogwildTrainer {
+public:
+    /// @brief Writes count samples into contiguous blocks: fill(indices,
+    ///        count, inputs, targets). Called on every thread at once, so
+    ///        must be safe to call concurrently.
+    using FillFunction = std::function<void(const int*, const int&, T*, T*)>;
+
+private:
+    // Network being trained. Must outlive the trainer.
+    NeuralNetwork<T>& network_;
+    ThreadPool pool;
+    // Samples per update
+    int batch_size_ = 0;
+
+    // One workspace and one block of samples and targets per thread
+    std::vector<Workspace<T>> workspaces;
+    std::vector<AlignedVector<T>> thread_inputs;
+    std::vector<AlignedVector<T>> thread_targets;
+    // Loss summed over the samples each thread trained on in the last call
+    std::vector<double> thread_losses;
+    // Next sample to claim in the current call
+    std::atomic<int> next_sample{0};
+    // Number of samples in the last call
+    int count_ = 0;
+
+public:
+    /// @brief Constructor
+    /// @param network network to train
+    /// @param num_threads threads training at once, including the calling
+    ///                    thread
+    /// @param batch_size samples each thread trains on per update
+    HogwildTrainer(NeuralNetwork<T>& network, const int& num_threads,
+                   const int& batch_size = 1);
+
+    /// @brief Trains on a set of samples, returning once every one has been
+    ///        trained on
+    /// @param indices dataset index of each sample, passed to fill
+    /// @param count number of samples
+    /// @param fill writes samples and their targets
+    void Train(const int* indices, const int& count, const FillFunction& fill);
+
+    /// @brief Mean loss of the samples of the last call, each measured
+    ///        before its own update
+    double LastLoss() const;
+
+    /// @brief Threads training at once
+    int NumThreads() const { return pool.NumThreads(); }
+};
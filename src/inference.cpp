@@ -0,0 +1,125 @@
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+#include "inference.h"
+#include "model_file.h"
+
+// =======================================
+// CompiledNetwork
+// =======================================
+
+template<typename T>
+CompiledNetwork<T>::CompiledNetwork(const NeuralNetwork<T>& network) {
+    // Copy every weight matrix and bias vector into one allocation, each
+    // starting on a cache line
+    const size_t block = kCacheLineSize / sizeof(T);
+    auto block_size = [&](const size_t& count) {
+        return (count + block - 1) / block * block;
+    };
+
+    size_t total = 0;
+    for (const Layer<T>& layer : network.Layers()) {
+        const LayerView<T> view = layer.View();
+        total += block_size(static_cast<size_t>(view.num_neurons)
+                            * view.num_inputs);
+        total += block_size(view.num_neurons);
+    }
+    storage.assign(total, T(0));
+
+    size_t offset = 0;
+    for (const Layer<T>& layer : network.Layers()) {
+        LayerView<T> view = layer.View();
+        const size_t num_weights = static_cast<size_t>(view.num_neurons)
+                                   * view.num_inputs;
+        T* weights = storage.data() + offset;
+        std::copy(view.weights, view.weights + num_weights, weights);
+        offset += block_size(num_weights);
+
+        T* biases = storage.data() + offset;
+        std::copy(view.biases, view.biases + view.num_neurons, biases);
+        offset += block_size(view.num_neurons);
+
+        view.weights = weights;
+        view.biases = biases;
+        layers.push_back(view);
+    }
+
+    Initialise();
+}
+
+template<typename T>
+CompiledNetwork<T> CompiledNetwork<T>::Load(const std::string& path) {
+    CompiledNetwork<T> network;
+    network.mapping = std::make_shared<const MappedFile>(path);
+    network.layers = ReadModelFile<T>(*network.mapping, path);
+    network.Initialise();
+    return network;
+}
+
+template<typename T>
+void CompiledNetwork<T>::Save(const std::string& path) const {
+    SaveModelFile(path, layers);
+}
+
+template<typename T>
+void CompiledNetwork<T>::Initialise() {
+    num_inputs_ = layers.front().num_inputs;
+    num_outputs_ = layers.back().num_neurons;
+    max_layer_size = 0;
+    for (const LayerView<T>& layer : layers) {
+        max_layer_size = std::max(max_layer_size, layer.num_neurons);
+    }
+}
+
+// =======================================
+// InferenceSession
+// =======================================
+
+template<typename T>
+InferenceSession<T>::InferenceSession(const CompiledNetwork<T>& network,
+                                      const int& max_batch_size) :
+                                      network_(network),
+                                      max_batch_size_(max_batch_size) {
+    if (max_batch_size <= 0) {
+        throw std::runtime_error("Invalid batch size in InferenceSession. "
+                    "Batch size is " + std::to_string(max_batch_size));
+    }
+    const size_t size = static_cast<size_t>(max_batch_size)
+                        * network.MaxLayerSize();
+    buffer_a.resize(size);
+    buffer_b.resize(size);
+}
+
+template<typename T>
+void InferenceSession<T>::Predict(const T* input, T* output) {
+    PredictBatch(input, 1, output);
+}
+
+template<typename T>
+void InferenceSession<T>::PredictBatch(const T* inputs, const int& batch_size,
+                                       T* outputs) {
+    if (batch_size <= 0 || batch_size > max_batch_size_) {
+        throw std::runtime_error("Invalid batch size in InferenceSession::"
+                    "PredictBatch. Batch size is " + std::to_string(batch_size)
+                    + ", maximum is " + std::to_string(max_batch_size_));
+    }
+
+    const std::vector<LayerView<T>>& layers = network_.Layers();
+    const T* next_input = inputs;
+    T* next_output = buffer_a.data();
+    for (size_t i = 0; i < layers.size(); i++) {
+        // The last layer writes straight into the caller's buffer
+        T* layer_output = i + 1 == layers.size() ? outputs : next_output;
+        layers[i].ForwardsBatch(next_input, batch_size, layer_output);
+
+        next_input = layer_output;
+        next_output = next_output == buffer_a.data() ? buffer_b.data()
+                                                     : buffer_a.data();
+    }
+}
+
+template class CompiledNetwork<float>;
+template class CompiledNetwork<double>;
+template class InferenceSession<float>;
+template class InferenceSession<double>;
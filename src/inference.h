@@ -0,0 +1,121 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "neural_network.h"
+#include "aligned_allocator.h"
+#include "mapped_file.h"
+
+/// @brief Read-only snapshot of a trained network for inference. Built either
+///        from a NeuralNetwork, copying its weights and biases so later
+///        training does not affect it, or from a model file, using the
+///        weights in place in a read-only memory mapping shared with every
+///        other process loading the same file. Nothing in it changes after
+///        construction. Any number of threads can run predictions against
+///        one CompiledNetwork, each through its own InferenceSession.
+///        Example usage:
+///
+///    const CompiledNetwork<float> compiled =
+///                CompiledNetwork<float>::Load("model.bin");
+///    InferenceSession<float> session(compiled);
+///    session.Predict(input, output);
+template<typename T>
+class CompiledNetwork {
+private:
+    // Layers in order, pointing into either storage or mapping
+    std::vector<LayerView<T>> layers;
+    // Weights and biases copied from a NeuralNetwork, each block aligned to a
+    // cache line
+    AlignedVector<T> storage;
+    // Model file the weights and biases are read from in place
+    std::shared_ptr<const MappedFile> mapping;
+
+    int num_inputs_ = 0;
+    int num_outputs_ = 0;
+    // Largest number of neurons in any layer, sizes the session buffers
+    int max_layer_size = 0;
+
+    CompiledNetwork() = default;
+
+    /// @brief Sets the sizes from the layer views
+    void Initialise();
+
+public:
+    /// @brief Constructor
+    /// @param network trained network to copy the weights and biases from
+    explicit CompiledNetwork(const NeuralNetwork<T>& network);
+
+    /// @brief Memory maps a model file written by NeuralNetwork::Save or
+    ///        CompiledNetwork::Save. The weights are not copied. Throws
+    ///        runtime_error if the file cannot be mapped or is not a valid
+    ///        model file for the scalar type T.
+    /// @param path model file to load
+    /// @return network using the weights in the file
+    static CompiledNetwork Load(const std::string& path);
+
+    // The layer views point into this object's storage
+    CompiledNetwork(const CompiledNetwork&) = delete;
+    CompiledNetwork& operator=(const CompiledNetwork&) = delete;
+    CompiledNetwork(CompiledNetwork&&) = default;
+    CompiledNetwork& operator=(CompiledNetwork&&) = default;
+
+    /// @brief Saves this network to a binary model file, see model_file.h.
+    ///        Throws runtime_error if the file cannot be written.
+    /// @param path file to write
+    void Save(const std::string& path) const;
+
+    /// @brief Layers of the network in order
+    const std::vector<LayerView<T>>& Layers() const { return layers; }
+
+    /// @brief Number of inputs to the network
+    int NumInputs() const { return num_inputs_; }
+
+    /// @brief Number of outputs of the network
+    int NumOutputs() const { return num_outputs_; }
+
+    /// @brief Largest number of neurons in any layer
+    int MaxLayerSize() const { return max_layer_size; }
+};
+
+/// @brief Scratch buffers for running predictions against a CompiledNetwork.
+///        Every buffer is allocated by the constructor, so predicting does not
+///        allocate. A session must only be used by one thread at a time;
+///        create one per serving thread.
+template<typename T>
+class InferenceSession {
+private:
+    // Network to predict with. Must outlive the session.
+    const CompiledNetwork<T>& network_;
+    // Largest batch passed to PredictBatch
+    int max_batch_size_ = 0;
+
+    // Activations alternate between the two buffers layer by layer, each
+    // max_batch_size x max_layer_size
+    AlignedVector<T> buffer_a;
+    AlignedVector<T> buffer_b;
+
+public:
+    /// @brief Constructor
+    /// @param network network to predict with
+    /// @param max_batch_size largest batch passed to PredictBatch
+    explicit InferenceSession(const CompiledNetwork<T>& network,
+                              const int& max_batch_size = 1);
+
+    /// @brief Forwards pass over a single sample
+    /// @param input num_inputs values
+    /// @param output receives num_outputs values
+    void Predict(const T* input, T* output);
+
+    /// @brief Forwards pass over a batch of samples. The matrix kernels
+    ///        allocate their packing buffers once per thread, on the first
+    ///        batch of more than one sample.
+    /// @param inputs batch_size x num_inputs row-major block of samples
+    /// @param batch_size number of samples, at most max_batch_size
+    /// @param outputs receives the batch_size x num_outputs block of results
+    void PredictBatch(const T* inputs, const int& batch_size, T* outputs);
+
+    /// @brief Largest batch passed to PredictBatch
+    int MaxBatchSize() const { return max_batch_size_; }
+};
@@ -0,0 +1,656 @@
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
+
+#include "kernels.h"
+#include "kernels_isa.h"
+#include "../aligned_allocator.h"
+
+namespace kernels {
+
+namespace {
+
+#if defined(__x86_64__) || defined(__i386__)
+// Reads extended control register 0, which reports the register state the
+// operating system saves on context switches
+uint64_t ReadXcr0() {
+    uint32_t eax = 0;
+    uint32_t edx = 0;
+    __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return (static_cast<uint64_t>(edx) << 32) | eax;
+}
+#endif
+
+SimdLevel& SelectedLevel() {
+    static SimdLevel level = DetectSimdLevel();
+    return level;
+}
+
+ExpMode& SelectedExpMode() {
+    static ExpMode mode = ExpMode::kExact;
+    return mode;
+}
+
+// Per thread packing buffers for the GEMM driver, allocated on first use
+template<typename T> T* PackBufferA() {
+    thread_local AlignedVector<T> buffer(kGemmPackASize);
+    return buffer.data();
+}
+
+template<typename T> T* PackBufferB() {
+    thread_local AlignedVector<T> buffer(kGemmPackBSize);
+    return buffer.data();
+}
+
+}  // namespace
+
+// =======================================
+// CPU Feature Detection
+// =======================================
+
+SimdLevel DetectSimdLevel() {
+#if defined(__x86_64__) || defined(__i386__)
+    unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+        return SimdLevel::kSse2;
+    }
+    const bool has_fma = (ecx & bit_FMA) != 0;
+    const bool has_osxsave = (ecx & bit_OSXSAVE) != 0;
+
+    // The CPU supporting an extension is not enough, the operating system
+    // must also save the wider registers
+    const uint64_t xcr0 = has_osxsave ? ReadXcr0() : 0;
+    const bool os_saves_ymm = (xcr0 & 0x6) == 0x6;
+    const bool os_saves_zmm = (xcr0 & 0xe6) == 0xe6;
+
+    if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) {
+        return SimdLevel::kSse2;
+    }
+    const bool has_avx2 = (ebx & bit_AVX2) != 0;
+    const bool has_avx512f = (ebx & bit_AVX512F) != 0;
+
+    if (has_avx512f && has_fma && os_saves_zmm) {
+        return SimdLevel::kAvx512;
+    }
+    if (has_avx2 && has_fma && os_saves_ymm) {
+        return SimdLevel::kAvx2;
+    }
+#endif
+    // Baseline of x86-64. On other architectures the same generic vector
+    // code is compiled for the native instruction set.
+    return SimdLevel::kSse2;
+}
+
+SimdLevel ActiveSimdLevel() {
+    return SelectedLevel();
+}
+
+void SetSimdLevel(const SimdLevel& level) {
+    const SimdLevel detected = DetectSimdLevel();
+    SelectedLevel() = level > detected ? detected : level;
+}
+
+const char* SimdLevelName(const SimdLevel& level) {
+    switch (level) {
+        case SimdLevel::kAvx512: return "avx512";
+        case SimdLevel::kAvx2: return "avx2";
+        case SimdLevel::kSse2: return "sse2";
+    }
+    return "unknown";
+}
+
+ExpMode ActiveExpMode() {
+    return SelectedExpMode();
+}
+
+void SetExpMode(const ExpMode& mode) {
+    SelectedExpMode() = mode;
+}
+
+const char* ExpModeName(const ExpMode& mode) {
+    switch (mode) {
+        case ExpMode::kExact: return "exact";
+        case ExpMode::kFast: return "fast";
+    }
+    return "unknown";
+}
+
+// =======================================
+// Dispatch
+// =======================================
+
+template<typename T>
+void Gemm(const Transpose& trans_a, const Transpose& trans_b,
+          const int& m, const int& n, const int& k,
+          const T& alpha, const T* a, const int& lda,
+          const T* b, const int& ldb,
+          const T& beta, T* c, const int& ldc) {
+    T* pack_a = PackBufferA<T>();
+    T* pack_b = PackBufferB<T>();
+    switch (ActiveSimdLevel()) {
+        case SimdLevel::kAvx512:
+            avx512::Gemm(trans_a, trans_b, m, n, k, alpha, a, lda, b, ldb,
+                         beta, c, ldc, pack_a, pack_b);
+            return;
+        case SimdLevel::kAvx2:
+            avx2::Gemm(trans_a, trans_b, m, n, k, alpha, a, lda, b, ldb,
+                       beta, c, ldc, pack_a, pack_b);
+            return;
+        case SimdLevel::kSse2:
+            sse2::Gemm(trans_a, trans_b, m, n, k, alpha, a, lda, b, ldb,
+                       beta, c, ldc, pack_a, pack_b);
+            return;
+    }
+}
+
+template<typename T>
+void Gemv(const Transpose& trans, const int& m, const int& n,
+          const T& alpha, const T* a, const int& lda, const T* x,
+          const T& beta, T* y) {
+    switch (ActiveSimdLevel()) {
+        case SimdLevel::kAvx512:
+            avx512::Gemv(trans, m, n, alpha, a, lda, x, beta, y);
+            return;
+        case SimdLevel::kAvx2:
+            avx2::Gemv(trans, m, n, alpha, a, lda, x, beta, y);
+            return;
+        case SimdLevel::kSse2:
+            sse2::Gemv(trans, m, n, alpha, a, lda, x, beta, y);
+            return;
+    }
+}
+
+template<typename T>
+void Ger(const int& m, const int& n, const T& alpha, const T* x, const T* y,
+         T* a, const int& lda) {
+    switch (ActiveSimdLevel()) {
+        case SimdLevel::kAvx512:
+            avx512::Ger(m, n, alpha, x, y, a, lda);
+            return;
+        case SimdLevel::kAvx2:
+            avx2::Ger(m, n, alpha, x, y, a, lda);
+            return;
+        case SimdLevel::kSse2:
+            sse2::Ger(m, n, alpha, x, y, a, lda);
+            return;
+    }
+}
+
+template<typename T>
+void Axpy(const size_t& n, const T& alpha, const T* x, T* y) {
+    switch (ActiveSimdLevel()) {
+        case SimdLevel::kAvx512:
+            avx512::Axpy(n, alpha, x, y);
+            return;
+        case SimdLevel::kAvx2:
+            avx2::Axpy(n, alpha, x, y);
+            return;
+        case SimdLevel::kSse2:
+            sse2::Axpy(n, alpha, x, y);
+            return;
+    }
+}
+
+template<typename T>
+void DenseBackward(const int& m, const int& n, const T* delta, const T* x,
+                   const T& input_scale, const T* w, const int& ldw,
+                   T* weight_gradients, T* bias_gradients, T* dx) {
+    switch (ActiveSimdLevel()) {
+        case SimdLevel::kAvx512:
+            avx512::DenseBackward(m, n, delta, x, input_scale, w, ldw,
+                                  weight_gradients, bias_gradients, dx);
+            return;
+        case SimdLevel::kAvx2:
+            avx2::DenseBackward(m, n, delta, x, input_scale, w, ldw,
+                                weight_gradients, bias_gradients, dx);
+            return;
+        case SimdLevel::kSse2:
+            sse2::DenseBackward(m, n, delta, x, input_scale, w, ldw,
+                                weight_gradients, bias_gradients, dx);
+            return;
+    }
+}
+
+template<typename T>
+void Exp(const size_t& n, const T* x, T* y) {
+    switch (ActiveSimdLevel()) {
+        case SimdLevel::kAvx512:
+            avx512::Exp(n, x, y, ActiveExpMode());
+            return;
+        case SimdLevel::kAvx2:
+            avx2::Exp(n, x, y, ActiveExpMode());
+            return;
+        case SimdLevel::kSse2:
+            sse2::Exp(n, x, y, ActiveExpMode());
+            return;
+    }
+}
+
+template<typename T>
+void Sigmoid(const size_t& n, const T* x, T* y) {
+    switch (ActiveSimdLevel()) {
+        case SimdLevel::kAvx512:
+            avx512::Sigmoid(n, x, y, ActiveExpMode());
+            return;
+        case SimdLevel::kAvx2:
+            avx2::Sigmoid(n, x, y, ActiveExpMode());
+            return;
+        case SimdLevel::kSse2:
+            sse2::Sigmoid(n, x, y, ActiveExpMode());
+            return;
+    }
+}
+
+template<typename T>
+void Tanh(const size_t& n, const T* x, T* y) {
+    switch (ActiveSimdLevel()) {
+        case SimdLevel::kAvx512:
+            avx512::Tanh(n, x, y, ActiveExpMode());
+            return;
+        case SimdLevel::kAvx2:
+            avx2::Tanh(n, x, y, ActiveExpMode());
+            return;
+        case SimdLevel::kSse2:
+            sse2::Tanh(n, x, y, ActiveExpMode());
+            return;
+    }
+}
+
+template<typename T>
+void Relu(const size_t& n, const T* x, T* y) {
+    switch (ActiveSimdLevel()) {
+        case SimdLevel::kAvx512:
+            avx512::Relu(n, x, y);
+            return;
+        case SimdLevel::kAvx2:
+            avx2::Relu(n, x, y);
+            return;
+        case SimdLevel::kSse2:
+            sse2::Relu(n, x, y);
+            return;
+    }
+}
+
+template<typename T>
+void SigmoidBackward(const size_t& n, const T* y, const T* dy, T* dx) {
+    switch (ActiveSimdLevel()) {
+        case SimdLevel::kAvx512:
+            avx512::SigmoidBackward(n, y, dy, dx);
+            return;
+        case SimdLevel::kAvx2:
+            avx2::SigmoidBackward(n, y, dy, dx);
+            return;
+        case SimdLevel::kSse2:
+            sse2::SigmoidBackward(n, y, dy, dx);
+            return;
+    }
+}
+
+template<typename T>
+void TanhBackward(const size_t& n, const T* y, const T* dy, T* dx) {
+    switch (ActiveSimdLevel()) {
+        case SimdLevel::kAvx512:
+            avx512::TanhBackward(n, y, dy, dx);
+            return;
+        case SimdLevel::kAvx2:
+            avx2::TanhBackward(n, y, dy, dx);
+            return;
+        case SimdLevel::kSse2:
+            sse2::TanhBackward(n, y, dy, dx);
+            return;
+    }
+}
+
+template<typename T>
+void ReluBackward(const size_t& n, const T* y, const T* dy, T* dx) {
+    switch (ActiveSimdLevel()) {
+        case SimdLevel::kAvx512:
+            avx512::ReluBackward(n, y, dy, dx);
+            return;
+        case SimdLevel::kAvx2:
+            avx2::ReluBackward(n, y, dy, dx);
+            return;
+        case SimdLevel::kSse2:
+            sse2::ReluBackward(n, y, dy, dx);
+            return;
+    }
+}
+
+template<typename T>
+void Multiply(const size_t& n, const T* x, T* y) {
+    switch (ActiveSimdLevel()) {
+        case SimdLevel::kAvx512:
+            avx512::Multiply(n, x, y);
+            return;
+        case SimdLevel::kAvx2:
+            avx2::Multiply(n, x, y);
+            return;
+        case SimdLevel::kSse2:
+            sse2::Multiply(n, x, y);
+            return;
+    }
+}
+
+template<typename T>
+T SquaredError(const size_t& n, const T* outputs, const T* targets,
+               T* gradients) {
+    switch (ActiveSimdLevel()) {
+        case SimdLevel::kAvx512:
+            return avx512::SquaredError(n, outputs, targets, gradients);
+        case SimdLevel::kAvx2:
+            return avx2::SquaredError(n, outputs, targets, gradients);
+        case SimdLevel::kSse2:
+            break;
+    }
+    return sse2::SquaredError(n, outputs, targets, gradients);
+}
+
+template<typename T>
+T SoftmaxCrossEntropy(const int& rows, const int& cols, const T* logits,
+                      const T* targets, T* gradients) {
+    switch (ActiveSimdLevel()) {
+        case SimdLevel::kAvx512:
+            return avx512::SoftmaxCrossEntropy(rows, cols, logits, targets,
+                                               gradients, ActiveExpMode());
+        case SimdLevel::kAvx2:
+            return avx2::SoftmaxCrossEntropy(rows, cols, logits, targets,
+                                             gradients, ActiveExpMode());
+        case SimdLevel::kSse2:
+            break;
+    }
+    return sse2::SoftmaxCrossEntropy(rows, cols, logits, targets, gradients,
+                                     ActiveExpMode());
+}
+
+template<typename T>
+void MomentumUpdate(const size_t& n, const T& learning_rate,
+                    const T& momentum, const bool& nesterov,
+                    const T& gradient_scale, const T* gradients, T* velocity,
+                    T* params) {
+    switch (ActiveSimdLevel()) {
+        case SimdLevel::kAvx512:
+            avx512::MomentumUpdate(n, learning_rate, momentum, nesterov,
+                                   gradient_scale, gradients, velocity,
+                                   params);
+            return;
+        case SimdLevel::kAvx2:
+            avx2::MomentumUpdate(n, learning_rate, momentum, nesterov,
+                                 gradient_scale, gradients, velocity, params);
+            return;
+        case SimdLevel::kSse2:
+            sse2::MomentumUpdate(n, learning_rate, momentum, nesterov,
+                                 gradient_scale, gradients, velocity, params);
+            return;
+    }
+}
+
+template<typename T>
+void AdamUpdate(const size_t& n, const T& step_size, const T& beta1,
+                const T& beta2, const T& epsilon,
+                const T& second_moment_correction, const T& gradient_scale,
+                const T* gradients, T* first_moment, T* second_moment,
+                T* params) {
+    switch (ActiveSimdLevel()) {
+        case SimdLevel::kAvx512:
+            avx512::AdamUpdate(n, step_size, beta1, beta2, epsilon,
+                               second_moment_correction, gradient_scale,
+                               gradients, first_moment, second_moment,
+                               params);
+            return;
+        case SimdLevel::kAvx2:
+            avx2::AdamUpdate(n, step_size, beta1, beta2, epsilon,
+                             second_moment_correction, gradient_scale,
+                             gradients, first_moment, second_moment, params);
+            return;
+        case SimdLevel::kSse2:
+            sse2::AdamUpdate(n, step_size, beta1, beta2, epsilon,
+                             second_moment_correction, gradient_scale,
+                             gradients, first_moment, second_moment, params);
+            return;
+    }
+}
+
+template<typename T>
+void HogwildUpdate(const size_t& n, const T& alpha, T* gradients, T* params) {
+    switch (ActiveSimdLevel()) {
+        case SimdLevel::kAvx512:
+            avx512::HogwildUpdate(n, alpha, gradients, params);
+            return;
+        case SimdLevel::kAvx2:
+            avx2::HogwildUpdate(n, alpha, gradients, params);
+            return;
+        case SimdLevel::kSse2:
+            sse2::HogwildUpdate(n, alpha, gradients, params);
+            return;
+    }
+}
+
+void Philox(const size_t& n, const uint64_t& seed, const uint64_t& stream,
+            const uint64_t& first, uint32_t* out) {
+    switch (ActiveSimdLevel()) {
+        case SimdLevel::kAvx512:
+            avx512::Philox(n, seed, stream, first, out);
+            return;
+        case SimdLevel::kAvx2:
+            avx2::Philox(n, seed, stream, first, out);
+            return;
+        case SimdLevel::kSse2:
+            sse2::Philox(n, seed, stream, first, out);
+            return;
+    }
+}
+
+template<typename T>
+void RandomUniform(const size_t& n, const uint64_t& seed,
+                   const uint64_t& stream, const uint64_t& first,
+                   const T& min, const T& max, T* out) {
+    switch (ActiveSimdLevel()) {
+        case SimdLevel::kAvx512:
+            avx512::RandomUniform(n, seed, stream, first, min, max, out);
+            return;
+        case SimdLevel::kAvx2:
+            avx2::RandomUniform(n, seed, stream, first, min, max, out);
+            return;
+        case SimdLevel::kSse2:
+            sse2::RandomUniform(n, seed, stream, first, min, max, out);
+            return;
+    }
+}
+
+template<typename T>
+void QuantizeInt8(const size_t& n, const T* x, const T& inv_scale, int8_t* q) {
+    switch (ActiveSimdLevel()) {
+        case SimdLevel::kAvx512:
+            avx512::QuantizeInt8(n, x, inv_scale, q);
+            return;
+        case SimdLevel::kAvx2:
+            avx2::QuantizeInt8(n, x, inv_scale, q);
+            return;
+        case SimdLevel::kSse2:
+            sse2::QuantizeInt8(n, x, inv_scale, q);
+            return;
+    }
+}
+
+template<typename T>
+void QuantizedGemv(const int& m, const int& n, const int8_t* a,
+                   const int& lda, const int8_t* x, const T* scales,
+                   const T* bias, T* y) {
+    switch (ActiveSimdLevel()) {
+        case SimdLevel::kAvx512:
+            avx512::QuantizedGemv(m, n, a, lda, x, scales, bias, y);
+            return;
+        case SimdLevel::kAvx2:
+            avx2::QuantizedGemv(m, n, a, lda, x, scales, bias, y);
+            return;
+        case SimdLevel::kSse2:
+            sse2::QuantizedGemv(m, n, a, lda, x, scales, bias, y);
+            return;
+    }
+}
+
+template<typename T>
+void SparseGemv(const int& m, const int* row_offsets, const int* columns,
+                const T* values, const T* x, T* y) {
+    switch (ActiveSimdLevel()) {
+        case SimdLevel::kAvx512:
+            avx512::SparseGemv(m, row_offsets, columns, values, x, y);
+            return;
+        case SimdLevel::kAvx2:
+            avx2::SparseGemv(m, row_offsets, columns, values, x, y);
+            return;
+        case SimdLevel::kSse2:
+            sse2::SparseGemv(m, row_offsets, columns, values, x, y);
+            return;
+    }
+}
+
+template<typename T>
+void SparseGemm(const int& m, const int& n, const int* row_offsets,
+                const int* columns, const T* values, const T* b,
+                const int& ldb, T* c, const int& ldc) {
+    switch (ActiveSimdLevel()) {
+        case SimdLevel::kAvx512:
+            avx512::SparseGemm(m, n, row_offsets, columns, values, b, ldb,
+                               c, ldc);
+            return;
+        case SimdLevel::kAvx2:
+            avx2::SparseGemm(m, n, row_offsets, columns, values, b, ldb,
+                             c, ldc);
+            return;
+        case SimdLevel::kSse2:
+            sse2::SparseGemm(m, n, row_offsets, columns, values, b, ldb,
+                             c, ldc);
+            return;
+    }
+}
+
+template<typename T>
+void TransposeMatrix(const int& m, const int& n, const T* a, const int& lda,
+                     T* b, const int& ldb) {
+    switch (ActiveSimdLevel()) {
+        case SimdLevel::kAvx512:
+            avx512::TransposeMatrix(m, n, a, lda, b, ldb);
+            return;
+        case SimdLevel::kAvx2:
+            avx2::TransposeMatrix(m, n, a, lda, b, ldb);
+            return;
+        case SimdLevel::kSse2:
+            sse2::TransposeMatrix(m, n, a, lda, b, ldb);
+            return;
+    }
+}
+
+template void Gemm<float>(const Transpose&, const Transpose&, const int&,
+                          const int&, const int&, const float&, const float*,
+                          const int&, const float*, const int&, const float&,
+                          float*, const int&);
+template void Gemm<double>(const Transpose&, const Transpose&, const int&,
+                           const int&, const int&, const double&,
+                           const double*, const int&, const double*,
+                           const int&, const double&, double*, const int&);
+template void Gemv<float>(const Transpose&, const int&, const int&,
+                          const float&, const float*, const int&,
+                          const float*, const float&, float*);
+template void Gemv<double>(const Transpose&, const int&, const int&,
+                           const double&, const double*, const int&,
+                           const double*, const double&, double*);
+template void Ger<float>(const int&, const int&, const float&, const float*,
+                         const float*, float*, const int&);
+template void Ger<double>(const int&, const int&, const double&,
+                          const double*, const double*, double*, const int&);
+template void Axpy<float>(const size_t&, const float&, const float*, float*);
+template void Axpy<double>(const size_t&, const double&, const double*,
+                           double*);
+template void DenseBackward<float>(const int&, const int&, const float*,
+                                  const float*, const float&, const float*,
+                                  const int&, float*, float*, float*);
+template void DenseBackward<double>(const int&, const int&, const double*,
+                                   const double*, const double&,
+                                   const double*, const int&, double*,
+                                   double*, double*);
+template void Exp<float>(const size_t&, const float*, float*);
+template void Exp<double>(const size_t&, const double*, double*);
+template void Sigmoid<float>(const size_t&, const float*, float*);
+template void Sigmoid<double>(const size_t&, const double*, double*);
+template void Tanh<float>(const size_t&, const float*, float*);
+template void Tanh<double>(const size_t&, const double*, double*);
+template void Relu<float>(const size_t&, const float*, float*);
+template void Relu<double>(const size_t&, const double*, double*);
+template void SigmoidBackward<float>(const size_t&, const float*,
+                                     const float*, float*);
+template void SigmoidBackward<double>(const size_t&, const double*,
+                                      const double*, double*);
+template void TanhBackward<float>(const size_t&, const float*, const float*,
+                                  float*);
+template void TanhBackward<double>(const size_t&, const double*,
+                                   const double*, double*);
+template void ReluBackward<float>(const size_t&, const float*, const float*,
+                                  float*);
+template void ReluBackward<double>(const size_t&, const double*,
+                                   const double*, double*);
+template void Multiply<float>(const size_t&, const float*, float*);
+template void Multiply<double>(const size_t&, const double*, double*);
+template float SquaredError<float>(const size_t&, const float*, const float*,
+                                   float*);
+template double SquaredError<double>(const size_t&, const double*,
+                                     const double*, double*);
+template float SoftmaxCrossEntropy<float>(const int&, const int&,
+                                          const float*, const float*,
+                                          float*);
+template double SoftmaxCrossEntropy<double>(const int&, const int&,
+                                            const double*, const double*,
+                                            double*);
+template void MomentumUpdate<float>(const size_t&, const float&, const float&,
+                                    const bool&, const float&, const float*,
+                                    float*, float*);
+template void MomentumUpdate<double>(const size_t&, const double&,
+                                     const double&, const bool&,
+                                     const double&, const double*, double*,
+                                     double*);
+template void AdamUpdate<float>(const size_t&, const float&, const float&,
+                                const float&, const float&, const float&,
+                                const float&, const float*, float*, float*,
+                                float*);
+template void AdamUpdate<double>(const size_t&, const double&, const double&,
+                                 const double&, const double&, const double&,
+                                 const double&, const double*, double*,
+                                 double*, double*);
+template void HogwildUpdate<float>(const size_t&, const float&, float*,
+                                   float*);
+template void HogwildUpdate<double>(const size_t&, const double&, double*,
+                                    double*);
+template void RandomUniform<float>(const size_t&, const uint64_t&,
+                                   const uint64_t&, const uint64_t&,
+                                   const float&, const float&, float*);
+template void RandomUniform<double>(const size_t&, const uint64_t&,
+                                    const uint64_t&, const uint64_t&,
+                                    const double&, const double&, double*);
+template void QuantizeInt8<float>(const size_t&, const float*, const float&,
+                                  int8_t*);
+template void QuantizeInt8<double>(const size_t&, const double*,
+                                   const double&, int8_t*);
+template void QuantizedGemv<float>(const int&, const int&, const int8_t*,
+                                   const int&, const int8_t*, const float*,
+                                   const float*, float*);
+template void QuantizedGemv<double>(const int&, const int&, const int8_t*,
+                                    const int&, const int8_t*, const double*,
+                                    const double*, double*);
+template void SparseGemv<float>(const int&, const int*, const int*,
+                                const float*, const float*, float*);
+template void SparseGemv<double>(const int&, const int*, const int*,
+                                 const double*, const double*, double*);
+template void SparseGemm<float>(const int&, const int&, const int*,
+                                const int*, const float*, const float*,
+                                const int&, float*, const int&);
+template void SparseGemm<double>(const int&, const int&, const int*,
+                                 const int*, const double*, const double*,
+                                 const int&, double*, const int&);
+template void TransposeMatrix<float>(const int&, const int&, const float*,
+                                     const int&, float*, const int&);
+template void TransposeMatrix<double>(const int&, const int&, const double*,
+                                      const int&, double*, const int&);
+
+}  // namespace kernels
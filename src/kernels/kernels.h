@@ -0,0 +1,436 @@
+#pragma once
+
+/*
+    Dependency-free dense linear algebra kernels used by the network layers.
+
+    Every kernel has a vectorised implementation for each supported
+    instruction set extension (SSE2, AVX2 + FMA, AVX-512F + FMA). The widest
+    extension supported by the CPU and operating system is detected once via
+    cpuid at startup and used for every call.
+
+    All matrices are row-major. The leading dimension of a matrix is the
+    distance in elements between the start of consecutive rows.
+*/
+
+#include <cstddef>
+#include <cstdint>
+
+namespace kernels {
+
+/// @brief Instruction set extensions the kernels are compiled for, in order
+///        of increasing vector width
+enum class SimdLevel {
+    kSse2,
+    kAvx2,
+    kAvx512,
+};
+
+/// @brief Whether a matrix operand is used as stored or transposed
+enum class Transpose {
+    kNo,
+    kYes,
+};
+
+/// @brief How the exponential in the Exp, Sigmoid, Tanh and
+///        SoftmaxCrossEntropy kernels is evaluated
+enum class ExpMode {
+    // The C library exp and tanh, correct to within an ulp or so
+    kExact,
+    // Vectorised polynomial approximation. Relative error of e^x is below
+    // 4e-7 for float and 2e-7 for double for x in [-87, 88] (float) or
+    // [-708, 709] (double), outside which the input is clamped. Sigmoid and
+    // tanh inherit an absolute error below 1e-6.
+    kFast,
+};
+
+/// @brief Detects the widest instruction set extension supported by this CPU
+///        and operating system
+/// @return detected level
+SimdLevel DetectSimdLevel();
+
+/// @brief Level used by every kernel call. Defaults to DetectSimdLevel().
+/// @return active level
+SimdLevel ActiveSimdLevel();
+
+/// @brief Overrides the level used by every kernel call, for benchmarking and
+///        comparing implementations. Levels above DetectSimdLevel() are
+///        clamped to it.
+/// @param level requested level
+void SetSimdLevel(const SimdLevel& level);
+
+/// @brief Human readable name of a level, e.g. "avx2"
+const char* SimdLevelName(const SimdLevel& level);
+
+/// @brief Mode used by the Exp, Sigmoid and Tanh kernels. Defaults to
+///        ExpMode::kExact.
+/// @return active mode
+ExpMode ActiveExpMode();
+
+/// @brief Sets the mode used by the Exp, Sigmoid and Tanh kernels. Not
+///        synchronised; set it before starting any threads that use them.
+/// @param mode requested mode
+void SetExpMode(const ExpMode& mode);
+
+/// @brief Human readable name of a mode, e.g. "fast"
+const char* ExpModeName(const ExpMode& mode);
+
+/// @brief General matrix multiply, C = alpha * op(A) * op(B) + beta * C.
+///        Cache blocked and register tiled. When beta is zero C is not read.
+/// @tparam T float or double
+/// @param trans_a whether A is transposed
+/// @param trans_b whether B is transposed
+/// @param m rows of op(A) and C
+/// @param n columns of op(B) and C
+/// @param k columns of op(A) and rows of op(B)
+/// @param alpha scale of the product
+/// @param a matrix A, m x k if not transposed, otherwise k x m
+/// @param lda leading dimension of A
+/// @param b matrix B, k x n if not transposed, otherwise n x k
+/// @param ldb leading dimension of B
+/// @param beta scale of the existing contents of C
+/// @param c matrix C, m x n
+/// @param ldc leading dimension of C
+template<typename T>
+void Gemm(const Transpose& trans_a, const Transpose& trans_b,
+          const int& m, const int& n, const int& k,
+          const T& alpha, const T* a, const int& lda,
+          const T* b, const int& ldb,
+          const T& beta, T* c, const int& ldc);
+
+/// @brief General matrix-vector multiply, y = alpha * op(A) * x + beta * y.
+///        When beta is zero y is not read.
+/// @tparam T float or double
+/// @param trans whether A is transposed
+/// @param m rows of A
+/// @param n columns of A
+/// @param alpha scale of the product
+/// @param a matrix A, m x n
+/// @param lda leading dimension of A
+/// @param x vector of n elements if A is not transposed, otherwise m
+/// @param beta scale of the existing contents of y
+/// @param y vector of m elements if A is not transposed, otherwise n
+template<typename T>
+void Gemv(const Transpose& trans, const int& m, const int& n,
+          const T& alpha, const T* a, const int& lda, const T* x,
+          const T& beta, T* y);
+
+/// @brief Rank one update, A = alpha * x * y^T + A
+/// @tparam T float or double
+/// @param m rows of A and elements of x
+/// @param n columns of A and elements of y
+/// @param alpha scale of the outer product
+/// @param x column vector
+/// @param y row vector
+/// @param a matrix A, m x n
+/// @param lda leading dimension of A
+template<typename T>
+void Ger(const int& m, const int& n, const T& alpha, const T* x, const T* y,
+         T* a, const int& lda);
+
+/// @brief Scaled vector addition, y = alpha * x + y
+/// @tparam T float or double
+/// @param n number of elements
+/// @param alpha scale of x
+/// @param x vector added
+/// @param y vector updated in place
+template<typename T>
+void Axpy(const size_t& n, const T& alpha, const T* x, T* y);
+
+/// @brief Backwards pass of a dense layer for one sample, in a single sweep
+///        over the weight matrix and its gradients: weight_gradients +=
+///        delta * x^T, bias_gradients += delta and
+///        dx = input_scale * W^T * delta
+/// @tparam T float or double
+/// @param m neurons, rows of W and elements of delta
+/// @param n inputs, columns of W and elements of x and dx
+/// @param delta cost relative to each neuron's weighted sum
+/// @param x input to the layer
+/// @param input_scale scale of dx
+/// @param w weight matrix W, m x n
+/// @param ldw leading dimension of W and of the weight gradients
+/// @param weight_gradients m x n matrix of gradients, updated in place
+/// @param bias_gradients m gradients, updated in place
+/// @param dx receives the cost relative to each input, or null to skip it
+template<typename T>
+void DenseBackward(const int& m, const int& n, const T* delta, const T* x,
+                   const T& input_scale, const T* w, const int& ldw,
+                   T* weight_gradients, T* bias_gradients, T* dx);
+
+// Element-wise kernels. Each may be called in place, with the output equal
+// to an input. The backward kernels take the activated output y rather than
+// the input x, and multiply the derivative by the incoming gradient dy.
+
+/// @brief Exponential, y = e^x, evaluated according to ActiveExpMode()
+/// @tparam T float or double
+/// @param n number of elements
+/// @param x input vector
+/// @param y output vector
+template<typename T>
+void Exp(const size_t& n, const T* x, T* y);
+
+/// @brief Logistic sigmoid, y = 1 / (1 + e^-x), evaluated according to
+///        ActiveExpMode()
+/// @tparam T float or double
+/// @param n number of elements
+/// @param x input vector
+/// @param y output vector
+template<typename T>
+void Sigmoid(const size_t& n, const T* x, T* y);
+
+/// @brief Hyperbolic tangent, y = tanh(x), evaluated according to
+///        ActiveExpMode()
+/// @tparam T float or double
+/// @param n number of elements
+/// @param x input vector
+/// @param y output vector
+template<typename T>
+void Tanh(const size_t& n, const T* x, T* y);
+
+/// @brief Rectified linear unit, y = max(x, 0)
+/// @tparam T float or double
+/// @param n number of elements
+/// @param x input vector
+/// @param y output vector
+template<typename T>
+void Relu(const size_t& n, const T* x, T* y);
+
+/// @brief Gradient through a sigmoid, dx = dy * y * (1 - y)
+/// @tparam T float or double
+/// @param n number of elements
+/// @param y output of Sigmoid
+/// @param dy gradient with respect to y
+/// @param dx receives the gradient with respect to x
+template<typename T>
+void SigmoidBackward(const size_t& n, const T* y, const T* dy, T* dx);
+
+/// @brief Gradient through a tanh, dx = dy * (1 - y^2)
+/// @tparam T float or double
+/// @param n number of elements
+/// @param y output of Tanh
+/// @param dy gradient with respect to y
+/// @param dx receives the gradient with respect to x
+template<typename T>
+void TanhBackward(const size_t& n, const T* y, const T* dy, T* dx);
+
+/// @brief Gradient through a rectified linear unit, dx = dy where y > 0,
+///        otherwise 0
+/// @tparam T float or double
+/// @param n number of elements
+/// @param y output of Relu
+/// @param dy gradient with respect to y
+/// @param dx receives the gradient with respect to x
+template<typename T>
+void ReluBackward(const size_t& n, const T* y, const T* dy, T* dx);
+
+/// @brief Element-wise product, y = x * y, e.g. applying a mask of zeros and
+///        ones
+/// @tparam T float or double
+/// @param n number of elements
+/// @param x vector multiplied in
+/// @param y vector updated in place
+template<typename T>
+void Multiply(const size_t& n, const T* x, T* y);
+
+// Loss kernels. Each returns the loss summed over its inputs and, unless
+// gradients is null, writes the gradient of the loss relative to each
+// output in the same pass. gradients may equal outputs or logits.
+
+/// @brief Squared error, sum((outputs - targets)^2), with gradients
+///        2 * (outputs - targets)
+/// @tparam T float or double
+/// @param n number of elements
+/// @param outputs network outputs
+/// @param targets desired outputs
+/// @param gradients receives the gradient of each output, or null to skip it
+/// @return summed squared error
+template<typename T>
+T SquaredError(const size_t& n, const T* outputs, const T* targets,
+               T* gradients);
+
+/// @brief Cross entropy of the softmax of each row of logits against a row
+///        of target probabilities, -sum(targets * log(softmax(logits))),
+///        with gradients softmax(logits) * sum(targets) - targets, i.e.
+///        softmax(logits) - targets for one-hot targets. The largest logit
+///        of each row is subtracted before exponentiating, so any finite
+///        logits are stable. The exponential is evaluated according to
+///        ActiveExpMode().
+/// @tparam T float or double
+/// @param rows number of samples
+/// @param cols number of classes
+/// @param logits rows x cols block of unnormalised log probabilities
+/// @param targets rows x cols block of target probabilities
+/// @param gradients receives the rows x cols gradients, or null to skip them
+/// @return cross entropy summed over the rows
+template<typename T>
+T SoftmaxCrossEntropy(const int& rows, const int& cols, const T* logits,
+                      const T* targets, T* gradients);
+
+// Fused optimizer updates. Each reads the summed gradients, scales them by
+// gradient_scale, e.g. one over the batch size, and updates the optimizer
+// state and parameters in place in a single pass.
+
+/// @brief Heavy ball or Nesterov momentum update, v = momentum * v + g then
+///        p -= learning_rate * v, or for Nesterov
+///        p -= learning_rate * (g + momentum * v)
+/// @tparam T float or double
+/// @param n number of parameters
+/// @param learning_rate step size
+/// @param momentum decay of the velocity
+/// @param nesterov whether to apply Nesterov's look ahead
+/// @param gradient_scale scale applied to each gradient
+/// @param gradients summed gradients g
+/// @param velocity velocity v, updated in place
+/// @param params parameters p, updated in place
+template<typename T>
+void MomentumUpdate(const size_t& n, const T& learning_rate,
+                    const T& momentum, const bool& nesterov,
+                    const T& gradient_scale, const T* gradients, T* velocity,
+                    T* params);
+
+/// @brief Adam update, m = beta1 * m + (1 - beta1) * g and
+///        v = beta2 * v + (1 - beta2) * g^2, then
+///        p -= step_size * m / (sqrt(v * second_moment_correction) + epsilon).
+///        The first moment bias correction is folded into step_size.
+/// @tparam T float or double
+/// @param n number of parameters
+/// @param step_size learning rate / (1 - beta1^t) at step t
+/// @param beta1 decay of the first moment
+/// @param beta2 decay of the second moment
+/// @param epsilon added to the denominator for stability
+/// @param second_moment_correction 1 / (1 - beta2^t) at step t
+/// @param gradient_scale scale applied to each gradient
+/// @param gradients summed gradients g
+/// @param first_moment first moment m, updated in place
+/// @param second_moment second moment v, updated in place
+/// @param params parameters p, updated in place
+template<typename T>
+void AdamUpdate(const size_t& n, const T& step_size, const T& beta1,
+                const T& beta2, const T& epsilon,
+                const T& second_moment_correction, const T& gradient_scale,
+                const T* gradients, T* first_moment, T* second_moment,
+                T* params);
+
+/// @brief Lock-free SGD step on parameters shared between threads,
+///        p += alpha * g for every nonzero gradient, which is then reset to
+///        zero. Each parameter is read and written with relaxed atomic
+///        accesses, so concurrent updates may overwrite one another but no
+///        value is ever torn. Parameters with a zero gradient are not
+///        accessed, so sparse gradients touch few shared cache lines.
+/// @tparam T float or double
+/// @param n number of parameters
+/// @param alpha scale of each gradient, e.g. -learning_rate
+/// @param gradients gradients g, thread private, reset to zero
+/// @param params shared parameters p, updated in place
+template<typename T>
+void HogwildUpdate(const size_t& n, const T& alpha, T* gradients, T* params);
+
+// Random number kernels. Counter-based: every value is a pure function of a
+// seed, a stream and its index, with no state carried between values, so any
+// range can be generated on any thread, in any order, with identical results.
+
+/// @brief Philox4x32-10 counter-based random number generator (Salmon et
+///        al., "Parallel Random Numbers: As Easy as 1, 2, 3", SC 2011). Block
+///        i is ten rounds of Philox over the 128 bit counter made of the
+///        block index first + i (low 64 bits) and stream (high 64 bits),
+///        keyed by seed, giving four independent uniform 32 bit words.
+/// @param n number of blocks
+/// @param seed 64 bit key
+/// @param stream independent sequence for the key
+/// @param first index of the first block
+/// @param out receives n x 4 words, block by block
+void Philox(const size_t& n, const uint64_t& seed, const uint64_t& stream,
+            const uint64_t& first, uint32_t* out);
+
+/// @brief Uniform random values between min and max. Value i comes from
+///        Philox block first + i of (seed, stream): the top 23 bits of its
+///        first word for float, or 52 bits of its first two words for
+///        double, as the mantissa of a value in [0, 1).
+/// @tparam T float or double
+/// @param n number of values
+/// @param seed 64 bit key
+/// @param stream independent sequence for the key
+/// @param first index of the first value
+/// @param min smallest value
+/// @param max largest value, reached only through rounding
+/// @param out receives the n values
+template<typename T>
+void RandomUniform(const size_t& n, const uint64_t& seed,
+                   const uint64_t& stream, const uint64_t& first,
+                   const T& min, const T& max, T* out);
+
+// Quantized kernels. int8 values lie in [-127, 127], so that the product of
+// two fits in an int16 and the sum of two products cannot overflow one.
+
+/// @brief Quantizes values to int8, q = clamp(round(x * inv_scale), -127, 127)
+/// @tparam T float or double
+/// @param n number of elements
+/// @param x input vector
+/// @param inv_scale reciprocal of the value of one quantization step
+/// @param q receives the quantized values
+template<typename T>
+void QuantizeInt8(const size_t& n, const T* x, const T& inv_scale, int8_t* q);
+
+/// @brief Matrix-vector product of int8 values with int32 accumulation,
+///        converted back to floating point per row: y = scales * (A * x) + bias
+/// @tparam T float or double
+/// @param m rows of A, elements of y
+/// @param n columns of A, elements of x
+/// @param a int8 matrix A
+/// @param lda leading dimension of A
+/// @param x int8 vector
+/// @param scales value of one unit of each row's int32 sum
+/// @param bias added to each element of y
+/// @param y output vector
+template<typename T>
+void QuantizedGemv(const int& m, const int& n, const int8_t* a,
+                   const int& lda, const int8_t* x, const T* scales,
+                   const T* bias, T* y);
+
+// Sparse kernels. A sparse m x n matrix is stored in compressed sparse row
+// form: the nonzero values of row i and their column indices are held at
+// positions row_offsets[i] to row_offsets[i + 1] of values and columns.
+
+/// @brief Sparse matrix-vector multiply, y = A * x + y
+/// @tparam T float or double
+/// @param m rows of A, elements of y
+/// @param row_offsets m + 1 offsets of each row's first nonzero
+/// @param columns column of each nonzero
+/// @param values value of each nonzero
+/// @param x dense vector with an element per column of A
+/// @param y output vector, updated in place
+template<typename T>
+void SparseGemv(const int& m, const int* row_offsets, const int* columns,
+                const T* values, const T* x, T* y);
+
+/// @brief Sparse matrix by dense matrix multiply, C = A * B + C. Each nonzero
+///        of A scales a contiguous row of B, so B and C are best laid out
+///        with one row per feature and one column per sample.
+/// @tparam T float or double
+/// @param m rows of A and C
+/// @param n columns of B and C
+/// @param row_offsets m + 1 offsets of each row's first nonzero
+/// @param columns column of each nonzero
+/// @param values value of each nonzero
+/// @param b dense matrix B with a row per column of A
+/// @param ldb leading dimension of B
+/// @param c dense matrix C, m x n, updated in place
+/// @param ldc leading dimension of C
+template<typename T>
+void SparseGemm(const int& m, const int& n, const int* row_offsets,
+                const int* columns, const T* values, const T* b,
+                const int& ldb, T* c, const int& ldc);
+
+/// @brief Out of place transpose, B = A^T, e.g. to switch a block of samples
+///        between one row per sample and one row per feature
+/// @tparam T float or double
+/// @param m rows of A, columns of B
+/// @param n columns of A, rows of B
+/// @param a matrix A, m x n
+/// @param lda leading dimension of A
+/// @param b matrix B, n x m
+/// @param ldb leading dimension of B
+template<typename T>
+void TransposeMatrix(const int& m, const int& n, const T* a, const int& lda,
+                     T* b, const int& ldb);
+
+}  // namespace kernels
@@ -0,0 +1,5 @@
+// Kernels compiled with AVX2 and FMA enabled, see the makefile
+#define KERNELS_ISA avx2
+#define KERNELS_VEC_BYTES 32
+
+#include "kernels_impl.h"
@@ -0,0 +1,5 @@
+// Kernels compiled with AVX-512F and FMA enabled, see the makefile
+#define KERNELS_ISA avx512
+#define KERNELS_VEC_BYTES 64
+
+#include "kernels_impl.h"
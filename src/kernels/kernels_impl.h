@@ -0,0 +1,1535 @@
+/*
+    Generic vectorised kernel implementation, written with GCC/Clang vector
+    extensions so one source serves every instruction set. Included once by
+    each kernels_<isa>.cpp, which compiles it with that extension enabled and
+    first defines:
+
+        KERNELS_ISA        namespace of the implementation, e.g. avx2
+        KERNELS_VEC_BYTES  width of a vector register in bytes
+
+    Helpers have internal linkage and the standard library is not used, so
+    that code compiled for a wide extension can never be picked by the linker
+    in place of a baseline copy of the same inline function.
+*/
+
+#include <cstddef>
+
+#include "kernels_isa.h"
+
+namespace kernels {
+namespace KERNELS_ISA {
+namespace {
+
+/// @brief Vector type and register tile for one element type
+/// @tparam T float or double
+template<typename T>
+struct Simd {
+    typedef T Vec __attribute__((vector_size(KERNELS_VEC_BYTES)));
+    static constexpr int kLanes = KERNELS_VEC_BYTES / sizeof(T);
+    // Register tile of the GEMM micro kernel. Rows times two vectors of
+    // accumulators, plus two vectors of B and one broadcast of A, fit in the
+    // 16 vector registers of SSE2 and AVX2, or the 32 of AVX-512.
+    static constexpr int kMr = KERNELS_VEC_BYTES >= 64 ? 8 : 6;
+    static constexpr int kNr = 2 * kLanes;
+};
+
+template<typename Vec, typename T>
+inline Vec Load(const T* ptr) {
+    Vec v;
+    __builtin_memcpy(&v, ptr, sizeof(v));
+    return v;
+}
+
+template<typename Vec, typename T>
+inline void Store(T* ptr, const Vec& v) {
+    __builtin_memcpy(ptr, &v, sizeof(v));
+}
+
+template<typename Vec, typename T>
+inline Vec Broadcast(const T& value) {
+    Vec v = {};
+    return v + value;
+}
+
+template<typename T, typename Vec>
+inline T HorizontalSum(const Vec& v, const int& lanes) {
+    T sum = 0;
+    for (int i = 0; i < lanes; i++) {
+        sum += v[i];
+    }
+    return sum;
+}
+
+inline int MinInt(const int& a, const int& b) {
+    return a < b ? a : b;
+}
+
+// =======================================
+// Exponential
+// =======================================
+
+/// @brief Constants of the fast exponential for one element type
+/// @tparam T float or double
+template<typename T> struct ExpConstants;
+
+template<> struct ExpConstants<float> {
+    // Signed integer of the same width as the element
+    typedef int Int;
+    // Inputs are clamped so that 2^n stays a normal number
+    static constexpr float kMin = -87.0f;
+    static constexpr float kMax = 88.0f;
+    // Adding and subtracting 1.5 * 2^23 rounds to the nearest integer
+    static constexpr float kRound = 12582912.0f;
+    static constexpr int kBias = 127;
+    static constexpr int kMantissaBits = 23;
+};
+
+template<> struct ExpConstants<double> {
+    typedef long long Int;
+    static constexpr double kMin = -708.0;
+    static constexpr double kMax = 709.0;
+    static constexpr double kRound = 6755399441055744.0;
+    static constexpr long long kBias = 1023;
+    static constexpr int kMantissaBits = 52;
+};
+
+/// @brief Fast approximate e^x. Reduces x = n * ln(2) + r with |r| <= ln(2)/2,
+///        evaluates a degree 6 Taylor polynomial of e^r, and scales by 2^n by
+///        building its exponent bits directly. Inputs are clamped to
+///        [kMin, kMax]; NaN inputs are not handled.
+template<typename T, typename Vec>
+inline Vec FastExp(Vec x) {
+    using C = ExpConstants<T>;
+    typedef typename C::Int IVec
+                __attribute__((vector_size(KERNELS_VEC_BYTES)));
+    // ln(2) split in two so that n * kLn2Hi is exact
+    constexpr T kLn2Hi = T(0.693145751953125);
+    constexpr T kLn2Lo = T(1.42860682030941723212e-6);
+    constexpr T kLog2E = T(1.44269504088896340736);
+
+    const Vec lo = Broadcast<Vec>(T(C::kMin));
+    const Vec hi = Broadcast<Vec>(T(C::kMax));
+    x = x < lo ? lo : x;
+    x = x > hi ? hi : x;
+
+    const Vec round = Broadcast<Vec>(T(C::kRound));
+    const Vec n = (x * kLog2E + round) - round;
+    const Vec r = (x - n * kLn2Hi) - n * kLn2Lo;
+
+    Vec p = Broadcast<Vec>(T(1.0 / 720));
+    p = p * r + T(1.0 / 120);
+    p = p * r + T(1.0 / 24);
+    p = p * r + T(1.0 / 6);
+    p = p * r + T(0.5);
+    p = p * r + T(1);
+    p = p * r + T(1);
+
+    const IVec bits = (__builtin_convertvector(n, IVec) + C::kBias)
+                      << C::kMantissaBits;
+    return p * (Vec)bits;
+}
+
+// =======================================
+// Level 1 and 2 Kernels
+// =======================================
+
+template<typename T>
+void AxpyImpl(const size_t& n, const T& alpha, const T* x, T* y) {
+    using S = Simd<T>;
+    using Vec = typename S::Vec;
+
+    const Vec alpha_v = Broadcast<Vec>(alpha);
+    size_t i = 0;
+    for (; i + 2 * S::kLanes <= n; i += 2 * S::kLanes) {
+        Store(y + i, Load<Vec>(y + i) + alpha_v * Load<Vec>(x + i));
+        Store(y + i + S::kLanes, Load<Vec>(y + i + S::kLanes)
+                                 + alpha_v * Load<Vec>(x + i + S::kLanes));
+    }
+    for (; i < n; i++) {
+        y[i] += alpha * x[i];
+    }
+}
+
+template<typename T>
+void GemvImpl(const Transpose& trans, const int& m, const int& n,
+              const T& alpha, const T* a, const int& lda, const T* x,
+              const T& beta, T* y) {
+    using S = Simd<T>;
+    using Vec = typename S::Vec;
+    constexpr int kRows = 4;
+
+    if (trans == Transpose::kNo) {
+        // y_i = alpha * dot(A_i, x) + beta * y_i, several rows at a time so
+        // each load of x is shared
+        int i = 0;
+        for (; i + kRows <= m; i += kRows) {
+            Vec acc[kRows] = {};
+            int j = 0;
+            for (; j + S::kLanes <= n; j += S::kLanes) {
+                const Vec xv = Load<Vec>(x + j);
+                for (int r = 0; r < kRows; r++) {
+                    acc[r] += Load<Vec>(a + static_cast<size_t>(i + r) * lda
+                                        + j) * xv;
+                }
+            }
+            for (int r = 0; r < kRows; r++) {
+                const T* row = a + static_cast<size_t>(i + r) * lda;
+                T sum = HorizontalSum<T>(acc[r], S::kLanes);
+                for (int jt = j; jt < n; jt++) {
+                    sum += row[jt] * x[jt];
+                }
+                y[i + r] = alpha * sum + (beta == 0 ? 0 : beta * y[i + r]);
+            }
+        }
+        for (; i < m; i++) {
+            const T* row = a + static_cast<size_t>(i) * lda;
+            Vec acc = {};
+            int j = 0;
+            for (; j + S::kLanes <= n; j += S::kLanes) {
+                acc += Load<Vec>(row + j) * Load<Vec>(x + j);
+            }
+            T sum = HorizontalSum<T>(acc, S::kLanes);
+            for (; j < n; j++) {
+                sum += row[j] * x[j];
+            }
+            y[i] = alpha * sum + (beta == 0 ? 0 : beta * y[i]);
+        }
+        return;
+    }
+
+    // y = alpha * A^T x + beta * y, accumulated as scaled rows of A
+    for (int j = 0; j < n; j++) {
+        y[j] = beta == 0 ? 0 : beta * y[j];
+    }
+    int i = 0;
+    for (; i + kRows <= m; i += kRows) {
+        const T* row0 = a + static_cast<size_t>(i) * lda;
+        const T* row1 = row0 + lda;
+        const T* row2 = row1 + lda;
+        const T* row3 = row2 + lda;
+        const T s0 = alpha * x[i];
+        const T s1 = alpha * x[i + 1];
+        const T s2 = alpha * x[i + 2];
+        const T s3 = alpha * x[i + 3];
+        const Vec v0 = Broadcast<Vec>(s0);
+        const Vec v1 = Broadcast<Vec>(s1);
+        const Vec v2 = Broadcast<Vec>(s2);
+        const Vec v3 = Broadcast<Vec>(s3);
+        int j = 0;
+        for (; j + S::kLanes <= n; j += S::kLanes) {
+            Store(y + j, Load<Vec>(y + j) + v0 * Load<Vec>(row0 + j)
+                                          + v1 * Load<Vec>(row1 + j)
+                                          + v2 * Load<Vec>(row2 + j)
+                                          + v3 * Load<Vec>(row3 + j));
+        }
+        for (; j < n; j++) {
+            y[j] += s0 * row0[j] + s1 * row1[j] + s2 * row2[j] + s3 * row3[j];
+        }
+    }
+    for (; i < m; i++) {
+        AxpyImpl<T>(n, alpha * x[i], a + static_cast<size_t>(i) * lda, y);
+    }
+}
+
+template<typename T>
+void GerImpl(const int& m, const int& n, const T& alpha, const T* x,
+             const T* y, T* a, const int& lda) {
+    for (int i = 0; i < m; i++) {
+        AxpyImpl<T>(n, alpha * x[i], y, a + static_cast<size_t>(i) * lda);
+    }
+}
+
+/// @brief Adds delta x^T to the weight gradients and delta to the bias
+///        gradients, and sets dx = input_scale * W^T delta, reading each row
+///        of W and the gradients once. dx may be null.
+template<typename T>
+void DenseBackwardImpl(const int& m, const int& n, const T* delta,
+                       const T* x, const T& input_scale, const T* w,
+                       const int& ldw, T* weight_gradients,
+                       T* bias_gradients, T* dx) {
+    using S = Simd<T>;
+    using Vec = typename S::Vec;
+    constexpr int kRows = 4;
+
+    for (int i = 0; i < m; i++) {
+        bias_gradients[i] += delta[i];
+    }
+    if (dx == nullptr) {
+        for (int i = 0; i < m; i++) {
+            AxpyImpl<T>(n, delta[i], x,
+                        weight_gradients + static_cast<size_t>(i) * ldw);
+        }
+        return;
+    }
+
+    for (int j = 0; j < n; j++) {
+        dx[j] = 0;
+    }
+    int i = 0;
+    for (; i + kRows <= m; i += kRows) {
+        const T* w_rows[kRows];
+        T* g_rows[kRows];
+        Vec d[kRows];
+        Vec ds[kRows];
+        for (int r = 0; r < kRows; r++) {
+            w_rows[r] = w + static_cast<size_t>(i + r) * ldw;
+            g_rows[r] = weight_gradients + static_cast<size_t>(i + r) * ldw;
+            d[r] = Broadcast<Vec>(delta[i + r]);
+            ds[r] = Broadcast<Vec>(input_scale * delta[i + r]);
+        }
+        int j = 0;
+        for (; j + S::kLanes <= n; j += S::kLanes) {
+            const Vec xv = Load<Vec>(x + j);
+            Vec dxv = Load<Vec>(dx + j);
+            for (int r = 0; r < kRows; r++) {
+                Store(g_rows[r] + j, Load<Vec>(g_rows[r] + j) + d[r] * xv);
+                dxv += ds[r] * Load<Vec>(w_rows[r] + j);
+            }
+            Store(dx + j, dxv);
+        }
+        for (; j < n; j++) {
+            for (int r = 0; r < kRows; r++) {
+                g_rows[r][j] += delta[i + r] * x[j];
+                dx[j] += input_scale * delta[i + r] * w_rows[r][j];
+            }
+        }
+    }
+    for (; i < m; i++) {
+        const T* w_row = w + static_cast<size_t>(i) * ldw;
+        AxpyImpl<T>(n, delta[i], x,
+                    weight_gradients + static_cast<size_t>(i) * ldw);
+        AxpyImpl<T>(n, input_scale * delta[i], w_row, dx);
+    }
+}
+
+// =======================================
+// Element-wise Kernels
+// =======================================
+
+// Every element-wise kernel may be called in place, with the output equal
+// to an input
+
+template<typename T>
+void ExpImpl(const size_t& n, const T* x, T* y, const ExpMode& mode) {
+    using S = Simd<T>;
+    using Vec = typename S::Vec;
+
+    size_t i = 0;
+    if (mode == ExpMode::kFast) {
+        for (; i + S::kLanes <= n; i += S::kLanes) {
+            Store(y + i, FastExp<T>(Load<Vec>(x + i)));
+        }
+    }
+    for (; i < n; i++) {
+        y[i] = __builtin_exp(x[i]);
+    }
+}
+
+template<typename T>
+void SigmoidImpl(const size_t& n, const T* x, T* y, const ExpMode& mode) {
+    using S = Simd<T>;
+    using Vec = typename S::Vec;
+
+    size_t i = 0;
+    if (mode == ExpMode::kFast) {
+        const Vec one = Broadcast<Vec>(T(1));
+        for (; i + S::kLanes <= n; i += S::kLanes) {
+            Store(y + i, one / (one + FastExp<T>(-Load<Vec>(x + i))));
+        }
+    }
+    for (; i < n; i++) {
+        y[i] = T(1) / (T(1) + __builtin_exp(-x[i]));
+    }
+}
+
+template<typename T>
+void TanhImpl(const size_t& n, const T* x, T* y, const ExpMode& mode) {
+    using S = Simd<T>;
+    using Vec = typename S::Vec;
+
+    size_t i = 0;
+    if (mode == ExpMode::kFast) {
+        // tanh(x) = 1 - 2 / (e^2x + 1)
+        const Vec one = Broadcast<Vec>(T(1));
+        const Vec two = Broadcast<Vec>(T(2));
+        for (; i + S::kLanes <= n; i += S::kLanes) {
+            const Vec e = FastExp<T>(two * Load<Vec>(x + i));
+            Store(y + i, one - two / (e + one));
+        }
+    }
+    for (; i < n; i++) {
+        y[i] = __builtin_tanh(x[i]);
+    }
+}
+
+template<typename T>
+void ReluImpl(const size_t& n, const T* x, T* y) {
+    using S = Simd<T>;
+    using Vec = typename S::Vec;
+
+    const Vec zero = {};
+    size_t i = 0;
+    for (; i + S::kLanes <= n; i += S::kLanes) {
+        const Vec v = Load<Vec>(x + i);
+        Store(y + i, v > zero ? v : zero);
+    }
+    for (; i < n; i++) {
+        y[i] = x[i] > 0 ? x[i] : 0;
+    }
+}
+
+template<typename T>
+void SigmoidBackwardImpl(const size_t& n, const T* y, const T* dy, T* dx) {
+    using S = Simd<T>;
+    using Vec = typename S::Vec;
+
+    const Vec one = Broadcast<Vec>(T(1));
+    size_t i = 0;
+    for (; i + S::kLanes <= n; i += S::kLanes) {
+        const Vec v = Load<Vec>(y + i);
+        Store(dx + i, Load<Vec>(dy + i) * v * (one - v));
+    }
+    for (; i < n; i++) {
+        dx[i] = dy[i] * y[i] * (T(1) - y[i]);
+    }
+}
+
+template<typename T>
+void TanhBackwardImpl(const size_t& n, const T* y, const T* dy, T* dx) {
+    using S = Simd<T>;
+    using Vec = typename S::Vec;
+
+    const Vec one = Broadcast<Vec>(T(1));
+    size_t i = 0;
+    for (; i + S::kLanes <= n; i += S::kLanes) {
+        const Vec v = Load<Vec>(y + i);
+        Store(dx + i, Load<Vec>(dy + i) * (one - v * v));
+    }
+    for (; i < n; i++) {
+        dx[i] = dy[i] * (T(1) - y[i] * y[i]);
+    }
+}
+
+template<typename T>
+void ReluBackwardImpl(const size_t& n, const T* y, const T* dy, T* dx) {
+    using S = Simd<T>;
+    using Vec = typename S::Vec;
+
+    const Vec zero = {};
+    size_t i = 0;
+    for (; i + S::kLanes <= n; i += S::kLanes) {
+        Store(dx + i, Load<Vec>(y + i) > zero ? Load<Vec>(dy + i) : zero);
+    }
+    for (; i < n; i++) {
+        dx[i] = y[i] > 0 ? dy[i] : 0;
+    }
+}
+
+template<typename T>
+void MultiplyImpl(const size_t& n, const T* x, T* y) {
+    using S = Simd<T>;
+    using Vec = typename S::Vec;
+
+    size_t i = 0;
+    for (; i + S::kLanes <= n; i += S::kLanes) {
+        Store(y + i, Load<Vec>(x + i) * Load<Vec>(y + i));
+    }
+    for (; i < n; i++) {
+        y[i] = x[i] * y[i];
+    }
+}
+
+// =======================================
+// Loss Kernels
+// =======================================
+
+// Each loss kernel returns the loss summed over its inputs and, when
+// gradients is not null, writes the gradient in the same pass
+
+template<typename T>
+T SquaredErrorImpl(const size_t& n, const T* outputs, const T* targets,
+                   T* gradients) {
+    using S = Simd<T>;
+    using Vec = typename S::Vec;
+
+    const Vec two = Broadcast<Vec>(T(2));
+    Vec sums = {};
+    size_t i = 0;
+    for (; i + S::kLanes <= n; i += S::kLanes) {
+        const Vec error = Load<Vec>(outputs + i) - Load<Vec>(targets + i);
+        sums += error * error;
+        if (gradients) {
+            Store(gradients + i, two * error);
+        }
+    }
+    T sum = HorizontalSum<T>(sums, S::kLanes);
+    for (; i < n; i++) {
+        const T error = outputs[i] - targets[i];
+        sum += error * error;
+        if (gradients) {
+            gradients[i] = 2 * error;
+        }
+    }
+    return sum;
+}
+
+template<typename T>
+T SoftmaxCrossEntropyImpl(const int& rows, const int& cols, const T* logits,
+                          const T* targets, T* gradients,
+                          const ExpMode& mode) {
+    using S = Simd<T>;
+    using Vec = typename S::Vec;
+
+    T loss = 0;
+    for (int r = 0; r < rows; r++) {
+        const size_t offset = static_cast<size_t>(r) * cols;
+        const T* x = logits + offset;
+        const T* t = targets + offset;
+        T* g = gradients ? gradients + offset : nullptr;
+
+        // Largest logit, subtracted from every logit so that no exponential
+        // overflows and the largest is exactly one
+        T max = x[0];
+        int j = 0;
+        if (cols >= S::kLanes) {
+            Vec maxes = Load<Vec>(x);
+            for (j = S::kLanes; j + S::kLanes <= cols; j += S::kLanes) {
+                const Vec v = Load<Vec>(x + j);
+                maxes = v > maxes ? v : maxes;
+            }
+            for (int lane = 0; lane < S::kLanes; lane++) {
+                max = maxes[lane] > max ? maxes[lane] : max;
+            }
+        }
+        for (; j < cols; j++) {
+            max = x[j] > max ? x[j] : max;
+        }
+
+        // Sums of e^(x - max), of the targets, and of the targets times
+        // x - max. The exponentials are kept in the gradients.
+        const Vec shift = Broadcast<Vec>(max);
+        Vec exp_sums = {};
+        Vec target_sums = {};
+        Vec weighted_sums = {};
+        j = 0;
+        for (; j + S::kLanes <= cols; j += S::kLanes) {
+            const Vec v = Load<Vec>(x + j) - shift;
+            const Vec target = Load<Vec>(t + j);
+            Vec e;
+            if (mode == ExpMode::kFast) {
+                e = FastExp<T>(v);
+            }
+            else {
+                for (int lane = 0; lane < S::kLanes; lane++) {
+                    e[lane] = __builtin_exp(v[lane]);
+                }
+            }
+            exp_sums += e;
+            target_sums += target;
+            weighted_sums += target * v;
+            if (g) {
+                Store(g + j, e);
+            }
+        }
+        T exp_sum = HorizontalSum<T>(exp_sums, S::kLanes);
+        T target_sum = HorizontalSum<T>(target_sums, S::kLanes);
+        T weighted_sum = HorizontalSum<T>(weighted_sums, S::kLanes);
+        for (; j < cols; j++) {
+            const T v = x[j] - max;
+            const T e = __builtin_exp(v);
+            exp_sum += e;
+            target_sum += t[j];
+            weighted_sum += t[j] * v;
+            if (g) {
+                g[j] = e;
+            }
+        }
+
+        // -sum(t * log(softmax(x))), where log(softmax(x)) is
+        // x - max - log(exp_sum)
+        loss += target_sum * __builtin_log(exp_sum) - weighted_sum;
+        if (!g) {
+            continue;
+        }
+
+        // softmax(x) * sum(t) - t
+        const T scale = target_sum / exp_sum;
+        const Vec scales = Broadcast<Vec>(scale);
+        j = 0;
+        for (; j + S::kLanes <= cols; j += S::kLanes) {
+            Store(g + j, Load<Vec>(g + j) * scales - Load<Vec>(t + j));
+        }
+        for (; j < cols; j++) {
+            g[j] = g[j] * scale - t[j];
+        }
+    }
+    return loss;
+}
+
+// =======================================
+// Optimizer Kernels
+// =======================================
+
+// Each update makes a single pass over the parameters, gradients and state
+
+template<typename T>
+void MomentumUpdateImpl(const size_t& n, const T& learning_rate,
+                        const T& momentum, const bool& nesterov,
+                        const T& gradient_scale, const T* gradients,
+                        T* velocity, T* params) {
+    using S = Simd<T>;
+    using Vec = typename S::Vec;
+
+    const Vec rate_v = Broadcast<Vec>(learning_rate);
+    const Vec momentum_v = Broadcast<Vec>(momentum);
+    const Vec scale_v = Broadcast<Vec>(gradient_scale);
+    size_t i = 0;
+    for (; i + S::kLanes <= n; i += S::kLanes) {
+        const Vec g = Load<Vec>(gradients + i) * scale_v;
+        const Vec v = momentum_v * Load<Vec>(velocity + i) + g;
+        const Vec step = nesterov ? g + momentum_v * v : v;
+        Store(velocity + i, v);
+        Store(params + i, Load<Vec>(params + i) - rate_v * step);
+    }
+    for (; i < n; i++) {
+        const T g = gradients[i] * gradient_scale;
+        const T v = momentum * velocity[i] + g;
+        velocity[i] = v;
+        params[i] -= learning_rate * (nesterov ? g + momentum * v : v);
+    }
+}
+
+template<typename T, typename Vec>
+inline Vec Sqrt(const Vec& x, const int& lanes) {
+    Vec result;
+    for (int i = 0; i < lanes; i++) {
+        result[i] = __builtin_sqrt(x[i]);
+    }
+    return result;
+}
+
+template<typename T>
+void AdamUpdateImpl(const size_t& n, const T& step_size, const T& beta1,
+                    const T& beta2, const T& epsilon,
+                    const T& second_moment_correction,
+                    const T& gradient_scale, const T* gradients,
+                    T* first_moment, T* second_moment, T* params) {
+    using S = Simd<T>;
+    using Vec = typename S::Vec;
+
+    const Vec step_v = Broadcast<Vec>(step_size);
+    const Vec beta1_v = Broadcast<Vec>(beta1);
+    const Vec beta2_v = Broadcast<Vec>(beta2);
+    const Vec one_minus_beta1 = Broadcast<Vec>(T(1) - beta1);
+    const Vec one_minus_beta2 = Broadcast<Vec>(T(1) - beta2);
+    const Vec epsilon_v = Broadcast<Vec>(epsilon);
+    const Vec correction_v = Broadcast<Vec>(second_moment_correction);
+    const Vec scale_v = Broadcast<Vec>(gradient_scale);
+    size_t i = 0;
+    for (; i + S::kLanes <= n; i += S::kLanes) {
+        const Vec g = Load<Vec>(gradients + i) * scale_v;
+        const Vec m = beta1_v * Load<Vec>(first_moment + i)
+                      + one_minus_beta1 * g;
+        const Vec v = beta2_v * Load<Vec>(second_moment + i)
+                      + one_minus_beta2 * g * g;
+        Store(first_moment + i, m);
+        Store(second_moment + i, v);
+        const Vec denominator = Sqrt<T>(v * correction_v, S::kLanes)
+                                + epsilon_v;
+        Store(params + i, Load<Vec>(params + i) - step_v * m / denominator);
+    }
+    for (; i < n; i++) {
+        const T g = gradients[i] * gradient_scale;
+        const T m = beta1 * first_moment[i] + (T(1) - beta1) * g;
+        const T v = beta2 * second_moment[i] + (T(1) - beta2) * g * g;
+        first_moment[i] = m;
+        second_moment[i] = v;
+        params[i] -= step_size * m
+                     / (__builtin_sqrt(v * second_moment_correction)
+                        + epsilon);
+    }
+}
+
+/// @brief p += value with a relaxed atomic load and store, so concurrent
+///        writers may lose each other's updates but never tear a value
+template<typename T>
+inline void RelaxedAdd(T* param, const T& value) {
+    T current;
+    __atomic_load(param, &current, __ATOMIC_RELAXED);
+    current += value;
+    __atomic_store(param, &current, __ATOMIC_RELAXED);
+}
+
+template<typename T>
+void HogwildUpdateImpl(const size_t& n, const T& alpha, T* gradients,
+                       T* params) {
+    using S = Simd<T>;
+    using Vec = typename S::Vec;
+
+    const Vec zero = {};
+    size_t i = 0;
+    for (; i + S::kLanes <= n; i += S::kLanes) {
+        const Vec g = Load<Vec>(gradients + i);
+        // Whole vectors of zero gradients, e.g. the weights of blank pixels,
+        // are skipped without touching the shared parameters
+        bool any = false;
+        for (int lane = 0; lane < S::kLanes; lane++) {
+            any |= g[lane] != T(0);
+        }
+        if (!any) {
+            continue;
+        }
+        for (int lane = 0; lane < S::kLanes; lane++) {
+            if (g[lane] != T(0)) {
+                RelaxedAdd(params + i + lane, alpha * g[lane]);
+            }
+        }
+        Store(gradients + i, zero);
+    }
+    for (; i < n; i++) {
+        if (gradients[i] != T(0)) {
+            RelaxedAdd(params + i, alpha * gradients[i]);
+            gradients[i] = T(0);
+        }
+    }
+}
+
+// =======================================
+// Random Number Kernels
+// =======================================
+
+// Philox runs one block per lane, each 32 bit word zero extended to a 64 bit
+// lane so that both halves of its 32 x 32 bit products are kept
+typedef unsigned long long PhiloxLanes
+            __attribute__((vector_size(KERNELS_VEC_BYTES)));
+constexpr int kPhiloxLanes = KERNELS_VEC_BYTES / 8;
+
+/// @brief The four words of kPhiloxLanes consecutive Philox blocks
+struct PhiloxBlocks {
+    PhiloxLanes words[4];
+};
+
+/// @brief Philox4x32-10 of the blocks first to first + kPhiloxLanes - 1
+inline PhiloxBlocks PhiloxRounds(const uint64_t& seed, const uint64_t& stream,
+                                 const uint64_t& first) {
+    const PhiloxLanes mask = Broadcast<PhiloxLanes>(0xffffffffull);
+    PhiloxLanes counter;
+    for (int lane = 0; lane < kPhiloxLanes; lane++) {
+        counter[lane] = first + lane;
+    }
+    PhiloxLanes c0 = counter & mask;
+    PhiloxLanes c1 = counter >> 32;
+    PhiloxLanes c2 = Broadcast<PhiloxLanes>(stream & 0xffffffffull);
+    PhiloxLanes c3 = Broadcast<PhiloxLanes>(stream >> 32);
+    unsigned int k0 = static_cast<unsigned int>(seed);
+    unsigned int k1 = static_cast<unsigned int>(seed >> 32);
+    for (int round = 0; round < 10; round++) {
+        const PhiloxLanes p0 = c0 * 0xD2511F53ull;
+        const PhiloxLanes p1 = c2 * 0xCD9E8D57ull;
+        c0 = (p1 >> 32) ^ c1 ^ k0;
+        c1 = p1 & mask;
+        c2 = (p0 >> 32) ^ c3 ^ k1;
+        c3 = p0 & mask;
+        // Weyl sequence key schedule, wrapping at 32 bits
+        k0 += 0x9E3779B9u;
+        k1 += 0xBB67AE85u;
+    }
+    return {{c0, c1, c2, c3}};
+}
+
+void PhiloxImpl(const size_t& n, const uint64_t& seed, const uint64_t& stream,
+                const uint64_t& first, uint32_t* out) {
+    for (size_t i = 0; i < n; i += kPhiloxLanes) {
+        const PhiloxBlocks blocks = PhiloxRounds(seed, stream, first + i);
+        const int count = n - i < kPhiloxLanes ? static_cast<int>(n - i)
+                                               : kPhiloxLanes;
+        for (int lane = 0; lane < count; lane++) {
+            for (int word = 0; word < 4; word++) {
+                out[4 * (i + lane) + word] = static_cast<uint32_t>(
+                            blocks.words[word][lane]);
+            }
+        }
+    }
+}
+
+/// @brief Uniform values in [0, 1), one per Philox lane, built by writing
+///        random mantissa bits under the exponent of 1 and subtracting 1
+/// @tparam T float or double
+template<typename T> struct PhiloxUniform;
+
+template<> struct PhiloxUniform<float> {
+    typedef float Vec __attribute__((vector_size(kPhiloxLanes * 4)));
+    typedef unsigned int Bits __attribute__((vector_size(kPhiloxLanes * 4)));
+
+    static Vec FromBlocks(const PhiloxBlocks& blocks) {
+        const Bits bits = __builtin_convertvector(
+                    (blocks.words[0] >> 9) | 0x3F800000ull, Bits);
+        // A vector cast keeps the bits, unlike converting each lane
+        return (Vec)bits - 1.0f;
+    }
+};
+
+template<> struct PhiloxUniform<double> {
+    typedef double Vec __attribute__((vector_size(kPhiloxLanes * 8)));
+
+    static Vec FromBlocks(const PhiloxBlocks& blocks) {
+        const PhiloxLanes bits = (blocks.words[0] << 20)
+                                 | (blocks.words[1] >> 12)
+                                 | 0x3FF0000000000000ull;
+        return (Vec)bits - 1.0;
+    }
+};
+
+template<typename T>
+void RandomUniformImpl(const size_t& n, const uint64_t& seed,
+                       const uint64_t& stream, const uint64_t& first,
+                       const T& min, const T& max, T* out) {
+    using U = PhiloxUniform<T>;
+    using Vec = typename U::Vec;
+
+    const T range = max - min;
+    size_t i = 0;
+    for (; i + kPhiloxLanes <= n; i += kPhiloxLanes) {
+        const Vec u = U::FromBlocks(PhiloxRounds(seed, stream, first + i));
+        Store(out + i, u * range + min);
+    }
+    if (i < n) {
+        const Vec u = U::FromBlocks(PhiloxRounds(seed, stream, first + i));
+        const Vec values = u * range + min;
+        for (int lane = 0; i + lane < n; lane++) {
+            out[i + lane] = values[lane];
+        }
+    }
+}
+
+// =======================================
+// Quantized Kernels
+// =======================================
+
+// int8 values are widened to int16, and adjacent pairs multiplied and summed
+// into int32 lanes by pmaddwd. Limited to 256 bits, as AVX-512F has no 16 bit
+// integer arithmetic.
+constexpr int kQuantizedBytes = KERNELS_VEC_BYTES > 32 ? 32
+                                                       : KERNELS_VEC_BYTES;
+constexpr int kQuantizedLanes = kQuantizedBytes / 2;
+#if defined(__x86_64__) || defined(__i386__)
+// Plain char, as the x86 builtins expect, which is signed on x86
+typedef char QuantizedInt8 __attribute__((vector_size(kQuantizedLanes)));
+#else
+typedef signed char QuantizedInt8
+            __attribute__((vector_size(kQuantizedLanes)));
+#endif
+typedef short QuantizedInt16 __attribute__((vector_size(kQuantizedBytes)));
+typedef int QuantizedInt32 __attribute__((vector_size(kQuantizedBytes)));
+
+inline QuantizedInt16 LoadWidened(const int8_t* ptr) {
+#if (defined(__x86_64__) || defined(__i386__)) && KERNELS_VEC_BYTES >= 32
+    // A single vpmovsxbw, rather than one per 128 bit half
+    return __builtin_ia32_pmovsxbw256(Load<QuantizedInt8>(ptr));
+#else
+    return __builtin_convertvector(Load<QuantizedInt8>(ptr), QuantizedInt16);
+#endif
+}
+
+/// @brief Products of adjacent pairs of int16 lanes, summed into int32 lanes
+inline QuantizedInt32 MultiplyAddPairs(const QuantizedInt16& a,
+                                       const QuantizedInt16& b) {
+#if (defined(__x86_64__) || defined(__i386__)) && KERNELS_VEC_BYTES >= 32
+    return __builtin_ia32_pmaddwd256(a, b);
+#elif defined(__x86_64__) || defined(__i386__)
+    return __builtin_ia32_pmaddwd128(a, b);
+#else
+    // Even and odd lanes, left to the compiler to vectorise
+    QuantizedInt32 sum;
+    for (int i = 0; i < kQuantizedBytes / 4; i++) {
+        sum[i] = int(a[2 * i]) * b[2 * i] + int(a[2 * i + 1]) * b[2 * i + 1];
+    }
+    return sum;
+#endif
+}
+
+template<typename T>
+void QuantizeInt8Impl(const size_t& n, const T* x, const T& inv_scale,
+                      int8_t* q) {
+    using S = Simd<T>;
+    using Vec = typename S::Vec;
+    typedef signed char QVec __attribute__((vector_size(S::kLanes)));
+    typedef typename ExpConstants<T>::Int IVec
+                __attribute__((vector_size(KERNELS_VEC_BYTES)));
+    // Rounds to nearest in the same way as FastExp
+    constexpr T kRound = ExpConstants<T>::kRound;
+
+    const Vec scale_v = Broadcast<Vec>(inv_scale);
+    const Vec lo = Broadcast<Vec>(T(-127));
+    const Vec hi = Broadcast<Vec>(T(127));
+    const Vec round = Broadcast<Vec>(kRound);
+    size_t i = 0;
+    for (; i + S::kLanes <= n; i += S::kLanes) {
+        Vec v = Load<Vec>(x + i) * scale_v;
+        v = v < lo ? lo : v;
+        v = v > hi ? hi : v;
+        v = (v + round) - round;
+        // Narrowed through integer lanes of the element's width, which
+        // vectorises where a direct conversion to char does not. Stored
+        // directly, as the dependent vector type does not survive template
+        // argument deduction.
+        const IVec rounded = __builtin_convertvector(v, IVec);
+        const QVec packed = __builtin_convertvector(rounded, QVec);
+        __builtin_memcpy(q + i, &packed, sizeof(packed));
+    }
+    for (; i < n; i++) {
+        T v = x[i] * inv_scale;
+        v = v < T(-127) ? T(-127) : v;
+        v = v > T(127) ? T(127) : v;
+        q[i] = static_cast<int8_t>((v + kRound) - kRound);
+    }
+}
+
+template<typename T>
+void QuantizedGemvImpl(const int& m, const int& n, const int8_t* a,
+                       const int& lda, const int8_t* x, const T* scales,
+                       const T* bias, T* y) {
+    constexpr int kRows = 4;
+    constexpr int kSumLanes = kQuantizedBytes / sizeof(int);
+
+    // Four rows at a time share each widened block of x
+    int i = 0;
+    for (; i + kRows <= m; i += kRows) {
+        const int8_t* rows[kRows];
+        QuantizedInt32 sums[kRows];
+        for (int r = 0; r < kRows; r++) {
+            rows[r] = a + static_cast<size_t>(i + r) * lda;
+            sums[r] = QuantizedInt32{};
+        }
+        int j = 0;
+        for (; j + kQuantizedLanes <= n; j += kQuantizedLanes) {
+            const QuantizedInt16 xv = LoadWidened(x + j);
+            for (int r = 0; r < kRows; r++) {
+                sums[r] += MultiplyAddPairs(LoadWidened(rows[r] + j), xv);
+            }
+        }
+        for (int r = 0; r < kRows; r++) {
+            int sum = HorizontalSum<int>(sums[r], kSumLanes);
+            for (int k = j; k < n; k++) {
+                sum += rows[r][k] * x[k];
+            }
+            y[i + r] = scales[i + r] * static_cast<T>(sum) + bias[i + r];
+        }
+    }
+    for (; i < m; i++) {
+        const int8_t* row = a + static_cast<size_t>(i) * lda;
+        QuantizedInt32 sums = {};
+        int j = 0;
+        for (; j + kQuantizedLanes <= n; j += kQuantizedLanes) {
+            sums += MultiplyAddPairs(LoadWidened(row + j), LoadWidened(x + j));
+        }
+        int sum = HorizontalSum<int>(sums, kSumLanes);
+        for (; j < n; j++) {
+            sum += row[j] * x[j];
+        }
+        y[i] = scales[i] * static_cast<T>(sum) + bias[i];
+    }
+}
+
+// =======================================
+// Sparse Kernels
+// =======================================
+
+// Index vectors of one int per lane of a float or double vector
+typedef int GatherIndexF __attribute__((vector_size(Simd<float>::kLanes * 4)));
+typedef int GatherIndexD
+            __attribute__((vector_size(Simd<double>::kLanes * 4)));
+
+/// @brief Loads base[indices[0]], ..., base[indices[kLanes - 1]], with a
+///        hardware gather where the instruction set has one
+inline Simd<float>::Vec Gather(const float* base, const int* indices) {
+    using Vec = Simd<float>::Vec;
+    const GatherIndexF index = Load<GatherIndexF>(indices);
+#if (defined(__x86_64__) || defined(__i386__)) && KERNELS_VEC_BYTES >= 64
+    return __builtin_ia32_gathersiv16sf(Vec{}, base, index, 0xFFFF, 4);
+#elif (defined(__x86_64__) || defined(__i386__)) && KERNELS_VEC_BYTES >= 32
+    // Every lane enabled by setting its sign bit
+    return __builtin_ia32_gathersiv8sf(Vec{}, base, index,
+                                       (Vec)(GatherIndexF{} - 1), 4);
+#else
+    Vec v;
+    for (int i = 0; i < Simd<float>::kLanes; i++) {
+        v[i] = base[index[i]];
+    }
+    return v;
+#endif
+}
+
+inline Simd<double>::Vec Gather(const double* base, const int* indices) {
+    using Vec = Simd<double>::Vec;
+    const GatherIndexD index = Load<GatherIndexD>(indices);
+#if (defined(__x86_64__) || defined(__i386__)) && KERNELS_VEC_BYTES >= 64
+    return __builtin_ia32_gathersiv8df(Vec{}, base, index, 0xFF, 8);
+#elif (defined(__x86_64__) || defined(__i386__)) && KERNELS_VEC_BYTES >= 32
+    typedef long long Mask __attribute__((vector_size(KERNELS_VEC_BYTES)));
+    return __builtin_ia32_gathersiv4df(Vec{}, base, index,
+                                       (Vec)(Mask{} - 1), 8);
+#else
+    Vec v;
+    for (int i = 0; i < Simd<double>::kLanes; i++) {
+        v[i] = base[index[i]];
+    }
+    return v;
+#endif
+}
+
+template<typename T>
+void SparseGemvImpl(const int& m, const int* row_offsets, const int* columns,
+                    const T* values, const T* x, T* y) {
+    using S = Simd<T>;
+    using Vec = typename S::Vec;
+
+    for (int i = 0; i < m; i++) {
+        // Two accumulators overlap the latency of consecutive gathers
+        Vec acc0 = {};
+        Vec acc1 = {};
+        const int end = row_offsets[i + 1];
+        int k = row_offsets[i];
+        for (; k + 2 * S::kLanes <= end; k += 2 * S::kLanes) {
+            acc0 += Load<Vec>(values + k) * Gather(x, columns + k);
+            acc1 += Load<Vec>(values + k + S::kLanes)
+                    * Gather(x, columns + k + S::kLanes);
+        }
+        if (k + S::kLanes <= end) {
+            acc0 += Load<Vec>(values + k) * Gather(x, columns + k);
+            k += S::kLanes;
+        }
+        T sum = HorizontalSum<T>(acc0 + acc1, S::kLanes);
+        for (; k < end; k++) {
+            sum += values[k] * x[columns[k]];
+        }
+        y[i] += sum;
+    }
+}
+
+template<typename T>
+void SparseGemmImpl(const int& m, const int& n, const int* row_offsets,
+                    const int* columns, const T* values, const T* b,
+                    const int& ldb, T* c, const int& ldc) {
+    using S = Simd<T>;
+    using Vec = typename S::Vec;
+    // Vectors of accumulators per row of C, each nonzero adding its value
+    // times kVecs vectors of a row of B
+    constexpr int kVecs = 4;
+    constexpr int kBlock = kVecs * S::kLanes;
+
+    for (int i = 0; i < m; i++) {
+        const int begin = row_offsets[i];
+        const int end = row_offsets[i + 1];
+        T* c_row = c + static_cast<size_t>(i) * ldc;
+        int j = 0;
+        for (; j + kBlock <= n; j += kBlock) {
+            Vec acc[kVecs];
+            for (int v = 0; v < kVecs; v++) {
+                acc[v] = Load<Vec>(c_row + j + v * S::kLanes);
+            }
+            for (int k = begin; k < end; k++) {
+                const Vec value = Broadcast<Vec>(values[k]);
+                const T* b_row = b + static_cast<size_t>(columns[k]) * ldb
+                                 + j;
+                for (int v = 0; v < kVecs; v++) {
+                    acc[v] += value * Load<Vec>(b_row + v * S::kLanes);
+                }
+            }
+            for (int v = 0; v < kVecs; v++) {
+                Store(c_row + j + v * S::kLanes, acc[v]);
+            }
+        }
+        for (; j + S::kLanes <= n; j += S::kLanes) {
+            Vec acc = Load<Vec>(c_row + j);
+            for (int k = begin; k < end; k++) {
+                acc += Broadcast<Vec>(values[k])
+                       * Load<Vec>(b + static_cast<size_t>(columns[k]) * ldb
+                                   + j);
+            }
+            Store(c_row + j, acc);
+        }
+        for (; j < n; j++) {
+            T sum = c_row[j];
+            for (int k = begin; k < end; k++) {
+                sum += values[k] * b[static_cast<size_t>(columns[k]) * ldb + j];
+            }
+            c_row[j] = sum;
+        }
+    }
+}
+
+template<typename T>
+void TransposeMatrixImpl(const int& m, const int& n, const T* a,
+                         const int& lda, T* b, const int& ldb) {
+    // Square tiles, so both the rows read and the rows written stay in cache
+    constexpr int kTile = 16;
+
+    for (int i0 = 0; i0 < m; i0 += kTile) {
+        const int i_end = MinInt(i0 + kTile, m);
+        for (int j0 = 0; j0 < n; j0 += kTile) {
+            const int j_end = MinInt(j0 + kTile, n);
+            for (int i = i0; i < i_end; i++) {
+                for (int j = j0; j < j_end; j++) {
+                    b[static_cast<size_t>(j) * ldb + i] =
+                                a[static_cast<size_t>(i) * lda + j];
+                }
+            }
+        }
+    }
+}
+
+// =======================================
+// GEMM
+// =======================================
+
+/// @brief Packs an mc x kc block of op(A) into slivers of Mr rows. Within a
+///        sliver, the Mr values of each column are contiguous. Rows past mc
+///        are zero padded.
+template<typename T, int Mr>
+void PackA(const Transpose& trans, const int& mc, const int& kc, const T* a,
+           const int& lda, T* packed) {
+    for (int ir = 0; ir < mc; ir += Mr) {
+        const int mr = MinInt(Mr, mc - ir);
+        for (int p = 0; p < kc; p++) {
+            if (trans == Transpose::kNo) {
+                for (int i = 0; i < mr; i++) {
+                    packed[i] = a[static_cast<size_t>(ir + i) * lda + p];
+                }
+            }
+            else {
+                const T* col = a + static_cast<size_t>(p) * lda + ir;
+                for (int i = 0; i < mr; i++) {
+                    packed[i] = col[i];
+                }
+            }
+            for (int i = mr; i < Mr; i++) {
+                packed[i] = 0;
+            }
+            packed += Mr;
+        }
+    }
+}
+
+/// @brief Packs a kc x nc block of op(B) into slivers of Nr columns. Within a
+///        sliver, the Nr values of each row are contiguous. Columns past nc
+///        are zero padded.
+template<typename T, int Nr>
+void PackB(const Transpose& trans, const int& kc, const int& nc, const T* b,
+           const int& ldb, T* packed) {
+    for (int jr = 0; jr < nc; jr += Nr) {
+        const int nr = MinInt(Nr, nc - jr);
+        for (int p = 0; p < kc; p++) {
+            if (trans == Transpose::kNo) {
+                const T* row = b + static_cast<size_t>(p) * ldb + jr;
+                for (int j = 0; j < nr; j++) {
+                    packed[j] = row[j];
+                }
+            }
+            else {
+                for (int j = 0; j < nr; j++) {
+                    packed[j] = b[static_cast<size_t>(jr + j) * ldb + p];
+                }
+            }
+            for (int j = nr; j < Nr; j++) {
+                packed[j] = 0;
+            }
+            packed += Nr;
+        }
+    }
+}
+
+/// @brief Computes one Mr x Nr tile of C from a packed sliver of A and of B,
+///        keeping the whole tile in vector registers. Edge tiles of mr x nr
+///        go through a temporary.
+template<typename T>
+void MicroKernel(const int& kc, const T* a, const T* b, T* c, const int& ldc,
+                 const T& alpha, const T& beta, const int& mr, const int& nr) {
+    using S = Simd<T>;
+    using Vec = typename S::Vec;
+
+    Vec acc[S::kMr][2] = {};
+    for (int p = 0; p < kc; p++) {
+        const Vec b0 = Load<Vec>(b);
+        const Vec b1 = Load<Vec>(b + S::kLanes);
+        for (int i = 0; i < S::kMr; i++) {
+            const Vec ai = Broadcast<Vec>(a[i]);
+            acc[i][0] += ai * b0;
+            acc[i][1] += ai * b1;
+        }
+        a += S::kMr;
+        b += S::kNr;
+    }
+
+    const Vec alpha_v = Broadcast<Vec>(alpha);
+    if (mr == S::kMr && nr == S::kNr) {
+        const Vec beta_v = Broadcast<Vec>(beta);
+        for (int i = 0; i < S::kMr; i++) {
+            T* row = c + static_cast<size_t>(i) * ldc;
+            for (int h = 0; h < 2; h++) {
+                Vec result = alpha_v * acc[i][h];
+                if (beta != 0) {
+                    result += beta_v * Load<Vec>(row + h * S::kLanes);
+                }
+                Store(row + h * S::kLanes, result);
+            }
+        }
+        return;
+    }
+
+    T tile[S::kMr * S::kNr];
+    for (int i = 0; i < S::kMr; i++) {
+        Store(tile + i * S::kNr, alpha_v * acc[i][0]);
+        Store(tile + i * S::kNr + S::kLanes, alpha_v * acc[i][1]);
+    }
+    for (int i = 0; i < mr; i++) {
+        T* row = c + static_cast<size_t>(i) * ldc;
+        for (int j = 0; j < nr; j++) {
+            row[j] = tile[i * S::kNr + j] + (beta == 0 ? 0 : beta * row[j]);
+        }
+    }
+}
+
+template<typename T>
+void GemmImpl(const Transpose& trans_a, const Transpose& trans_b,
+              const int& m, const int& n, const int& k,
+              const T& alpha, const T* a, const int& lda,
+              const T* b, const int& ldb,
+              const T& beta, T* c, const int& ldc,
+              T* pack_a, T* pack_b) {
+    using S = Simd<T>;
+    static_assert(S::kMr <= kGemmMaxMr && S::kNr <= kGemmMaxNr,
+                  "Register tile exceeds the packing buffer size");
+
+    if (m <= 0 || n <= 0) {
+        return;
+    }
+    if (k <= 0 || alpha == 0) {
+        for (int i = 0; i < m; i++) {
+            T* row = c + static_cast<size_t>(i) * ldc;
+            for (int j = 0; j < n; j++) {
+                row[j] = beta == 0 ? 0 : beta * row[j];
+            }
+        }
+        return;
+    }
+
+    for (int jc = 0; jc < n; jc += kGemmNc) {
+        const int nc = MinInt(kGemmNc, n - jc);
+        for (int pc = 0; pc < k; pc += kGemmKc) {
+            const int kc = MinInt(kGemmKc, k - pc);
+            const T* b_block = trans_b == Transpose::kNo
+                               ? b + static_cast<size_t>(pc) * ldb + jc
+                               : b + static_cast<size_t>(jc) * ldb + pc;
+            PackB<T, S::kNr>(trans_b, kc, nc, b_block, ldb, pack_b);
+
+            // Only the first block along k applies beta, later blocks
+            // accumulate onto it
+            const T block_beta = pc == 0 ? beta : T(1);
+
+            for (int ic = 0; ic < m; ic += kGemmMc) {
+                const int mc = MinInt(kGemmMc, m - ic);
+                const T* a_block = trans_a == Transpose::kNo
+                                   ? a + static_cast<size_t>(ic) * lda + pc
+                                   : a + static_cast<size_t>(pc) * lda + ic;
+                PackA<T, S::kMr>(trans_a, mc, kc, a_block, lda, pack_a);
+
+                for (int jr = 0; jr < nc; jr += S::kNr) {
+                    const int nr = MinInt(S::kNr, nc - jr);
+                    for (int ir = 0; ir < mc; ir += S::kMr) {
+                        const int mr = MinInt(S::kMr, mc - ir);
+                        MicroKernel<T>(
+                            kc, pack_a + static_cast<size_t>(ir) * kc,
+                            pack_b + static_cast<size_t>(jr) * kc,
+                            c + static_cast<size_t>(ic + ir) * ldc + jc + jr,
+                            ldc, alpha, block_beta, mr, nr);
+                    }
+                }
+            }
+        }
+    }
+}
+
+}  // namespace
+
+// =======================================
+// Entry Points
+// =======================================
+
+template<typename T>
+void Gemm(const Transpose& trans_a, const Transpose& trans_b,
+          const int& m, const int& n, const int& k,
+          const T& alpha, const T* a, const int& lda,
+          const T* b, const int& ldb,
+          const T& beta, T* c, const int& ldc,
+          T* pack_a, T* pack_b) {
+    GemmImpl<T>(trans_a, trans_b, m, n, k, alpha, a, lda, b, ldb, beta, c,
+                ldc, pack_a, pack_b);
+}
+
+template<typename T>
+void Gemv(const Transpose& trans, const int& m, const int& n,
+          const T& alpha, const T* a, const int& lda, const T* x,
+          const T& beta, T* y) {
+    GemvImpl<T>(trans, m, n, alpha, a, lda, x, beta, y);
+}
+
+template<typename T>
+void Ger(const int& m, const int& n, const T& alpha, const T* x, const T* y,
+         T* a, const int& lda) {
+    GerImpl<T>(m, n, alpha, x, y, a, lda);
+}
+
+template<typename T>
+void Axpy(const size_t& n, const T& alpha, const T* x, T* y) {
+    AxpyImpl<T>(n, alpha, x, y);
+}
+
+template<typename T>
+void DenseBackward(const int& m, const int& n, const T* delta, const T* x,
+                   const T& input_scale, const T* w, const int& ldw,
+                   T* weight_gradients, T* bias_gradients, T* dx) {
+    DenseBackwardImpl<T>(m, n, delta, x, input_scale, w, ldw,
+                         weight_gradients, bias_gradients, dx);
+}
+
+template<typename T>
+void Exp(const size_t& n, const T* x, T* y, const ExpMode& mode) {
+    ExpImpl<T>(n, x, y, mode);
+}
+
+template<typename T>
+void Sigmoid(const size_t& n, const T* x, T* y, const ExpMode& mode) {
+    SigmoidImpl<T>(n, x, y, mode);
+}
+
+template<typename T>
+void Tanh(const size_t& n, const T* x, T* y, const ExpMode& mode) {
+    TanhImpl<T>(n, x, y, mode);
+}
+
+template<typename T>
+void Relu(const size_t& n, const T* x, T* y) {
+    ReluImpl<T>(n, x, y);
+}
+
+template<typename T>
+void SigmoidBackward(const size_t& n, const T* y, const T* dy, T* dx) {
+    SigmoidBackwardImpl<T>(n, y, dy, dx);
+}
+
+template<typename T>
+void TanhBackward(const size_t& n, const T* y, const T* dy, T* dx) {
+    TanhBackwardImpl<T>(n, y, dy, dx);
+}
+
+template<typename T>
+void ReluBackward(const size_t& n, const T* y, const T* dy, T* dx) {
+    ReluBackwardImpl<T>(n, y, dy, dx);
+}
+
+template<typename T>
+void Multiply(const size_t& n, const T* x, T* y) {
+    MultiplyImpl<T>(n, x, y);
+}
+
+template<typename T>
+T SquaredError(const size_t& n, const T* outputs, const T* targets,
+               T* gradients) {
+    return SquaredErrorImpl<T>(n, outputs, targets, gradients);
+}
+
+template<typename T>
+T SoftmaxCrossEntropy(const int& rows, const int& cols, const T* logits,
+                      const T* targets, T* gradients, const ExpMode& mode) {
+    return SoftmaxCrossEntropyImpl<T>(rows, cols, logits, targets, gradients,
+                                      mode);
+}
+
+template<typename T>
+void MomentumUpdate(const size_t& n, const T& learning_rate,
+                    const T& momentum, const bool& nesterov,
+                    const T& gradient_scale, const T* gradients, T* velocity,
+                    T* params) {
+    MomentumUpdateImpl<T>(n, learning_rate, momentum, nesterov,
+                          gradient_scale, gradients, velocity, params);
+}
+
+template<typename T>
+void AdamUpdate(const size_t& n, const T& step_size, const T& beta1,
+                const T& beta2, const T& epsilon,
+                const T& second_moment_correction, const T& gradient_scale,
+                const T* gradients, T* first_moment, T* second_moment,
+                T* params) {
+    AdamUpdateImpl<T>(n, step_size, beta1, beta2, epsilon,
+                      second_moment_correction, gradient_scale, gradients,
+                      first_moment, second_moment, params);
+}
+
+template<typename T>
+void HogwildUpdate(const size_t& n, const T& alpha, T* gradients, T* params) {
+    HogwildUpdateImpl<T>(n, alpha, gradients, params);
+}
+
+void Philox(const size_t& n, const uint64_t& seed, const uint64_t& stream,
+            const uint64_t& first, uint32_t* out) {
+    PhiloxImpl(n, seed, stream, first, out);
+}
+
+template<typename T>
+void RandomUniform(const size_t& n, const uint64_t& seed,
+                   const uint64_t& stream, const uint64_t& first,
+                   const T& min, const T& max, T* out) {
+    RandomUniformImpl<T>(n, seed, stream, first, min, max, out);
+}
+
+template<typename T>
+void QuantizeInt8(const size_t& n, const T* x, const T& inv_scale, int8_t* q) {
+    QuantizeInt8Impl<T>(n, x, inv_scale, q);
+}
+
+template<typename T>
+void QuantizedGemv(const int& m, const int& n, const int8_t* a,
+                   const int& lda, const int8_t* x, const T* scales,
+                   const T* bias, T* y) {
+    QuantizedGemvImpl<T>(m, n, a, lda, x, scales, bias, y);
+}
+
+template<typename T>
+void SparseGemv(const int& m, const int* row_offsets, const int* columns,
+                const T* values, const T* x, T* y) {
+    SparseGemvImpl<T>(m, row_offsets, columns, values, x, y);
+}
+
+template<typename T>
+void SparseGemm(const int& m, const int& n, const int* row_offsets,
+                const int* columns, const T* values, const T* b,
+                const int& ldb, T* c, const int& ldc) {
+    SparseGemmImpl<T>(m, n, row_offsets, columns, values, b, ldb, c, ldc);
+}
+
+template<typename T>
+void TransposeMatrix(const int& m, const int& n, const T* a, const int& lda,
+                     T* b, const int& ldb) {
+    TransposeMatrixImpl<T>(m, n, a, lda, b, ldb);
+}
+
+template void Gemm<float>(const Transpose&, const Transpose&, const int&,
+                          const int&, const int&, const float&, const float*,
+                          const int&, const float*, const int&, const float&,
+                          float*, const int&, float*, float*);
+template void Gemm<double>(const Transpose&, const Transpose&, const int&,
+                           const int&, const int&, const double&,
+                           const double*, const int&, const double*,
+                           const int&, const double&, double*, const int&,
+                           double*, double*);
+template void Gemv<float>(const Transpose&, const int&, const int&,
+                          const float&, const float*, const int&,
+                          const float*, const float&, float*);
+template void Gemv<double>(const Transpose&, const int&, const int&,
+                           const double&, const double*, const int&,
+                           const double*, const double&, double*);
+template void Ger<float>(const int&, const int&, const float&, const float*,
+                         const float*, float*, const int&);
+template void Ger<double>(const int&, const int&, const double&,
+                          const double*, const double*, double*, const int&);
+template void Axpy<float>(const size_t&, const float&, const float*, float*);
+template void Axpy<double>(const size_t&, const double&, const double*,
+                           double*);
+template void DenseBackward<float>(const int&, const int&, const float*,
+                                  const float*, const float&, const float*,
+                                  const int&, float*, float*, float*);
+template void DenseBackward<double>(const int&, const int&, const double*,
+                                   const double*, const double&,
+                                   const double*, const int&, double*,
+                                   double*, double*);
+template void Exp<float>(const size_t&, const float*, float*,
+                         const ExpMode&);
+template void Exp<double>(const size_t&, const double*, double*,
+                          const ExpMode&);
+template void Sigmoid<float>(const size_t&, const float*, float*,
+                             const ExpMode&);
+template void Sigmoid<double>(const size_t&, const double*, double*,
+                              const ExpMode&);
+template void Tanh<float>(const size_t&, const float*, float*,
+                          const ExpMode&);
+template void Tanh<double>(const size_t&, const double*, double*,
+                           const ExpMode&);
+template void Relu<float>(const size_t&, const float*, float*);
+template void Relu<double>(const size_t&, const double*, double*);
+template void SigmoidBackward<float>(const size_t&, const float*,
+                                     const float*, float*);
+template void SigmoidBackward<double>(const size_t&, const double*,
+                                      const double*, double*);
+template void TanhBackward<float>(const size_t&, const float*, const float*,
+                                  float*);
+template void TanhBackward<double>(const size_t&, const double*,
+                                   const double*, double*);
+template void ReluBackward<float>(const size_t&, const float*, const float*,
+                                  float*);
+template void ReluBackward<double>(const size_t&, const double*,
+                                   const double*, double*);
+template void Multiply<float>(const size_t&, const float*, float*);
+template void Multiply<double>(const size_t&, const double*, double*);
+template float SquaredError<float>(const size_t&, const float*, const float*,
+                                   float*);
+template double SquaredError<double>(const size_t&, const double*,
+                                     const double*, double*);
+template float SoftmaxCrossEntropy<float>(const int&, const int&,
+                                          const float*, const float*, float*,
+                                          const ExpMode&);
+template double SoftmaxCrossEntropy<double>(const int&, const int&,
+                                            const double*, const double*,
+                                            double*, const ExpMode&);
+template void MomentumUpdate<float>(const size_t&, const float&, const float&,
+                                    const bool&, const float&, const float*,
+                                    float*, float*);
+template void MomentumUpdate<double>(const size_t&, const double&,
+                                     const double&, const bool&,
+                                     const double&, const double*, double*,
+                                     double*);
+template void AdamUpdate<float>(const size_t&, const float&, const float&,
+                                const float&, const float&, const float&,
+                                const float&, const float*, float*, float*,
+                                float*);
+template void AdamUpdate<double>(const size_t&, const double&, const double&,
+                                 const double&, const double&, const double&,
+                                 const double&, const double*, double*,
+                                 double*, double*);
+template void HogwildUpdate<float>(const size_t&, const float&, float*,
+                                   float*);
+template void HogwildUpdate<double>(const size_t&, const double&, double*,
+                                    double*);
+template void RandomUniform<float>(const size_t&, const uint64_t&,
+                                   const uint64_t&, const uint64_t&,
+                                   const float&, const float&, float*);
+template void RandomUniform<double>(const size_t&, const uint64_t&,
+                                    const uint64_t&, const uint64_t&,
+                                    const double&, const double&, double*);
+template void QuantizeInt8<float>(const size_t&, const float*, const float&,
+                                  int8_t*);
+template void QuantizeInt8<double>(const size_t&, const double*,
+                                   const double&, int8_t*);
+template void QuantizedGemv<float>(const int&, const int&, const int8_t*,
+                                   const int&, const int8_t*, const float*,
+                                   const float*, float*);
+template void QuantizedGemv<double>(const int&, const int&, const int8_t*,
+                                    const int&, const int8_t*, const double*,
+                                    const double*, double*);
+template void SparseGemv<float>(const int&, const int*, const int*,
+                                const float*, const float*, float*);
+template void SparseGemv<double>(const int&, const int*, const int*,
+                                 const double*, const double*, double*);
+template void SparseGemm<float>(const int&, const int&, const int*,
+                                const int*, const float*, const float*,
+                                const int&, float*, const int&);
+template void SparseGemm<double>(const int&, const int&, const int*,
+                                 const int*, const double*, const double*,
+                                 const int&, double*, const int&);
+template void TransposeMatrix<float>(const int&, const int&, const float*,
+                                     const int&, float*, const int&);
+template void TransposeMatrix<double>(const int&, const int&, const double*,
+                                      const int&, double*, const int&);
+
+}  // namespace KERNELS_ISA
+}  // namespace kernels
@@ -0,0 +1,122 @@
+#pragma once
+
+/*
+    Internal interface between the kernel dispatcher (kernels.cpp) and the
+    per instruction set implementations (kernels_<isa>.cpp). Each
+    implementation is compiled in its own translation unit with the matching
+    compiler flags, and is only called once the dispatcher has confirmed the
+    CPU supports it.
+*/
+
+#include <cstddef>
+
+#include "kernels.h"
+
+namespace kernels {
+
+// Cache blocking of the GEMM driver. A packed KC x NC panel of B is reused
+// for every MC x KC block of A, and each packed block of A is reused for
+// every register tile in the panel.
+constexpr int kGemmMc = 96;
+constexpr int kGemmKc = 256;
+constexpr int kGemmNc = 1024;
+
+// Upper bounds of the register tile over every implementation, used to size
+// the packing buffers
+constexpr int kGemmMaxMr = 8;
+constexpr int kGemmMaxNr = 32;
+
+// Elements in the packing buffers for A and B
+constexpr size_t kGemmPackASize = static_cast<size_t>(kGemmMc + kGemmMaxMr)
+                                  * kGemmKc;
+constexpr size_t kGemmPackBSize = static_cast<size_t>(kGemmNc + kGemmMaxNr)
+                                  * kGemmKc;
+
+#define KERNELS_DECLARE_ISA(isa)                                              \
+namespace isa {                                                               \
+template<typename T>                                                          \
+void Gemm(const Transpose& trans_a, const Transpose& trans_b,                 \
+          const int& m, const int& n, const int& k,                           \
+          const T& alpha, const T* a, const int& lda,                         \
+          const T* b, const int& ldb,                                         \
+          const T& beta, T* c, const int& ldc,                                \
+          T* pack_a, T* pack_b);                                              \
+template<typename T>                                                          \
+void Gemv(const Transpose& trans, const int& m, const int& n,                 \
+          const T& alpha, const T* a, const int& lda, const T* x,             \
+          const T& beta, T* y);                                               \
+template<typename T>                                                          \
+void Ger(const int& m, const int& n, const T& alpha, const T* x, const T* y,  \
+         T* a, const int& lda);                                               \
+template<typename T>                                                          \
+void Axpy(const size_t& n, const T& alpha, const T* x, T* y);                 \
+template<typename T>                                                          \
+void DenseBackward(const int& m, const int& n, const T* delta, const T* x,    \
+                   const T& input_scale, const T* w, const int& ldw,          \
+                   T* weight_gradients, T* bias_gradients, T* dx);            \
+template<typename T>                                                          \
+void Exp(const size_t& n, const T* x, T* y, const ExpMode& mode);             \
+template<typename T>                                                          \
+void Sigmoid(const size_t& n, const T* x, T* y, const ExpMode& mode);         \
+template<typename T>                                                          \
+void Tanh(const size_t& n, const T* x, T* y, const ExpMode& mode);            \
+template<typename T>                                                          \
+void Relu(const size_t& n, const T* x, T* y);                                 \
+template<typename T>                                                          \
+void SigmoidBackward(const size_t& n, const T* y, const T* dy, T* dx);        \
+template<typename T>                                                          \
+void TanhBackward(const size_t& n, const T* y, const T* dy, T* dx);           \
+template<typename T>                                                          \
+void ReluBackward(const size_t& n, const T* y, const T* dy, T* dx);           \
+template<typename T>                                                          \
+void Multiply(const size_t& n, const T* x, T* y);                             \
+template<typename T>                                                          \
+T SquaredError(const size_t& n, const T* outputs, const T* targets,           \
+               T* gradients);                                                 \
+template<typename T>                                                          \
+T SoftmaxCrossEntropy(const int& rows, const int& cols, const T* logits,      \
+                      const T* targets, T* gradients, const ExpMode& mode);   \
+template<typename T>                                                          \
+void MomentumUpdate(const size_t& n, const T& learning_rate,                  \
+                    const T& momentum, const bool& nesterov,                  \
+                    const T& gradient_scale, const T* gradients, T* velocity, \
+                    T* params);                                               \
+template<typename T>                                                          \
+void AdamUpdate(const size_t& n, const T& step_size, const T& beta1,          \
+                const T& beta2, const T& epsilon,                             \
+                const T& second_moment_correction, const T& gradient_scale,   \
+                const T* gradients, T* first_moment, T* second_moment,        \
+                T* params);                                                   \
+template<typename T>                                                          \
+void HogwildUpdate(const size_t& n, const T& alpha, T* gradients, T* params); \
+void Philox(const size_t& n, const uint64_t& seed, const uint64_t& stream,    \
+            const uint64_t& first, uint32_t* out);                            \
+template<typename T>                                                          \
+void RandomUniform(const size_t& n, const uint64_t& seed,                     \
+                   const uint64_t& stream, const uint64_t& first,             \
+                   const T& min, const T& max, T* out);                       \
+template<typename T>                                                          \
+void QuantizeInt8(const size_t& n, const T* x, const T& inv_scale, int8_t* q);\
+template<typename T>                                                          \
+void QuantizedGemv(const int& m, const int& n, const int8_t* a,               \
+                   const int& lda, const int8_t* x, const T* scales,          \
+                   const T* bias, T* y);                                      \
+template<typename T>                                                          \
+void SparseGemv(const int& m, const int* row_offsets, const int* columns,     \
+                const T* values, const T* x, T* y);                           \
+template<typename T>                                                          \
+void SparseGemm(const int& m, const int& n, const int* row_offsets,           \
+                const int* columns, const T* values, const T* b,              \
+                const int& ldb, T* c, const int& ldc);                        \
+template<typename T>                                                          \
+void TransposeMatrix(const int& m, const int& n, const T* a, const int& lda,  \
+                     T* b, const int& ldb);                                   \
+}
+
+KERNELS_DECLARE_ISA(sse2)
+KERNELS_DECLARE_ISA(avx2)
+KERNELS_DECLARE_ISA(avx512)
+
+#undef KERNELS_DECLARE_ISA
+
+}  // namespace kernels
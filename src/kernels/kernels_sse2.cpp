@@ -0,0 +1,5 @@
+// Kernels compiled with SSE2 enabled, see the makefile
+#define KERNELS_ISA sse2
+#define KERNELS_VEC_BYTES 16
+
+#include "kernels_impl.h"
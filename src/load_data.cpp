@@ -1,147 +1,117 @@
-#include <vector>
+#include <algorithm>
 #include <iostream>
-#include <fstream>
+#include <limits>
+#include <stdexcept>
 
-void ReverseBytes(char *bytes, const int& size) {
-    for (int i = 0; i < size / 2; i++)
-    {
-        char temp = bytes[i];
-        bytes[i] = bytes[size - i - 1];
-        bytes[size - i - 1] = temp;
-    }
-}
+#include "load_data.h"
+#include "metrics.h"
 
-bool ReadBigEndian(std::ifstream& file, char *bytes, const uint& size) {
-    file.read(bytes, size);
-    ReverseBytes(bytes, size);
+namespace {
 
-    return true;
+// IDX files store their header as big endian 32 bit integers
+uint32_t ReadBigEndian(const uint8_t* bytes) {
+    return (static_cast<uint32_t>(bytes[0]) << 24)
+           | (static_cast<uint32_t>(bytes[1]) << 16)
+           | (static_cast<uint32_t>(bytes[2]) << 8)
+           | static_cast<uint32_t>(bytes[3]);
 }
 
-bool LoadLabelDatabaseFile(const std::string& filename,
-                          std::vector<int>& output) {
-    std::ifstream labels_file;
-    labels_file.open(filename, std::ios::binary | std::ios::in);
-    if (!labels_file.is_open())
-    {
-        return false;
+}  // namespace
+
+MnistDataset::MnistDataset(const std::string& images_path,
+                           const std::string& labels_path) :
+                           images_file(new MappedFile(images_path)),
+                           labels_file(new MappedFile(labels_path)) {
+    METRICS_SCOPE(metrics::Counter::kDataLoad);
+    // Image header: magic number, number of items, rows, columns
+    const uint8_t* header = images_file->Data();
+    if (images_file->Size() < 16 || ReadBigEndian(header) != 2051) {
+        throw std::runtime_error("\"" + images_path + "\" is not an mnist "
+                                 "image database");
     }
-
-    labels_file.seekg(0, std::ios::beg);
-
-    // First 32 bits are magic number
-    int magic_number;
-    ReadBigEndian(labels_file, reinterpret_cast<char*>(&magic_number),
-                    sizeof(magic_number));
-
-    if (magic_number != 2049) {
-        printf("ERROR: \"%s\" is not an mnist label database. "
-               "Magic number is: %d\n", filename.c_str(), magic_number);
-        return false;
+    const uint64_t num_images = ReadBigEndian(header + 4);
+    const uint64_t rows = ReadBigEndian(header + 8);
+    const uint64_t columns = ReadBigEndian(header + 12);
+    // The counts come from the file, so each product is checked by division
+    // before it is formed, and must fit the int sizes of the dataset
+    const uint64_t max_int = std::numeric_limits<int>::max();
+    if (num_images > max_int || rows > max_int || columns > max_int
+        || (rows != 0 && columns > max_int / rows)) {
+        throw std::runtime_error("\"" + images_path + "\" has too many "
+                    "images, " + std::to_string(num_images) + " images of "
+                    + std::to_string(rows) + "x" + std::to_string(columns));
     }
-
-    // Next 32 bits are number of items
-    int number_of_items;
-    ReadBigEndian(labels_file, reinterpret_cast<char*>(&number_of_items),
-                    sizeof(number_of_items));
-
-    // Read labels
-    for (int i = 0; i < number_of_items; i++)
-    {
-        // Each label is 1 byte, so we use a char
-        char label;
-        ReadBigEndian(labels_file, &label, sizeof(label));
-        output.push_back((int)label);
+    const uint64_t image_size = rows * columns;
+    if (image_size != 0
+        && num_images > (images_file->Size() - 16) / image_size) {
+        throw std::runtime_error("\"" + images_path + "\" is truncated, "
+                    "expected " + std::to_string(num_images) + " images of "
+                    + std::to_string(rows) + "x" + std::to_string(columns));
     }
 
-    labels_file.close();
-
-    return true;
-}
-
-bool LoadImageDatabaseFile(const std::string& filename,
-                          std::vector<std::vector<double>>& output) {
-    std::ifstream images_file;
-    images_file.open(filename, std::ios::binary | std::ios::in);
-    if (!images_file.is_open())
-    {
-        return false;
+    // Label header: magic number, number of items
+    header = labels_file->Data();
+    if (labels_file->Size() < 8 || ReadBigEndian(header) != 2049) {
+        throw std::runtime_error("\"" + labels_path + "\" is not an mnist "
+                                 "label database");
     }
-
-    // Seek to beginning of file
-    images_file.seekg(0, std::ios::beg);
-
-    // First 32 bits are magic number
-    int magic_number;
-    ReadBigEndian(images_file, reinterpret_cast<char*>(&magic_number),
-                    sizeof(magic_number));
-
-    if (magic_number != 2051) {
-        printf("ERROR: \"%s\" is not an mnist label database. "
-               "Magic number is: %d\n", filename.c_str(), magic_number);
-        return false;
+    const uint64_t num_labels = ReadBigEndian(header + 4);
+    if (labels_file->Size() - 8 < num_labels) {
+        throw std::runtime_error("\"" + labels_path + "\" is truncated, "
+                    "expected " + std::to_string(num_labels) + " labels");
+    }
+    if (num_labels != num_images) {
+        throw std::runtime_error("\"" + images_path + "\" has "
+                    + std::to_string(num_images) + " images but \""
+                    + labels_path + "\" has " + std::to_string(num_labels)
+                    + " labels");
     }
 
-    // Next 32 bits are number of items
-    int number_of_items;
-    ReadBigEndian(images_file, reinterpret_cast<char*>(&number_of_items),
-                    sizeof(number_of_items));
-
-    // Read number of rows
-    int number_of_rows;
-    ReadBigEndian(images_file, reinterpret_cast<char*>(&number_of_rows),
-                    sizeof(number_of_rows));
-
-    // Read number of columns
-    int number_of_columns;
-    ReadBigEndian(images_file, reinterpret_cast<char*>(&number_of_columns),
-                    sizeof(number_of_columns));
-
-    // Read images_train
-    for (int i = 0; i < number_of_items; i++)
-    {
-        // Each image is 28 * 28 = 784 bytes
-        char image[784];
-        // No need to read big-endian - the image is stored as single characters
-        // read left-to-right, top-to-bottom
-        images_file.read(image, sizeof(image));
-
-        // Convert to std::vector of doubles
-        std::vector<double> image_vector;
-        for (int j = 0; j < 784; j++)
-        {
-            unsigned int temp = (unsigned int)((unsigned char)image[j]);
-            // We normalize the values to be between 0 and 1
-            // By dividing by 255, the maximum value of a byte
-            image_vector.push_back((double)(temp) / 255.0);
+    images = images_file->Data() + 16;
+    labels = labels_file->Data() + 8;
+    size_ = static_cast<int>(num_images);
+    rows_ = static_cast<int>(rows);
+    columns_ = static_cast<int>(columns);
+
+    // Checked once here so batch assembly can index targets by label
+    for (int i = 0; i < size_; i++) {
+        if (labels[i] >= kNumClasses) {
+            throw std::runtime_error("\"" + labels_path + "\" has label "
+                        + std::to_string(labels[i]) + " at index "
+                        + std::to_string(i));
         }
+    }
+}
 
-        output.push_back(image_vector);
-    };
-
-    images_file.close();
-
-    return true;
+template<typename T>
+void MnistDataset::NormaliseImage(const int& index, T* output) const {
+    const uint8_t* pixels = Image(index);
+    const int image_size = ImageSize();
+    for (int i = 0; i < image_size; i++) {
+        // We normalize the values to be between 0 and 1
+        // By dividing by 255, the maximum value of a byte
+        output[i] = static_cast<T>(pixels[i]) / T(255);
+    }
 }
 
-bool LoadData(std::vector<std::vector<double>>& images_train,
-               std::vector<int>& labels_train,
-               std::vector<std::vector<double>>& images_test,
-               std::vector<int>& labels_test) {
-    bool success = true;
-    success &= LoadLabelDatabaseFile("data/train-labels-idx1-ubyte",
-                                    labels_train);
-    success &= LoadImageDatabaseFile("data/train-images-idx3-ubyte",
-                                    images_train);
-    success &= LoadLabelDatabaseFile("data/t10k-labels-idx1-ubyte",
-                                    labels_test);
-    success &= LoadImageDatabaseFile("data/t10k-images-idx3-ubyte",
-                                    images_test);
-
-    return success;
+template<typename T>
+void MnistDataset::FillBatch(const int* indices, const int& count, T* inputs,
+                             T* targets) const {
+    METRICS_SCOPE(metrics::Counter::kBatchAssembly);
+    const size_t image_size = static_cast<size_t>(ImageSize());
+    for (int j = 0; j < count; j++) {
+        NormaliseImage(indices[j], inputs + j * image_size);
+
+        // Training is labelled with a single number rather than a vector, so
+        // create the target vector here
+        T* target = targets + static_cast<size_t>(j) * kNumClasses;
+        std::fill(target, target + kNumClasses, T(0));
+        target[Label(indices[j])] = T(1);
+    }
 }
 
-void PrintAsciiImage(const std::vector<double> &values) {
+template<typename T>
+void PrintAsciiImage(const std::vector<T> &values) {
     // Check if the size of the input std::vector is correct
     std::cout << "values.size(): " << values.size() << std::endl;
 
@@ -180,3 +150,12 @@ void PrintAsciiImage(const std::vector<double> &values) {
         }
     }
 }
+
+template void MnistDataset::NormaliseImage<float>(const int&, float*) const;
+template void MnistDataset::NormaliseImage<double>(const int&, double*) const;
+template void MnistDataset::FillBatch<float>(const int*, const int&, float*,
+                                             float*) const;
+template void MnistDataset::FillBatch<double>(const int*, const int&, double*,
+                                              double*) const;
+template void PrintAsciiImage<float>(const std::vector<float>&);
+template void PrintAsciiImage<double>(const std::vector<double>&);
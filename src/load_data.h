@@ -2,60 +2,96 @@
     Heavily based on the work https://github.com/Krish120003/CPP_Neural_Network
 */
 
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
 #include <vector>
-#include <iostream>
-#include <fstream>
-
-/// @brief Reverses byte order as a conversion between big endian and little
-///        endian.
-/// @param bytes pointer to the data
-/// @param size number of bytes in the data
-void ReverseBytes(char *bytes, const int& size);
-
-/// @brief Read a file stream encoded in big endian for a little endian system
-/// @param file file stream to read
-/// @param bytes pointer to buffer to store data
-/// @param size number of bytes read
-/// @return success
-bool ReadBigEndian(std::ifstream& file, char *bytes, const uint& size);
-
-/// @brief Loads an MNIST label database - either training or test data. Returns
-///        a vector of ints, where each element is a number from 0 - 9.
-/// @param filename full filepath to the MNIST label file
-/// @param output vector of data labels
-/// @return success
-bool LoadLabelDatabaseFile(const std::string& filename,
-                          std::vector<int>& output);
-
-/// @brief Loads an MNIST image database - either training or test data. Returns
-///        data as a "2D" vector array. The outer vector is the index of 
-///        image. The inner vector is a 784 bytes long vector, where each 
-///        element is a double from 0.0-1.0 representing the intensity of that
-///        pixel. That is, each image is deconstucted into a 1D vector.
-/// @param filename full filepath to the MNIST image file
-/// @param output nested vector of image data
-/// @return success
-bool LoadImageDatabaseFile(const std::string& filename,
-                          std::vector<std::vector<double>>& output);
-
-/// @brief Loads a set of MNIST image and label databases for both training and
-///        test data. Labels are a vector of ints, where each element is a
-///        number from 0 - 9. Image data is a "2D" vector array. The outer
-///        vector is the index of image. The inner vector is a 784 bytes long
-///        vector, where each element is a double from 0.0-1.0 representing the
-///        intensity of that pixel. That is, each image is deconstucted into a
-///        1D vector.
-/// @param images_train output vector to write training images
-/// @param labels_train output vector to write training labels
-/// @param images_test output vector to write test images
-/// @param labels_test output vector to write test labels
-/// @return success
-bool LoadData(std::vector<std::vector<double>>& images_train,
-               std::vector<int>& labels_train,
-               std::vector<std::vector<double>>& images_test,
-               std::vector<int>& labels_test);
+
+#include "mapped_file.h"
+
+/// @brief An MNIST image database and its label database - either training or
+///        test data. Both IDX files are memory mapped and their headers are
+///        checked once on construction. Images are exposed in place as rows of
+///        uint8_t pixels, one byte per pixel, read left-to-right,
+///        top-to-bottom. Conversion to floating point happens only when
+///        assembling a batch.
+///        Example usage:
+///
+///    MnistDataset train("data/train-images-idx3-ubyte",
+///                       "data/train-labels-idx1-ubyte");
+///    train.FillBatch(indices, count, inputs, targets);
+class MnistDataset {
+private:
+    std::unique_ptr<MappedFile> images_file;
+    std::unique_ptr<MappedFile> labels_file;
+
+    // First pixel of the first image and first label, inside the mappings
+    const uint8_t* images = nullptr;
+    const uint8_t* labels = nullptr;
+
+    int size_ = 0;
+    int rows_ = 0;
+    int columns_ = 0;
+
+public:
+    /// @brief Number of classes, the digits 0 - 9
+    static constexpr int kNumClasses = 10;
+
+    /// @brief Constructor. Throws runtime_error if either file cannot be
+    ///        mapped, is not an MNIST database of the expected type, is
+    ///        truncated, or the two files hold different numbers of items.
+    /// @param images_path full filepath to the MNIST image file
+    /// @param labels_path full filepath to the matching MNIST label file
+    MnistDataset(const std::string& images_path,
+                 const std::string& labels_path);
+
+    /// @brief Number of images
+    int Size() const { return size_; }
+
+    /// @brief Height of each image in pixels
+    int Rows() const { return rows_; }
+
+    /// @brief Width of each image in pixels
+    int Columns() const { return columns_; }
+
+    /// @brief Number of pixels in each image
+    int ImageSize() const { return rows_ * columns_; }
+
+    /// @brief Pixels of one image, 0 - 255, without copying
+    /// @param index index of the image
+    /// @return ImageSize() pixels, valid while the dataset is alive
+    const uint8_t* Image(const int& index) const {
+        return images + static_cast<size_t>(index) * ImageSize();
+    }
+
+    /// @brief Label of one image, a number from 0 - 9
+    /// @param index index of the image
+    int Label(const int& index) const { return labels[index]; }
+
+    /// @brief Converts one image to values from 0.0-1.0 representing the
+    ///        intensity of each pixel
+    /// @tparam T float or double
+    /// @param index index of the image
+    /// @param output receives ImageSize() values
+    template<typename T>
+    void NormaliseImage(const int& index, T* output) const;
+
+    /// @brief Assembles a batch of normalised images and one-hot targets
+    /// @tparam T float or double
+    /// @param indices count indices of the images in the batch
+    /// @param count number of samples in the batch
+    /// @param inputs receives the count x ImageSize() block of images
+    /// @param targets receives the count x kNumClasses block of targets, 1.0
+    ///                for the labelled digit and 0.0 otherwise
+    template<typename T>
+    void FillBatch(const int* indices, const int& count, T* inputs,
+                   T* targets) const;
+};
 
 /// @brief Prints to the terminal an ASCII interpretation of a 1D MNIST image
 ///        file. The file is assumed to be a 28x28 px image.
 /// @param values the image to print as a 1D array
-void PrintAsciiImage(const std::vector<double> &values);
\ No newline at end of file
+template<typename T>
+void PrintAsciiImage(const std::vector<T> &values);
@@ -0,0 +1,47 @@
+#include <stdexcept>
+#include <string>
+
+#include "loss.h"
+#include "kernels/kernels.h"
+
+LossType ParseLossType(const std::string& name) {
+    if (name == "mean_squared_error") {
+        return LossType::kMeanSquaredError;
+    }
+    if (name == "softmax_cross_entropy") {
+        return LossType::kSoftmaxCrossEntropy;
+    }
+    throw std::runtime_error("Unknown loss \"" + name + "\", expected "
+                             "mean_squared_error or softmax_cross_entropy");
+}
+
+const char* LossName(const LossType& type) {
+    switch (type) {
+        case LossType::kMeanSquaredError: return "mean_squared_error";
+        case LossType::kSoftmaxCrossEntropy: return "softmax_cross_entropy";
+    }
+    return "unknown";
+}
+
+template<typename T>
+double BatchLoss(const LossType& type, const int& batch_size,
+                 const int& num_outputs, const T* outputs, const T* targets,
+                 T* gradients) {
+    const size_t count = static_cast<size_t>(batch_size) * num_outputs;
+    switch (type) {
+        case LossType::kMeanSquaredError:
+            return kernels::SquaredError(count, outputs, targets, gradients)
+                   / static_cast<double>(count);
+        case LossType::kSoftmaxCrossEntropy:
+            return kernels::SoftmaxCrossEntropy(batch_size, num_outputs,
+                                                outputs, targets, gradients)
+                   / static_cast<double>(batch_size);
+    }
+    throw std::runtime_error("Unknown loss type "
+                + std::to_string(static_cast<int>(type)) + " in BatchLoss");
+}
+
+template double BatchLoss<float>(const LossType&, const int&, const int&,
+                                 const float*, const float*, float*);
+template double BatchLoss<double>(const LossType&, const int&, const int&,
+                                  const double*, const double*, double*);
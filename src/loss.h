@@ -0,0 +1,43 @@
+#pragma once
+
+#include <string>
+
+/// @brief Cost minimised by training
+enum class LossType {
+    // Squared error of each output. Suits regression, and any output layer
+    // activation.
+    kMeanSquaredError,
+    // Cross entropy of the softmax of the outputs against target
+    // probabilities, e.g. one-hot class labels. The softmax is fused into
+    // the loss, so the output layer must use the identity activation and
+    // the network outputs are the logits.
+    kSoftmaxCrossEntropy,
+};
+
+/// @brief Looks up a loss by its config name: mean_squared_error or
+///        softmax_cross_entropy. Throws runtime_error for unknown names.
+/// @param name name of the loss
+/// @return the loss type
+LossType ParseLossType(const std::string& name);
+
+/// @brief Config name of a loss, e.g. "softmax_cross_entropy"
+const char* LossName(const LossType& type);
+
+/// @brief Mean loss of a batch of outputs and, in the same pass, its
+///        gradient relative to each output. The mean is taken over every
+///        output for kMeanSquaredError and over every sample for
+///        kSoftmaxCrossEntropy. The gradients are those of each sample's
+///        loss, not of the mean.
+/// @tparam T float or double
+/// @param type loss to evaluate
+/// @param batch_size number of samples
+/// @param num_outputs outputs per sample
+/// @param outputs batch_size x num_outputs block of network outputs
+/// @param targets batch_size x num_outputs block of desired results
+/// @param gradients receives the batch_size x num_outputs gradients, or null
+///                  to skip them
+/// @return mean loss
+template<typename T>
+double BatchLoss(const LossType& type, const int& batch_size,
+                 const int& num_outputs, const T* outputs, const T* targets,
+                 T* gradients);
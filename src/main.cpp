@@ -1,19 +1,74 @@
+#include <algorithm>
 #include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
 
 #include "load_data.h"
 #include "neural_network.h"
 #include "tank_counting.h"
+#include "quantized.h"
+#include "evaluation.h"
+#include "trainer.h"
 #include "neural_network_demo.h"
 #include "config.h"
+#include "data_parallel.h"
+#include "inference.h"
+#include "kernels/kernels.h"
+#include "metrics.h"
 
-int TankTraining(const int& epochs, const int& batch_size, const int& tank_min,
+template<typename T>
+void EvaluateTankNetwork(const CompiledNetwork<T>& network,
+                         TankExerciseGenerator& generator,
+                         const int& tank_max, const int& tank_peeks) {
+    InferenceSession<T> session(network);
+    std::vector<T> input(tank_peeks);
+    T target = 0;
+    T output = 0;
+
+    const int kTotalRuns = 10000;
+    double mean_error = 0.0;
+    for (int i = 0; i < kTotalRuns; i++) {
+        // Population peeks and count as a percentage of the max pop
+        generator.FillBatch(1, input.data(), &target);
+        
+        // Forward propagation
+        session.Predict(input.data(), &output);
+
+        // Keep track of the number of succsseful predictions
+        const double true_population = static_cast<double>(target) * tank_max;
+        double prediction = output * tank_max;
+        const double error = abs(prediction - true_population) /
+                             true_population;
+
+        mean_error += error / kTotalRuns;
+    }
+    printf("Mean error over %d runs: %.2f%%\n",
+            kTotalRuns, mean_error * 100);
+}
+
+template<typename T>
+int TankTraining(const int& epochs, const int& batch_size,
+                 const int& mini_batch_size, const int& threads,
+                 const int& tank_min,
                  const int& tank_max, const int& tank_peeks,
-                 const int& test_count, const std::vector<int>& hidden_layers) {
+                 const int& test_count, const std::vector<int>& hidden_layers,
+                 const OptimizerConfig& optimizer,
+                 const std::string& save_model, const std::string& load_model,
+                 const uint64_t& seed) {
+    // Independent random number streams for the baseline, training and
+    // evaluation exercises
+    TankExerciseGenerator baseline_generator(tank_min, tank_max, tank_peeks,
+                                             seed, 0);
+    TankExerciseGenerator training_generator(tank_min, tank_max, tank_peeks,
+                                             seed, 1);
+    TankExerciseGenerator evaluation_generator(tank_min, tank_max, tank_peeks,
+                                               seed, 2);
+
     // Frequentist sample output:
     double mean_error = 0.0;
     for (int i = 0; i < test_count; i++) {
-        TankPopulationExercise ex =
-                CreateTankPopulationExercise(tank_min, tank_max, tank_peeks);
+        TankPopulationExercise ex = baseline_generator.CreateExercise();
         const int pop = ex.true_population;
         const int pred = FrequentistPrediction(ex.population_peeks);
         mean_error += abs(pred - pop) / static_cast<double>(pop) / test_count;
@@ -21,109 +76,259 @@ int TankTraining(const int& epochs, const int& batch_size, const int& tank_min,
     printf("Mean error over %d runs: %.2f%%\n",
             test_count, mean_error * 100);
 
+    // NN solution from a saved model, skipping training:
+    if (!load_model.empty()) {
+        const CompiledNetwork<T> compiled = CompiledNetwork<T>::Load(
+                                                                load_model);
+        if (compiled.NumInputs() != tank_peeks || compiled.NumOutputs() != 1) {
+            throw std::runtime_error("Model \"" + load_model + "\" has "
+                        + std::to_string(compiled.NumInputs()) + " inputs and "
+                        + std::to_string(compiled.NumOutputs()) + " outputs, "
+                        "expected " + std::to_string(tank_peeks) + " and 1");
+        }
+        printf("Loaded model \"%s\"\n", load_model.c_str());
+        EvaluateTankNetwork(compiled, evaluation_generator, tank_max,
+                            tank_peeks);
+        return 0;
+    }
+
     // NN solution:
-    NeuralNetwork network = NeuralNetwork(tank_peeks, 1, hidden_layers);
+    NeuralNetwork<T> network(tank_peeks, 1, hidden_layers, Sigmoid<T>,
+                             Sigmoid<T>, seed);
+    network.SetOptimizer(optimizer);
 
-    printf("Beginning training...\n");
+    DataParallelTrainer<T> trainer(network, threads, mini_batch_size);
 
+    printf("Beginning training on %d threads...\n", trainer.NumThreads());
+
+    // Contiguous blocks of samples and targets for each mini-batch
+    std::vector<T> inputs(mini_batch_size * tank_peeks);
+    std::vector<T> targets(mini_batch_size);
+
+    metrics::EpochRecorder recorder("tank");
     for (int epoch = 0; epoch < epochs; epoch++) {
         double success_count = 0.0;
         double mean_loss = 0.0;
 
-        for (int i = 0; i < batch_size; i++) {
-        TankPopulationExercise ex =
-                CreateTankPopulationExercise(tank_min, tank_max, tank_peeks);
+        for (int start = 0; start < batch_size; start += mini_batch_size) {
+            const int count = std::min(mini_batch_size, batch_size - start);
 
-            // Convert population peeks from ints to a percentage of the max pop
-            std::vector<double> input;
-            for (auto& p : ex.population_peeks) {
-                input.emplace_back(static_cast<double>(p)/tank_max);
-            }
+            training_generator.FillBatch(count, inputs.data(),
+                                         targets.data());
 
-            // Same for population count
-            const double pop = static_cast<double>(ex.true_population) / 
-                               static_cast<double>(tank_max);
-            std::vector<double> target;
-            target.emplace_back(pop);
-            
-            // Forward propagation
-            std::vector<double> output;
-            output = network.Forwards(input);
-            
-            // Backwards propagation, including update weights and biases
-            network.Backwards(target);
+            // Forward and backwards propagation, including update weights
+            // and biases
+            const T* output = trainer.TrainBatch(inputs.data(),
+                                                 targets.data(), count);
 
             // Keep track of the number of succsseful predictions
-            double prediction = output.at(0) * tank_max;
-            success_count += (abs(prediction - pop) < 0.1);
-            
-            std::vector<double> loss = network.CalculateError(target);
-            auto const count = static_cast<float>(loss.size());
-            mean_loss += std::reduce(loss.begin(), loss.end()) / count
+            for (int j = 0; j < count; j++) {
+                double prediction = output[j] * tank_max;
+                success_count += (abs(prediction - targets.at(j)) < 0.1);
+            }
+
+            mean_loss += trainer.LastBatchError() * count
                          / tank_max;
         }
 
         double success_rate = success_count / tank_max;
 
-        printf("Epoch %d success rate: %.0f%% mean loss: %f\n",
-                epoch, success_rate*100, mean_loss);
+        const metrics::EpochMetrics& epoch_metrics = recorder.EndEpoch(
+                                                        epoch, batch_size);
+        printf("Epoch %d success rate: %.0f%% mean loss: %f "
+               "(%.0f samples/s, %.2f GFLOP/s)\n", epoch, success_rate*100,
+               mean_loss, epoch_metrics.samples_per_second,
+               epoch_metrics.flops_per_second * 1e-9);
     }
 
-    const int kTotalRuns = 10000;
-    mean_error = 0.0;
-    for (int i = 0; i < kTotalRuns; i++) {
-        TankPopulationExercise ex =
-                CreateTankPopulationExercise(tank_min, tank_max, tank_peeks);
-
-        // Convert population peeks from ints to a percentage of the max pop
-        std::vector<double> input;
-        for (auto& p : ex.population_peeks) {
-            input.emplace_back(static_cast<double>(p)/tank_max);
-        }
-        
-        // Forward propagation
-        std::vector<double> output;
-        output = network.Forwards(input);
-
-        // Keep track of the number of succsseful predictions
-        double prediction = output.at(0) * tank_max;
-        const double error = abs(prediction - ex.true_population) /
-                             static_cast<double>(ex.true_population);
-
-        mean_error += error / kTotalRuns;
+    if (!save_model.empty()) {
+        network.Save(save_model);
+        printf("Saved model to \"%s\"\n", save_model.c_str());
     }
-    printf("Mean error over %d runs: %.2f%%\n",
-            kTotalRuns, mean_error * 100);
+
+    // Evaluate the trained weights with the read-only inference engine
+    EvaluateTankNetwork(CompiledNetwork<T>(network), evaluation_generator,
+                        tank_max, tank_peeks);
     
     return 0;
 }
 
-int main(int argc, char** argv) {
-    int seed = time(NULL);
-    printf("Seed: %d\n", seed);
-    srand(seed);
-
-    static auto config = Config("config.ini");
+// Settings of the config shared by every demo
+struct GeneralConfig {
+    int epochs = 0;
+    int batch_size = 0;
+    int mini_batch_size = 0;
+    int threads = 0;
+    int data_threads = 0;
+    int sweep_threads = 0;
+    int test_count = 0;
+    double learning_rate = 0.0;
+    std::string optimizer = "sgd";
+    double momentum = 0.0;
+    double adam_beta1 = 0.0;
+    double adam_beta2 = 0.0;
+    double adam_epsilon = 0.0;
+    std::string loss = "mean_squared_error";
+    std::string trainer = "data_parallel";
+    std::string activation = "";
+    std::vector<int> hidden_layers;
+    std::string demo = "";
+    std::string precision = "double";
+    std::string exp_mode = "exact";
+    std::string save_model = "";
+    std::string load_model = "";
+    std::string quantize = "";
+    int calibration_samples = 0;
+    double prune_threshold = 0.0;
+    double prune_sparsity = 0.0;
+    int prune_epochs = 0;
+    std::string evaluate = "";
+    std::string metrics_file = "";
+    int seed = 0;
+};
 
-    struct {
-        int epochs = 0;
-        int batch_size = 0;
-        int test_count = 0;
-        double learning_rate = 0.0;
-        std::string activation = "";
-        std::vector<int> hidden_layers;
-        std::string demo = "";
-    } general_cfg;
+// Keys that may list several values to sweep over. Each only changes how one
+// network is trained, so every combination can train at once.
+const std::vector<std::string> kSweepableKeys = {
+    "epochs", "batch_size", "mini_batch_size", "learning_rate", "optimizer",
+    "momentum", "adam_beta1", "adam_beta2", "adam_epsilon", "loss",
+    "hidden_layers", "seed"
+};
 
+/// @brief Loads the shared settings from a config without swept keys
+GeneralConfig LoadGeneralConfig(const Config& config) {
+    GeneralConfig general_cfg;
     config.LoadStructFromConfig(general_cfg, {
         {"epochs", &general_cfg.epochs},
         {"batch_size", &general_cfg.batch_size},
+        {"mini_batch_size", &general_cfg.mini_batch_size},
+        {"threads", &general_cfg.threads},
+        {"data_threads", &general_cfg.data_threads},
+        {"sweep_threads", &general_cfg.sweep_threads},
         {"test_count", &general_cfg.test_count},
         {"learning_rate", &general_cfg.learning_rate},
+        {"optimizer", &general_cfg.optimizer},
+        {"momentum", &general_cfg.momentum},
+        {"adam_beta1", &general_cfg.adam_beta1},
+        {"adam_beta2", &general_cfg.adam_beta2},
+        {"adam_epsilon", &general_cfg.adam_epsilon},
+        {"loss", &general_cfg.loss},
+        {"trainer", &general_cfg.trainer},
         {"activation", &general_cfg.activation},
         {"hidden_layers", &general_cfg.hidden_layers},
-        {"demo", &general_cfg.demo}
+        {"demo", &general_cfg.demo},
+        {"precision", &general_cfg.precision},
+        {"exp_mode", &general_cfg.exp_mode},
+        {"save_model", &general_cfg.save_model},
+        {"load_model", &general_cfg.load_model},
+        {"quantize", &general_cfg.quantize},
+        {"calibration_samples", &general_cfg.calibration_samples},
+        {"prune_threshold", &general_cfg.prune_threshold},
+        {"prune_sparsity", &general_cfg.prune_sparsity},
+        {"prune_epochs", &general_cfg.prune_epochs},
+        {"evaluate", &general_cfg.evaluate},
+        {"metrics_file", &general_cfg.metrics_file},
+        {"seed", &general_cfg.seed}
     });
+    return general_cfg;
+}
+
+/// @brief Optimizer selected by the shared settings
+OptimizerConfig LoadOptimizer(const GeneralConfig& general_cfg) {
+    OptimizerConfig optimizer;
+    optimizer.type = ParseOptimizerType(general_cfg.optimizer);
+    optimizer.learning_rate = general_cfg.learning_rate;
+    optimizer.momentum = general_cfg.momentum;
+    optimizer.beta1 = general_cfg.adam_beta1;
+    optimizer.beta2 = general_cfg.adam_beta2;
+    optimizer.epsilon = general_cfg.adam_epsilon;
+    return optimizer;
+}
+
+int main(int argc, char** argv) {
+    static auto config = Config("config.ini");
+
+    // Every combination of the swept keys, or only the config itself. The
+    // settings that are not swept are the same in each.
+    const std::vector<Config> combinations = config.Combinations();
+    for (const std::string& key : config.SweptKeys()) {
+        if (std::find(kSweepableKeys.begin(), kSweepableKeys.end(), key)
+            == kSweepableKeys.end()) {
+            printf("Key \"%s\" cannot list several values\n", key.c_str());
+            return 1;
+        }
+    }
+    const bool sweep = combinations.size() > 1;
+    const GeneralConfig general_cfg = LoadGeneralConfig(combinations.front());
+    if (sweep && general_cfg.demo != "mnist") {
+        printf("Only the mnist demo can sweep over several values\n");
+        return 1;
+    }
+
+    // Every random number is drawn from a stream of this seed, so runs with
+    // the same config are reproducible
+    const uint64_t seed = static_cast<uint32_t>(general_cfg.seed);
+    if (!sweep) {
+        printf("Seed: %d\n", general_cfg.seed);
+    }
+
+    if (general_cfg.precision != "float" && general_cfg.precision != "double") {
+        printf("Unknown precision \"%s\", expected float or double\n",
+               general_cfg.precision.c_str());
+        return 1;
+    }
+    const bool use_float = general_cfg.precision == "float";
+
+    if (general_cfg.exp_mode == "fast") {
+        kernels::SetExpMode(kernels::ExpMode::kFast);
+    }
+    else if (general_cfg.exp_mode != "exact") {
+        printf("Unknown exp_mode \"%s\", expected exact or fast\n",
+               general_cfg.exp_mode.c_str());
+        return 1;
+    }
+
+    const OptimizerConfig optimizer = LoadOptimizer(general_cfg);
+    if (!sweep) {
+        printf("Optimizer: %s, learning rate %g\n",
+               OptimizerName(optimizer.type), optimizer.learning_rate);
+    }
+
+    // The tank demo is a regression and always uses mean squared error
+    const LossType loss = ParseLossType(general_cfg.loss);
+
+    // The tank demo always trains data parallel
+    const TrainerType trainer = ParseTrainerType(general_cfg.trainer);
+
+    // Post-training quantization, disabled when quantize is empty
+    QuantizationConfig quantization;
+    quantization.enabled = !general_cfg.quantize.empty();
+    if (quantization.enabled) {
+        quantization.scheme = ParseQuantizationScheme(general_cfg.quantize);
+    }
+    quantization.calibration_samples = general_cfg.calibration_samples;
+
+    // Magnitude pruning, disabled when both thresholds are zero
+    PruningConfig pruning;
+    pruning.threshold = general_cfg.prune_threshold;
+    pruning.sparsity = general_cfg.prune_sparsity;
+    pruning.fine_tune_epochs = general_cfg.prune_epochs;
+
+    // Full dataset evaluation, disabled when evaluate is empty
+    EvaluationConfig evaluation;
+    if (general_cfg.evaluate == "test" || general_cfg.evaluate == "all") {
+        evaluation.test = true;
+        evaluation.train = general_cfg.evaluate == "all";
+    }
+    else if (!general_cfg.evaluate.empty()) {
+        printf("Unknown evaluate \"%s\", expected test, all or empty\n",
+               general_cfg.evaluate.c_str());
+        return 1;
+    }
+
+    if (!general_cfg.metrics_file.empty()) {
+        metrics::OpenSink(general_cfg.metrics_file);
+    }
 
     if (general_cfg.demo == "tank") {
         struct {
@@ -138,20 +343,60 @@ int main(int argc, char** argv) {
             {"tank_peeks", &tank_cfg.tank_peeks},
         });
 
-        TankTraining(general_cfg.epochs, general_cfg.batch_size, 
-                     tank_cfg.tank_min, tank_cfg.tank_max, tank_cfg.tank_peeks,
-                     general_cfg.test_count, general_cfg.hidden_layers);
+        auto tank_training = use_float ? TankTraining<float>
+                                       : TankTraining<double>;
+        tank_training(general_cfg.epochs, general_cfg.batch_size,
+                      general_cfg.mini_batch_size, general_cfg.threads,
+                      tank_cfg.tank_min,
+                      tank_cfg.tank_max, tank_cfg.tank_peeks,
+                      general_cfg.test_count, general_cfg.hidden_layers,
+                      optimizer, general_cfg.save_model,
+                      general_cfg.load_model, seed);
+    }
+    else if (general_cfg.demo == "mnist" && sweep) {
+        if (!general_cfg.save_model.empty() || !general_cfg.load_model.empty()
+            || quantization.enabled || pruning.Enabled()) {
+            printf("Sweeps train every network from scratch, ignoring "
+                   "model files, quantization and pruning\n");
+        }
+        std::vector<SweepRun> runs;
+        for (const Config& combination : combinations) {
+            const GeneralConfig run_cfg = LoadGeneralConfig(combination);
+            SweepRun run;
+            for (const std::string& key : config.SweptKeys()) {
+                run.settings += (run.settings.empty() ? "" : " ") + key + "="
+                                + combination.Text(key);
+            }
+            run.epochs = run_cfg.epochs;
+            run.batch_size = run_cfg.batch_size;
+            run.mini_batch_size = run_cfg.mini_batch_size;
+            run.hidden_layers = run_cfg.hidden_layers;
+            run.optimizer = LoadOptimizer(run_cfg);
+            run.loss = ParseLossType(run_cfg.loss);
+            run.seed = static_cast<uint32_t>(run_cfg.seed);
+            runs.push_back(run);
+        }
+        auto mnist_sweep = use_float ? MnistSweep<float> : MnistSweep<double>;
+        mnist_sweep(runs, general_cfg.sweep_threads);
     }
     else if (general_cfg.demo == "mnist") {
-        MnistExample(general_cfg.epochs, general_cfg.batch_size,
-                     general_cfg.test_count, general_cfg.hidden_layers);
+        auto mnist_example = use_float ? MnistExample<float>
+                                       : MnistExample<double>;
+        mnist_example(general_cfg.epochs, general_cfg.batch_size,
+                      general_cfg.mini_batch_size, general_cfg.threads,
+                      general_cfg.data_threads, general_cfg.test_count,
+                      general_cfg.hidden_layers, optimizer, loss, trainer,
+                      quantization, pruning, evaluation,
+                      general_cfg.save_model,
+                      general_cfg.load_model, seed);
     }
     else if (general_cfg.demo == "simple") {
-        SimpleExample(general_cfg.epochs, general_cfg.hidden_layers);
+        SimpleExample(general_cfg.epochs, general_cfg.hidden_layers, seed);
     }
     else {
         printf("Unknown demo type \"%s\"\n", general_cfg.demo.c_str());
     }
+    metrics::CloseSink();
 
     return 0;
 }
\ No newline at end of file
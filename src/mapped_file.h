@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/// @brief Read-only memory mapping of a whole file. Pages are loaded on first
+///        access and shared with every other process mapping the same file.
+///        The mapping is released when the object is destroyed.
+///        Example usage:
+///
+///    MappedFile file("model.bin");
+///    const uint8_t* bytes = file.Data();
+class MappedFile {
+private:
+    const uint8_t* data_ = nullptr;
+    size_t size_ = 0;
+
+public:
+    /// @brief Maps a file. Throws runtime_error if the file cannot be opened,
+    ///        is empty, or cannot be mapped.
+    /// @param path path to the file
+    explicit MappedFile(const std::string& path);
+
+    /// @brief Unmaps the file
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    /// @brief Start of the mapped file, aligned to a page boundary
+    const uint8_t* Data() const { return data_; }
+
+    /// @brief Size of the file in bytes
+    size_t Size() const { return size_; }
+};
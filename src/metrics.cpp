@@ -0,0 +1,277 @@
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "metrics.h"
+
+namespace metrics {
+
+namespace {
+
+// Counters of one thread. Only the owning thread writes them, so updates are
+// a relaxed load and store rather than a locked read-modify-write.
+struct ThreadCounters {
+    std::atomic<uint64_t> calls[kNumCounters] = {};
+    std::atomic<uint64_t> nanoseconds[kNumCounters] = {};
+    std::atomic<uint64_t> flops[kNumCounters] = {};
+};
+
+void Add(std::atomic<uint64_t>& value, const uint64_t& amount) {
+    value.store(value.load(std::memory_order_relaxed) + amount,
+                std::memory_order_relaxed);
+}
+
+// Counters of every thread that has recorded anything. Kept after their
+// thread exits so its contribution is not lost.
+struct Registry {
+    std::mutex mutex;
+    std::vector<std::unique_ptr<ThreadCounters>> threads;
+};
+
+Registry& GetRegistry() {
+    static Registry registry;
+    return registry;
+}
+
+ThreadCounters& LocalCounters() {
+    thread_local ThreadCounters* local = [] {
+        Registry& registry = GetRegistry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        registry.threads.emplace_back(new ThreadCounters());
+        return registry.threads.back().get();
+    }();
+    return *local;
+}
+
+/// @brief Writes epoch metrics to a file on a background thread
+class Sink {
+private:
+    std::mutex mutex;
+    std::condition_variable record_ready;
+    std::vector<EpochMetrics> pending;
+    std::thread writer;
+    FILE* file = nullptr;
+    bool csv = false;
+    bool stopping = false;
+
+    void WriterLoop() {
+        std::vector<EpochMetrics> records;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                record_ready.wait(lock, [&]() {
+                    return stopping || !pending.empty();
+                });
+                if (pending.empty()) {
+                    return;
+                }
+                records.swap(pending);
+            }
+            for (const EpochMetrics& record : records) {
+                csv ? WriteCsv(record) : WriteJson(record);
+            }
+            fflush(file);
+            records.clear();
+        }
+    }
+
+    void WriteCsvHeader() {
+        fprintf(file, "run,epoch,samples,seconds,samples_per_second,"
+                      "flops_per_second");
+        for (int i = 0; i < kNumCounters; i++) {
+            const char* name = CounterName(static_cast<Counter>(i));
+            fprintf(file, ",%s_calls,%s_seconds,%s_flops", name, name, name);
+        }
+        fprintf(file, "\n");
+    }
+
+    void WriteCsv(const EpochMetrics& record) {
+        fprintf(file, "%s,%d,%d,%.6f,%.6g,%.6g", record.run.c_str(),
+                record.epoch, record.samples, record.seconds,
+                record.samples_per_second, record.flops_per_second);
+        for (const CounterValue& value : record.counters.counters) {
+            fprintf(file, ",%llu,%.6f,%llu",
+                    static_cast<unsigned long long>(value.calls),
+                    value.nanoseconds * 1e-9,
+                    static_cast<unsigned long long>(value.flops));
+        }
+        fprintf(file, "\n");
+    }
+
+    void WriteJson(const EpochMetrics& record) {
+        fprintf(file, "{\"run\": \"%s\", \"epoch\": %d, \"samples\": %d, "
+                      "\"seconds\": %.6f, \"samples_per_second\": %.6g, "
+                      "\"flops_per_second\": %.6g, \"counters\": {",
+                record.run.c_str(), record.epoch, record.samples,
+                record.seconds, record.samples_per_second,
+                record.flops_per_second);
+        for (int i = 0; i < kNumCounters; i++) {
+            const CounterValue& value = record.counters.counters[i];
+            fprintf(file, "%s\"%s\": {\"calls\": %llu, \"seconds\": %.6f, "
+                          "\"flops\": %llu}", i > 0 ? ", " : "",
+                    CounterName(static_cast<Counter>(i)),
+                    static_cast<unsigned long long>(value.calls),
+                    value.nanoseconds * 1e-9,
+                    static_cast<unsigned long long>(value.flops));
+        }
+        fprintf(file, "}}\n");
+    }
+
+public:
+    ~Sink() { Close(); }
+
+    void Open(const std::string& path) {
+        Close();
+        FILE* opened = fopen(path.c_str(), "w");
+        if (opened == nullptr) {
+            throw std::runtime_error("Failed to open metrics file \"" + path
+                                     + "\"");
+        }
+        file = opened;
+        csv = path.size() >= 4 && path.compare(path.size() - 4, 4, ".csv")
+                                  == 0;
+        if (csv) {
+            WriteCsvHeader();
+        }
+        stopping = false;
+        writer = std::thread(&Sink::WriterLoop, this);
+    }
+
+    void Close() {
+        if (file == nullptr) {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        record_ready.notify_one();
+        writer.join();
+        fclose(file);
+        file = nullptr;
+    }
+
+    /// @brief Queues a record, dropped if no file is open. Only copies the
+    ///        record under the lock.
+    void Push(const EpochMetrics& record) {
+        if (file == nullptr) {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            pending.push_back(record);
+        }
+        record_ready.notify_one();
+    }
+};
+
+Sink& GetSink() {
+    static Sink sink;
+    return sink;
+}
+
+}  // namespace
+
+const char* CounterName(const Counter& counter) {
+    switch (counter) {
+        case Counter::kLayerForwards: return "layer_forwards";
+        case Counter::kLayerBackwards: return "layer_backwards";
+        case Counter::kLoss: return "loss";
+        case Counter::kDataLoad: return "data_load";
+        case Counter::kBatchAssembly: return "batch_assembly";
+        case Counter::kBatchWait: return "batch_wait";
+        case Counter::kNumCounters: break;
+    }
+    return "unknown";
+}
+
+// =======================================
+// Counters
+// =======================================
+
+void Record(const Counter& counter, const uint64_t& nanoseconds,
+            const uint64_t& flops) {
+    ThreadCounters& local = LocalCounters();
+    const int i = static_cast<int>(counter);
+    Add(local.calls[i], 1);
+    Add(local.nanoseconds[i], nanoseconds);
+    Add(local.flops[i], flops);
+}
+
+Totals Snapshot() {
+    Totals totals;
+    Registry& registry = GetRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    for (const std::unique_ptr<ThreadCounters>& thread : registry.threads) {
+        for (int i = 0; i < kNumCounters; i++) {
+            CounterValue& value = totals.counters[i];
+            value.calls += thread->calls[i].load(std::memory_order_relaxed);
+            value.nanoseconds += thread->nanoseconds[i].load(
+                                                std::memory_order_relaxed);
+            value.flops += thread->flops[i].load(std::memory_order_relaxed);
+        }
+    }
+    return totals;
+}
+
+// =======================================
+// Epoch Metrics
+// =======================================
+
+EpochRecorder::EpochRecorder(const std::string& run) :
+                             run_(run), epoch_start(Clock::now()),
+                             epoch_start_totals(Snapshot()) {
+}
+
+const EpochMetrics& EpochRecorder::EndEpoch(const int& epoch,
+                                            const int& samples) {
+    const Clock::time_point now = Clock::now();
+    const Totals totals = Snapshot();
+
+    last.run = run_;
+    last.epoch = epoch;
+    last.samples = samples;
+    last.seconds = std::chrono::duration<double>(now - epoch_start).count();
+    uint64_t flops = 0;
+    for (int i = 0; i < kNumCounters; i++) {
+        CounterValue& delta = last.counters.counters[i];
+        const CounterValue& end = totals.counters[i];
+        const CounterValue& start = epoch_start_totals.counters[i];
+        delta.calls = end.calls - start.calls;
+        delta.nanoseconds = end.nanoseconds - start.nanoseconds;
+        delta.flops = end.flops - start.flops;
+        flops += delta.flops;
+    }
+    last.samples_per_second = last.seconds > 0 ? samples / last.seconds : 0;
+    last.flops_per_second = last.seconds > 0 ? flops / last.seconds : 0;
+
+    GetSink().Push(last);
+
+    epoch_start = now;
+    epoch_start_totals = totals;
+    return last;
+}
+
+void EpochRecorder::RestartEpoch() {
+    epoch_start = Clock::now();
+    epoch_start_totals = Snapshot();
+}
+
+// =======================================
+// Sink
+// =======================================
+
+void OpenSink(const std::string& path) {
+    GetSink().Open(path);
+}
+
+void CloseSink() {
+    GetSink().Close();
+}
+
+}  // namespace metrics
@@ -0,0 +1,170 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+/*
+    Hot path instrumentation. METRICS_SCOPE times the enclosing scope and adds
+    it, with a number of floating point operations, to one of a fixed set of
+    counters. Each thread adds to its own counters, so recording never takes a
+    lock. Building with `make METRICS=0` defines METRICS_DISABLED, which
+    compiles every METRICS_SCOPE out; epoch throughput is still reported, with
+    zero FLOP/s.
+
+    Once per epoch an EpochRecorder takes the change in every counter, and
+    hands it to an asynchronous sink which writes it to a CSV or JSON lines
+    file on a background thread, so file I/O never stalls training.
+*/
+
+namespace metrics {
+
+/// @brief Instrumented sections of the hot path
+enum class Counter {
+    // Layer::ForwardsBatch
+    kLayerForwards,
+    // Layer::BackwardsBatch
+    kLayerBackwards,
+    // Loss of a batch against its targets
+    kLoss,
+    // Opening and validating a dataset
+    kDataLoad,
+    // Filling a mini-batch with samples and targets
+    kBatchAssembly,
+    // Training thread waiting for the next mini-batch to be assembled
+    kBatchWait,
+    kNumCounters,
+};
+
+constexpr int kNumCounters = static_cast<int>(Counter::kNumCounters);
+
+/// @brief Name of a counter used in the output files, e.g. "layer_forwards"
+const char* CounterName(const Counter& counter);
+
+/// @brief Accumulated values of one counter
+struct CounterValue {
+    uint64_t calls = 0;
+    uint64_t nanoseconds = 0;
+    uint64_t flops = 0;
+};
+
+/// @brief Accumulated values of every counter
+struct Totals {
+    CounterValue counters[kNumCounters];
+
+    const CounterValue& operator[](const Counter& counter) const {
+        return counters[static_cast<int>(counter)];
+    }
+};
+
+/// @brief Adds one timed call to the calling thread's counters
+/// @param counter counter to add to
+/// @param nanoseconds duration of the call
+/// @param flops floating point operations performed by the call
+void Record(const Counter& counter, const uint64_t& nanoseconds,
+            const uint64_t& flops);
+
+/// @brief Sums the counters of every thread that has recorded anything
+/// @return totals since the start of the process
+Totals Snapshot();
+
+/// @brief Times its own lifetime and records it to a counter on destruction
+class ScopedTimer {
+private:
+    using Clock = std::chrono::steady_clock;
+
+    Counter counter_;
+    uint64_t flops_;
+    Clock::time_point start;
+
+public:
+    /// @brief Constructor, starts the timer
+    /// @param counter counter to record to
+    /// @param flops floating point operations performed in the scope
+    explicit ScopedTimer(const Counter& counter, const uint64_t& flops = 0) :
+                         counter_(counter), flops_(flops),
+                         start(Clock::now()) {}
+
+    ~ScopedTimer() {
+        const auto elapsed = std::chrono::duration_cast<
+                    std::chrono::nanoseconds>(Clock::now() - start).count();
+        Record(counter_, static_cast<uint64_t>(elapsed), flops_);
+    }
+
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+};
+
+/// @brief Metrics of one epoch of a training run
+struct EpochMetrics {
+    std::string run;
+    int epoch = 0;
+    int samples = 0;
+    double seconds = 0.0;
+    double samples_per_second = 0.0;
+    // Floating point operations per second over every instrumented counter
+    double flops_per_second = 0.0;
+    // Change in every counter over the epoch
+    Totals counters;
+};
+
+/// @brief Measures the epochs of a training run. The first epoch starts on
+///        construction, and each one ends when EndEpoch is called.
+///        Example usage:
+///
+///    metrics::EpochRecorder recorder("mnist");
+///    for (int epoch = 0; epoch < epochs; epoch++) {
+///        Train();
+///        const metrics::EpochMetrics& m = recorder.EndEpoch(epoch, samples);
+///    }
+class EpochRecorder {
+private:
+    using Clock = std::chrono::steady_clock;
+
+    std::string run_;
+    Clock::time_point epoch_start;
+    Totals epoch_start_totals;
+    EpochMetrics last;
+
+public:
+    /// @brief Constructor, starts the first epoch
+    /// @param run name of the run in the output files, e.g. "tank"
+    explicit EpochRecorder(const std::string& run);
+
+    /// @brief Ends the current epoch and starts the next. Sends the epoch's
+    ///        metrics to the sink if one is open.
+    /// @param epoch number of the epoch ending
+    /// @param samples number of samples trained on in the epoch
+    /// @return metrics of the epoch, valid until the next call
+    const EpochMetrics& EndEpoch(const int& epoch, const int& samples);
+
+    /// @brief Restarts the current epoch from now, excluding any time and
+    ///        counters since the last EndEpoch, e.g. an evaluation between
+    ///        epochs
+    void RestartEpoch();
+};
+
+/// @brief Opens the file epoch metrics are written to, replacing any open
+///        one. Files ending in .csv are written as CSV with a header row,
+///        anything else as one JSON object per line. Throws runtime_error if
+///        the file cannot be opened.
+/// @param path file to write
+void OpenSink(const std::string& path);
+
+/// @brief Writes every pending record and closes the file, if open
+void CloseSink();
+
+}  // namespace metrics
+
+#define METRICS_CONCAT_INNER(a, b) a##b
+#define METRICS_CONCAT(a, b) METRICS_CONCAT_INNER(a, b)
+
+#ifndef METRICS_DISABLED
+/// @brief Times the rest of the enclosing scope into a metrics::Counter, with
+///        an optional number of floating point operations
+#define METRICS_SCOPE(...)                                                    \
+    const metrics::ScopedTimer METRICS_CONCAT(metrics_scope_, __LINE__)      \
+                (__VA_ARGS__)
+#else
+#define METRICS_SCOPE(...) do {} while (false)
+#endif
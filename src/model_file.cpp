@@ -0,0 +1,178 @@
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+
+#include "model_file.h"
+#include "aligned_allocator.h"
+
+namespace {
+
+// Rounds a byte offset up to the next cache line
+uint64_t AlignOffset(const uint64_t& offset) {
+    return (offset + kCacheLineSize - 1) / kCacheLineSize * kCacheLineSize;
+}
+
+}  // namespace
+
+template<typename T>
+void SaveModelFile(const std::string& path,
+                   const std::vector<LayerView<T>>& layers) {
+    if (layers.empty()) {
+        throw std::runtime_error("Cannot save a model with no layers to \""
+                                 + path + "\"");
+    }
+
+    ModelFileHeader header = {};
+    std::memcpy(header.magic, kModelFileMagic, sizeof(header.magic));
+    header.version = kModelFileVersion;
+    header.byte_order = kModelFileByteOrder;
+    header.scalar_size = sizeof(T);
+    header.num_layers = static_cast<uint32_t>(layers.size());
+    header.num_inputs = static_cast<uint32_t>(layers.front().num_inputs);
+    header.num_outputs = static_cast<uint32_t>(layers.back().num_neurons);
+
+    // Lay out the data blocks after the layer table
+    std::vector<ModelFileLayer> table(layers.size());
+    uint64_t offset = sizeof(ModelFileHeader)
+                      + sizeof(ModelFileLayer) * layers.size();
+    for (size_t i = 0; i < layers.size(); i++) {
+        const LayerView<T>& layer = layers[i];
+        ModelFileLayer& entry = table[i];
+        entry = {};
+        entry.num_inputs = static_cast<uint32_t>(layer.num_inputs);
+        entry.num_neurons = static_cast<uint32_t>(layer.num_neurons);
+        entry.activation = static_cast<uint32_t>(layer.activation.type);
+
+        entry.weights_offset = AlignOffset(offset);
+        offset = entry.weights_offset + sizeof(T)
+                 * static_cast<uint64_t>(layer.num_neurons) * layer.num_inputs;
+        entry.biases_offset = AlignOffset(offset);
+        offset = entry.biases_offset + sizeof(T) * layer.num_neurons;
+    }
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        throw std::runtime_error("Failed to open \"" + path
+                                 + "\" for writing");
+    }
+
+    // Writes a block at its offset, zero filling the gap before it
+    uint64_t position = 0;
+    const char padding[kCacheLineSize] = {};
+    auto write_at = [&](const uint64_t& at, const void* data,
+                        const uint64_t& size) {
+        file.write(padding, static_cast<std::streamsize>(at - position));
+        file.write(static_cast<const char*>(data),
+                   static_cast<std::streamsize>(size));
+        position = at + size;
+    };
+
+    write_at(0, &header, sizeof(header));
+    write_at(position, table.data(), sizeof(ModelFileLayer) * table.size());
+    for (size_t i = 0; i < layers.size(); i++) {
+        const LayerView<T>& layer = layers[i];
+        write_at(table[i].weights_offset, layer.weights, sizeof(T)
+                 * static_cast<uint64_t>(layer.num_neurons) * layer.num_inputs);
+        write_at(table[i].biases_offset, layer.biases,
+                 sizeof(T) * layer.num_neurons);
+    }
+
+    if (!file.good()) {
+        throw std::runtime_error("Failed to write model file \"" + path
+                                 + "\"");
+    }
+}
+
+template<typename T>
+std::vector<LayerView<T>> ReadModelFile(const MappedFile& file,
+                                        const std::string& path) {
+    const uint8_t* data = file.Data();
+    const uint64_t size = file.Size();
+    auto invalid = [&](const std::string& reason) {
+        return std::runtime_error("Invalid model file \"" + path + "\": "
+                                  + reason);
+    };
+
+    if (size < sizeof(ModelFileHeader)) {
+        throw invalid("file is too small for the header");
+    }
+    ModelFileHeader header;
+    std::memcpy(&header, data, sizeof(header));
+    if (std::memcmp(header.magic, kModelFileMagic, sizeof(header.magic)) != 0) {
+        throw invalid("bad magic number");
+    }
+    if (header.version != kModelFileVersion) {
+        throw invalid("version is " + std::to_string(header.version)
+                      + ", expected " + std::to_string(kModelFileVersion));
+    }
+    if (header.byte_order != kModelFileByteOrder) {
+        throw invalid("saved on a host with a different byte order");
+    }
+    if (header.scalar_size != sizeof(T)) {
+        throw invalid("weights are " + std::to_string(header.scalar_size * 8)
+                      + " bit, expected " + std::to_string(sizeof(T) * 8)
+                      + " bit");
+    }
+    if (header.num_layers == 0 || size < sizeof(ModelFileHeader)
+                + sizeof(ModelFileLayer) * uint64_t(header.num_layers)) {
+        throw invalid("bad layer count " + std::to_string(header.num_layers));
+    }
+
+    std::vector<LayerView<T>> layers(header.num_layers);
+    uint32_t expected_inputs = header.num_inputs;
+    for (uint32_t i = 0; i < header.num_layers; i++) {
+        ModelFileLayer entry;
+        std::memcpy(&entry, data + sizeof(ModelFileHeader)
+                            + sizeof(ModelFileLayer) * i, sizeof(entry));
+
+        // Layer sizes are held as int, larger counts would wrap
+        const uint32_t max_count = std::numeric_limits<int>::max();
+        if (entry.num_inputs != expected_inputs || entry.num_neurons == 0
+            || entry.num_inputs == 0 || entry.num_inputs > max_count
+            || entry.num_neurons > max_count) {
+            throw invalid("layer " + std::to_string(i) + " has "
+                          + std::to_string(entry.num_inputs) + " inputs and "
+                          + std::to_string(entry.num_neurons) + " neurons");
+        }
+        const uint64_t weights_size = sizeof(T)
+                    * static_cast<uint64_t>(entry.num_neurons)
+                    * entry.num_inputs;
+        const uint64_t biases_size = sizeof(T) * entry.num_neurons;
+        if (entry.weights_offset % kCacheLineSize != 0
+            || entry.biases_offset % kCacheLineSize != 0
+            || entry.weights_offset > size
+            || weights_size > size - entry.weights_offset
+            || entry.biases_offset > size
+            || biases_size > size - entry.biases_offset) {
+            throw invalid("layer " + std::to_string(i)
+                          + " data is misaligned or out of bounds");
+        }
+
+        LayerView<T>& layer = layers[i];
+        layer.weights = reinterpret_cast<const T*>(data
+                                                   + entry.weights_offset);
+        layer.biases = reinterpret_cast<const T*>(data + entry.biases_offset);
+        layer.num_inputs = static_cast<int>(entry.num_inputs);
+        layer.num_neurons = static_cast<int>(entry.num_neurons);
+        layer.activation = GetActivation<T>(
+                    static_cast<ActivationType>(entry.activation));
+        expected_inputs = entry.num_neurons;
+    }
+    if (expected_inputs != header.num_outputs) {
+        throw invalid("last layer has " + std::to_string(expected_inputs)
+                      + " neurons, expected "
+                      + std::to_string(header.num_outputs) + " outputs");
+    }
+
+    return layers;
+}
+
+template void SaveModelFile<float>(const std::string&,
+                                   const std::vector<LayerView<float>>&);
+template void SaveModelFile<double>(const std::string&,
+                                    const std::vector<LayerView<double>>&);
+template std::vector<LayerView<float>> ReadModelFile<float>(
+                                const MappedFile&, const std::string&);
+template std::vector<LayerView<double>> ReadModelFile<double>(
+                                const MappedFile&, const std::string&);
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "mapped_file.h"
+#include "neural_network.h"
+
+/// @brief Binary model file format, version 1. All values are in host byte
+///        order, which is recorded in the header and checked on load.
+///
+///    Offset  Size          Contents
+///    0       64            ModelFileHeader
+///    64      32 x layers   ModelFileLayer, one per layer in order
+///    ...                   Weight matrix then bias vector of each layer,
+///                          each block starting on a 64 byte boundary
+///
+///        Blocks are aligned so that a memory mapped file can be used for
+///        inference in place, without parsing or copying the weights.
+constexpr char kModelFileMagic[8] = {'B', 'N', 'N', 'M', 'O', 'D', 'E', 'L'};
+constexpr uint32_t kModelFileVersion = 1;
+constexpr uint32_t kModelFileByteOrder = 0x01020304;
+
+struct ModelFileHeader {
+    char magic[8];
+    uint32_t version;
+    // kModelFileByteOrder as written by the saving host
+    uint32_t byte_order;
+    // sizeof the scalar type of the weights, 4 for float or 8 for double
+    uint32_t scalar_size;
+    uint32_t num_layers;
+    uint32_t num_inputs;
+    uint32_t num_outputs;
+    uint8_t reserved[32];
+};
+static_assert(sizeof(ModelFileHeader) == 64, "Model file header layout");
+
+struct ModelFileLayer {
+    uint32_t num_inputs;
+    uint32_t num_neurons;
+    // ActivationType of every neuron in the layer
+    uint32_t activation;
+    uint32_t reserved;
+    // Byte offsets from the start of the file
+    uint64_t weights_offset;
+    uint64_t biases_offset;
+};
+static_assert(sizeof(ModelFileLayer) == 32, "Model file layer layout");
+
+/// @brief Writes layers to a model file. Throws runtime_error if the file
+///        cannot be written.
+/// @param path file to write
+/// @param layers views of every layer of the network in order
+template<typename T>
+void SaveModelFile(const std::string& path,
+                   const std::vector<LayerView<T>>& layers);
+
+/// @brief Validates a memory mapped model file and returns views of its
+///        layers. The views point into the mapping and are valid while it is
+///        alive. Throws runtime_error if the file is not a valid model file
+///        for the scalar type T.
+/// @param file mapped model file
+/// @param path path of the file, for error messages
+/// @return views of every layer of the network in order
+template<typename T>
+std::vector<LayerView<T>> ReadModelFile(const MappedFile& file,
+                                        const std::string& path);
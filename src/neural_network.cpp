@@ -1,253 +1,770 @@
+#include <cmath>
+#include <limits>
 #include <vector>
-#include <random>
 #include <stdexcept>
 
 #include "neural_network.h"
-
-#define LEARNING_RATE 0.025
-
-// Generate a random number between min and max
-double RandRange(const double &min, const double& max) 
-{
-    double range = (max - min); 
-    double div = RAND_MAX / range;
-    return min + (rand() / div);
-}
+#include "counter_rng.h"
+#include "kernels/kernels.h"
+#include "model_file.h"
+#include "metrics.h"
 
 // =======================================
 // Constructors
 // =======================================
 
-NeuralNetwork::NeuralNetwork(const int& num_inputs, const int& num_outputs, 
-                             const std::vector<int>& neurons_per_layer,
-                             ActivationFunction hidden_layer_activation,
-                             ActivationFunction output_layer_activation):
-                             num_inputs_(num_inputs), num_outputs_(num_outputs)
-                             {
+template<typename T>
+NeuralNetwork<T>::NeuralNetwork(const int& num_inputs, const int& num_outputs, 
+                                const std::vector<int>& neurons_per_layer,
+                                ActivationFunction<T> hidden_layer_activation,
+                                ActivationFunction<T> output_layer_activation,
+                                const uint64_t& seed):
+                                num_inputs_(num_inputs),
+                                num_outputs_(num_outputs) {
     int prev_size = num_inputs;
     for (const auto& neurons : neurons_per_layer) {
         // Each hidden layer has a number of inputs equal to the previous
         // layer's number of neurons
-        layers.emplace_back(Layer(prev_size, neurons, hidden_layer_activation));
+        layers.emplace_back(Layer<T>(prev_size, neurons,
+                                     hidden_layer_activation, seed,
+                                     static_cast<int>(layers.size())));
         prev_size = neurons;
     }
 
     // Output layer
-    layers.emplace_back(Layer(prev_size, num_outputs, output_layer_activation));
+    layers.emplace_back(Layer<T>(prev_size, num_outputs,
+                                 output_layer_activation, seed,
+                                 static_cast<int>(layers.size())));
+
+    workspace_ = CreateWorkspace();
 }
 
-Layer::Layer(const int& num_input_nodes, const int& num_neurons,
-             ActivationFunction activation) :
-             num_inputs(num_input_nodes) {
-    for (int i = 0; i < num_neurons; i++) {
-        neurons.emplace_back(Neuron(num_input_nodes, activation));
+template<typename T>
+Layer<T>::Layer(const int& num_input_nodes, const int& num_neurons,
+                ActivationFunction<T> activation, const uint64_t& seed,
+                const int& layer_index) :
+                num_inputs(num_input_nodes), num_neurons(num_neurons),
+                activation_(activation),
+                weights(static_cast<size_t>(num_neurons) * num_input_nodes),
+                biases(num_neurons) {
+    // Every value has its own counter, so the whole matrix is filled in one
+    // vectorised pass and never depends on the order values are drawn in
+    const uint64_t index = 2 * static_cast<uint64_t>(layer_index);
+    kernels::RandomUniform(weights.size(), seed,
+                RandomStream(RandomDomain::kWeightInit, index), 0, T(-1),
+                T(1), weights.data());
+    kernels::RandomUniform(biases.size(), seed,
+                RandomStream(RandomDomain::kWeightInit, index + 1), 0, T(-1),
+                T(1), biases.data());
+}
+
+template<typename T>
+Neuron<T>::Neuron(T* weights, T* bias, const int& num_inputs,
+                  const T* latest_output) :
+                  weights(weights), bias(bias), num_inputs(num_inputs),
+                  latest_output(latest_output) {
+}
+
+template<typename T>
+const Neuron<T> Layer<T>::GetNeuron(const int& neuron_idx,
+                                    const LayerWorkspace<T>& workspace) const {
+    // Views are built from mutable pointers. Returning a const Neuron only
+    // exposes its const methods.
+    Layer<T>* layer = const_cast<Layer<T>*>(this);
+    return Neuron<T>(&layer->weights[static_cast<size_t>(neuron_idx)
+                                     * num_inputs],
+                     &layer->biases[neuron_idx], num_inputs,
+                     &workspace.outputs[neuron_idx]);
+}
+
+template<typename T>
+LayerView<T> Layer<T>::View() const {
+    LayerView<T> view;
+    view.weights = weights.data();
+    view.biases = biases.data();
+    view.num_inputs = num_inputs;
+    view.num_neurons = num_neurons;
+    view.activation = activation_;
+    return view;
+}
+
+template<typename T>
+void Layer<T>::LoadWeights(const LayerView<T>& view) {
+    if (view.num_inputs != num_inputs || view.num_neurons != num_neurons) {
+        throw std::runtime_error("Cannot load a layer of "
+                    + std::to_string(view.num_inputs) + " inputs x "
+                    + std::to_string(view.num_neurons) + " neurons into a "
+                    + "layer of " + std::to_string(num_inputs) + " inputs x "
+                    + std::to_string(num_neurons) + " neurons");
+    }
+    if (view.activation.type != activation_.type) {
+        throw std::runtime_error("Cannot load a layer with activation type "
+                    + std::to_string(static_cast<uint32_t>(
+                                                view.activation.type))
+                    + " into a layer with activation type "
+                    + std::to_string(static_cast<uint32_t>(activation_.type)));
     }
+    std::copy(view.weights, view.weights + weights.size(), weights.begin());
+    std::copy(view.biases, view.biases + biases.size(), biases.begin());
+    weight_mask.clear();
 }
 
-Neuron::Neuron(const int& num_input_nodes, ActivationFunction activation) :
-               activation_(activation) {
-    bias = RandRange(-1, 1);
-    for (int i = 0; i < num_input_nodes; i++) {
-        weights.push_back(RandRange(-1, 1));
+// =======================================
+// Workspace Methods
+// =======================================
+
+template<typename T>
+Workspace<T> NeuralNetwork<T>::CreateWorkspace(const int& batch_size) const {
+    if (batch_size <= 0) {
+        throw std::runtime_error("Invalid batch size in NeuralNetwork::Create"
+                    "Workspace. Batch size is " + std::to_string(batch_size));
+    }
+
+    // Every buffer starts on a cache line
+    const size_t block = kCacheLineSize / sizeof(T);
+    auto block_size = [&](const size_t& count) {
+        return (count + block - 1) / block * block;
+    };
+    const size_t samples = static_cast<size_t>(batch_size);
+
+    size_t num_gradients = 0;
+    size_t num_activations = block_size(samples * num_outputs_);
+    for (const Layer<T>& layer : layers) {
+        const size_t num_neurons = layer.NumNeurons();
+        const size_t num_inputs = layer.NumInputs();
+        num_gradients += block_size(num_neurons * num_inputs)
+                         + block_size(num_neurons);
+        num_activations += 2 * block_size(samples * num_neurons)
+                           + block_size(samples * num_inputs);
+    }
+
+    Workspace<T> workspace;
+    workspace.arena.assign(num_gradients + num_activations, T(0));
+    workspace.num_gradients = num_gradients;
+    workspace.max_batch_size = batch_size;
+    workspace.layers.resize(layers.size());
+
+    T* next = workspace.arena.data();
+    auto carve = [&](const size_t& count) {
+        T* buffer = next;
+        next += block_size(count);
+        return buffer;
+    };
+    // Gradients of every layer first, so they can be reset and summed as one
+    // block
+    for (size_t i = 0; i < layers.size(); i++) {
+        const size_t num_neurons = layers[i].NumNeurons();
+        const size_t num_inputs = layers[i].NumInputs();
+        workspace.layers[i].weight_gradients = carve(num_neurons
+                                                     * num_inputs);
+        workspace.layers[i].bias_gradients = carve(num_neurons);
+    }
+    for (size_t i = 0; i < layers.size(); i++) {
+        const size_t num_neurons = layers[i].NumNeurons();
+        const size_t num_inputs = layers[i].NumInputs();
+        LayerWorkspace<T>& layer = workspace.layers[i];
+        layer.outputs = carve(samples * num_neurons);
+        layer.delta = carve(samples * num_neurons);
+        layer.dCost_dInput = carve(samples * num_inputs);
+        layer.max_batch_size = batch_size;
     }
+    workspace.dCost_dOutput = carve(samples * num_outputs_);
+
+    return workspace;
+}
+
+template<typename T>
+void Workspace<T>::AddGradients(const Workspace<T>& other) {
+    if (other.num_gradients != num_gradients) {
+        throw std::runtime_error("Workspace mismatch in Workspace::AddGradients"
+                    ". Workspace has " + std::to_string(num_gradients)
+                    + " gradients, other has "
+                    + std::to_string(other.num_gradients));
+    }
+    // Padding between the gradient buffers is zero in both
+    kernels::Axpy(num_gradients, T(1), other.arena.data(), arena.data());
+}
+
+template<typename T>
+void Workspace<T>::ResetGradients() {
+    std::fill(arena.begin(), arena.begin() + num_gradients, T(0));
 }
 
 // =======================================
 // Forward Propagation Methods
 // =======================================
 
-std::vector<double> NeuralNetwork::Forwards(const std::vector<double>& input) {
+template<typename T>
+const std::vector<T>& NeuralNetwork<T>::Forwards(const std::vector<T>&
+                                                 input) {
     if (num_inputs_ != input.size()) {
         throw std::runtime_error("Input size mismatch in NeuralNetwork::Forward"
                     "s. Input size is " + std::to_string(input.size()) 
                     + ", expected input size " + std::to_string(num_inputs_));
     }
 
-    std::vector<double> next_input = input;
-    std::vector<double> current_output;
+    // A single sample is a batch of one
+    const T* output = ForwardsBatch(input.data(), 1);
 
-    for (Layer& layer : layers) {
-        current_output = layer.Forwards(next_input);
-        next_input = current_output;
+    last_output.assign(output, output + num_outputs_);
+    return last_output;
+}
+
+template<typename T>
+const T* NeuralNetwork<T>::ForwardsBatch(const T* inputs,
+                                         const int& batch_size) {
+    // Grow the buffers for a larger batch than any before. The gradients are
+    // always zero here, BackwardsBatch applies and resets them.
+    if (batch_size > workspace_.max_batch_size) {
+        workspace_ = CreateWorkspace(batch_size);
     }
+    // Keep a copy of the input, the first layer reads it again when
+    // propagating backwards
+    batch_input.assign(inputs, inputs + static_cast<size_t>(batch_size)
+                                        * num_inputs_);
 
-    return last_output = current_output;
+    return ForwardsBatch(batch_input.data(), batch_size, workspace_);
 }
 
-std::vector<double> Layer::Forwards(const std::vector<double>& inputs) {
-    if (num_inputs != inputs.size()) {
-        throw std::runtime_error("Input size mismatch in Layer::Forwards. "
-                    "Input size is " + std::to_string(inputs.size()) 
-                    + ", expected input size is " + std::to_string(num_inputs));
+template<typename T>
+const T* NeuralNetwork<T>::ForwardsBatch(const T* inputs,
+                                         const int& batch_size,
+                                         Workspace<T>& workspace) const {
+    if (batch_size <= 0) {
+        throw std::runtime_error("Invalid batch size in NeuralNetwork::Forwards"
+                    "Batch. Batch size is " + std::to_string(batch_size));
+    }
+    if (workspace.layers.size() != layers.size()) {
+        throw std::runtime_error("Workspace mismatch in NeuralNetwork::Forwards"
+                    "Batch. Workspace has " + std::to_string(
+                    workspace.layers.size()) + " layers, network has "
+                    + std::to_string(layers.size()));
     }
+    if (batch_size > workspace.max_batch_size) {
+        throw std::runtime_error("Batch size mismatch in NeuralNetwork::Forwar"
+                    "dsBatch. Batch size is " + std::to_string(batch_size)
+                    + ", workspace holds at most "
+                    + std::to_string(workspace.max_batch_size));
+    }
+
+    workspace.inputs = inputs;
+    workspace.batch_size = batch_size;
 
-    std::vector<double> output;
-    for (Neuron& neuron : neurons) {
-        output.push_back(neuron.Forwards(inputs));
+    const T* next_input = inputs;
+    for (size_t i = 0; i < layers.size(); i++) {
+        next_input = layers[i].ForwardsBatch(next_input, batch_size,
+                                             workspace.layers[i]);
     }
 
-    return output;
+    return next_input;
 }
 
-double Neuron::Forwards(const std::vector<double>& inputs) {
-    if (inputs.size() != weights.size()) {
-            throw std::runtime_error("Input size mismatch in Neuron::Forwards. "
-                        "Input size is " + std::to_string(inputs.size()) 
-                        + ", weight size is " + std::to_string(weights.size()));
+template<typename T>
+const T* Layer<T>::ForwardsBatch(const T* inputs, const int& batch_size,
+                                 LayerWorkspace<T>& workspace) const {
+    return View().ForwardsBatch(inputs, batch_size, workspace);
+}
+
+template<typename T>
+const T* LayerView<T>::ForwardsBatch(const T* inputs, const int& batch_size,
+                                     LayerWorkspace<T>& workspace) const {
+    METRICS_SCOPE(metrics::Counter::kLayerForwards,
+                  2ull * batch_size * num_inputs * num_neurons);
+    if (batch_size > workspace.max_batch_size) {
+        throw std::runtime_error("Batch size mismatch in LayerView::Forwards"
+                    "Batch. Batch size is " + std::to_string(batch_size)
+                    + ", workspace holds at most "
+                    + std::to_string(workspace.max_batch_size));
     }
+    ForwardsBatch(inputs, batch_size, workspace.outputs);
+
+    return workspace.outputs;
+}
 
-    latest_input = inputs;
+template<typename T>
+void LayerView<T>::ForwardsBatch(const T* inputs, const int& batch_size,
+                                 T* outputs) const {
+    const size_t num_outputs = static_cast<size_t>(batch_size) * num_neurons;
 
-    double result = bias;
-    for (int i = 0; i < inputs.size(); i++) {
-        result += inputs.at(i) * weights.at(i);
+    // Weighted sum of every neuron for every sample, starting from the bias
+    for (int sample = 0; sample < batch_size; sample++) {
+        std::copy(biases, biases + num_neurons,
+                  outputs + static_cast<size_t>(sample) * num_neurons);
+    }
+    if (batch_size == 1) {
+        kernels::Gemv(kernels::Transpose::kNo, num_neurons, num_inputs, T(1),
+                      weights, num_inputs, inputs, T(1), outputs);
+    }
+    else {
+        kernels::Gemm(kernels::Transpose::kNo, kernels::Transpose::kYes,
+                      batch_size, num_neurons, num_inputs, T(1), inputs,
+                      num_inputs, weights, num_inputs, T(1), outputs,
+                      num_neurons);
     }
 
-    latest_output = activation_.Forwards(result);
-
-    return latest_output;
+    activation.ForwardsBatch(outputs, outputs, num_outputs);
 }
 
 // =======================================
 // Backward Propagation Methods
 // =======================================
 
-void NeuralNetwork::Backwards(const std::vector<double>& target) {
+template<typename T>
+void NeuralNetwork<T>::Backwards(const std::vector<T>& target) {
     if (num_outputs_ != target.size()) {
         throw std::runtime_error("Input size mismatch in NeuralNetwork::Backwar"
                     "ds. Target size is " + std::to_string(target.size()) 
                     + ", expected target size is " + std::to_string(num_outputs_));
     }
+    if (workspace_.batch_size != 1) {
+        throw std::runtime_error("Batch size mismatch in NeuralNetwork::Backwar"
+                    "ds. Last forwards pass had a batch of "
+                    + std::to_string(workspace_.batch_size)
+                    + " samples, expected 1");
+    }
+
+    BackwardsBatch(target.data());
+}
+
+template<typename T>
+void NeuralNetwork<T>::BackwardsBatch(const T* targets) {
+    AccumulateGradients(targets, workspace_);
+    ApplyGradients(workspace_, workspace_.batch_size);
+}
+
+template<typename T>
+void NeuralNetwork<T>::AccumulateGradients(const T* targets,
+                                           Workspace<T>& workspace) const {
+    if (workspace.batch_size == 0) {
+        throw std::runtime_error("NeuralNetwork::AccumulateGradients called "
+                                 "before NeuralNetwork::ForwardsBatch");
+    }
 
-    std::vector<double> dCost_dOutput = Calculate_dCostdOutput(target);
-    std::vector<double> dCost_dInput;
+    {
+        METRICS_SCOPE(metrics::Counter::kLoss,
+                      3ull * workspace.batch_size * num_outputs_);
+        workspace.loss = BatchLoss(loss_, workspace.batch_size, num_outputs_,
+                                   workspace.layers.back().outputs, targets,
+                                   workspace.dCost_dOutput);
+    }
 
-    for (auto it = layers.rbegin(); it != layers.rend(); ++it) {
-        dCost_dInput = it->Backwards(dCost_dOutput);
-        dCost_dOutput = dCost_dInput;
+    const T* dCost_dOutput = workspace.dCost_dOutput;
+    for (int i = static_cast<int>(layers.size()) - 1; i >= 0; i--) {
+        const T* inputs = i > 0 ? workspace.layers[i - 1].outputs
+                                : workspace.inputs;
+        // The cost relative to the network input is not needed
+        dCost_dOutput = layers[i].BackwardsBatch(inputs, dCost_dOutput,
+                                                 workspace.batch_size,
+                                                 workspace.layers[i], i > 0);
     }
 }
 
-// TODO: instead of returning the whole vector, process a running sum
-//       of the mean error for each neuron on the previous layer
-std::vector<double> Layer::Backwards(const std::vector<double>& dCost_dOutput) {
-    if (neurons.size() != dCost_dOutput.size()) {
-                throw std::runtime_error("Input size mismatch in Layer::Backwar"
-            "ds. dCost_dOutput is " + std::to_string(dCost_dOutput.size()) 
-                + ", number of neurons is " + std::to_string(neurons.size()));
-        }
+template<typename T>
+const T* Layer<T>::BackwardsBatch(const T* inputs,
+                                  const T* dCost_dOutput,
+                                  const int& batch_size,
+                                  LayerWorkspace<T>& workspace,
+                                  const bool& compute_dCost_dInput) const {
+    return View().BackwardsBatch(inputs, dCost_dOutput, batch_size, workspace,
+                                 compute_dCost_dInput);
+}
+
+template<typename T>
+const T* LayerView<T>::BackwardsBatch(const T* inputs,
+                                      const T* dCost_dOutput,
+                                      const int& batch_size,
+                                      LayerWorkspace<T>& workspace,
+                                      const bool& compute_dCost_dInput) const {
+    // Weight gradients, plus the cost to the previous layer if computed
+    METRICS_SCOPE(metrics::Counter::kLayerBackwards,
+                  (compute_dCost_dInput ? 4ull : 2ull) * batch_size
+                  * num_inputs * num_neurons);
+    const size_t num_outputs = static_cast<size_t>(batch_size) * num_neurons;
+    const T* outputs = workspace.outputs;
+    T* delta = workspace.delta;
+
+    // Cost relative to each neuron's weighted sum: error * activation
+    // function derivative
+    activation.BackwardsBatch(outputs, dCost_dOutput, delta, num_outputs);
 
     // Each input to this layer has an impact on the final cost, influenced by
     // the weights to each neuron in this layer. As such, track the average
     // cost gradient relative to input, calculated as the mean of the cost
     // gradient relative to input over all this layer's neuron's weights.
-    std::vector<double> mean_dCost_dInput(num_inputs, 0.0);
-    
-    for (int neuron_idx = 0; neuron_idx < neurons.size(); neuron_idx++) {
-        auto dCost_dInput =
-                neurons.at(neuron_idx).Backwards(dCost_dOutput.at(neuron_idx));
-        for (int input_idx = 0; input_idx < dCost_dInput.size(); input_idx++) {
-            mean_dCost_dInput.at(input_idx) += dCost_dInput.at(input_idx)
-                                          / static_cast<double>(neurons.size());
+    const T mean = T(1) / static_cast<T>(num_neurons);
+    T* dCost_dInput = compute_dCost_dInput ? workspace.dCost_dInput : nullptr;
+
+    if (batch_size == 1) {
+        // Bias, weight and input gradients in one sweep over the weights
+        kernels::DenseBackward(num_neurons, num_inputs, delta, inputs, mean,
+                               weights, num_inputs,
+                               workspace.weight_gradients,
+                               workspace.bias_gradients,
+                               dCost_dInput);
+        return dCost_dInput;
+    }
+
+    // Bias gradient: error * activation function derivative
+    for (int sample = 0; sample < batch_size; sample++) {
+        const T* sample_delta = &delta[static_cast<size_t>(sample)
+                                       * num_neurons];
+        for (int neuron_idx = 0; neuron_idx < num_neurons; neuron_idx++) {
+            workspace.bias_gradients[neuron_idx] += sample_delta[neuron_idx];
+        }
+    }
+
+    // Weight gradient: error * activation function derivative * output of
+    // previous layer, summed over the batch
+    kernels::Gemm(kernels::Transpose::kYes, kernels::Transpose::kNo,
+                  num_neurons, num_inputs, batch_size, T(1), delta,
+                  num_neurons, inputs, num_inputs, T(1),
+                  workspace.weight_gradients, num_inputs);
+
+    // Cost to previous layer: error * activation function derivative * weight
+    if (compute_dCost_dInput) {
+        kernels::Gemm(kernels::Transpose::kNo, kernels::Transpose::kNo,
+                      batch_size, num_inputs, num_neurons, mean, delta,
+                      num_neurons, weights, num_inputs, T(0),
+                      dCost_dInput, num_inputs);
+    }
+
+    return dCost_dInput;
+}
+
+template<typename T>
+void NeuralNetwork<T>::SetOptimizer(const OptimizerConfig& optimizer) {
+    optimizer_ = optimizer;
+    optimizer_steps = 0;
+    for (Layer<T>& layer : layers) {
+        layer.ResetOptimizerState(optimizer.type);
+    }
+}
+
+template<typename T>
+void NeuralNetwork<T>::SetLoss(const LossType& loss) {
+    const ActivationType output_activation =
+                                layers.back().View().activation.type;
+    if (loss == LossType::kSoftmaxCrossEntropy
+        && output_activation != ActivationType::kIdentity) {
+        throw std::runtime_error("Loss softmax_cross_entropy needs an output "
+                    "layer with the identity activation, output layer has "
+                    "activation type " + std::to_string(
+                    static_cast<uint32_t>(output_activation)));
+    }
+    loss_ = loss;
+}
+
+template<typename T>
+void NeuralNetwork<T>::ApplyGradients(Workspace<T>& workspace,
+                                      const int& batch_size) {
+    optimizer_steps++;
+    for (size_t i = 0; i < layers.size(); i++) {
+        layers[i].ApplyGradients(workspace.layers.at(i), optimizer_,
+                                 optimizer_steps, batch_size);
+    }
+    workspace.ResetGradients();
+}
+
+template<typename T>
+void NeuralNetwork<T>::ApplyLayerGradients(const int& layer,
+                                           LayerWorkspace<T>& workspace,
+                                           const long& step,
+                                           const int& batch_size) {
+    Layer<T>& target = layers.at(layer);
+    target.ApplyGradients(workspace, optimizer_, step, batch_size);
+    std::fill(workspace.weight_gradients, workspace.weight_gradients
+              + static_cast<size_t>(target.NumNeurons()) * target.NumInputs(),
+              T(0));
+    std::fill(workspace.bias_gradients, workspace.bias_gradients
+              + target.NumNeurons(), T(0));
+}
+
+template<typename T>
+void Layer<T>::ResetOptimizerState(const OptimizerType& type) {
+    const size_t state_size = OptimizerStateSize(type);
+    weight_state.assign(state_size * weights.size(), T(0));
+    bias_state.assign(state_size * biases.size(), T(0));
+}
+
+/// @brief Applies one optimizer update to a buffer of parameters
+template<typename T>
+void UpdateParameters(const OptimizerConfig& optimizer, const long& step,
+                      const T& gradient_scale, const size_t& n,
+                      const T* gradients, T* state, T* params) {
+    const T learning_rate = static_cast<T>(optimizer.learning_rate);
+    switch (optimizer.type) {
+        case OptimizerType::kSgd:
+            kernels::Axpy(n, -learning_rate * gradient_scale, gradients,
+                          params);
+            return;
+        case OptimizerType::kMomentum:
+        case OptimizerType::kNesterov:
+            kernels::MomentumUpdate(n, learning_rate,
+                        static_cast<T>(optimizer.momentum),
+                        optimizer.type == OptimizerType::kNesterov,
+                        gradient_scale, gradients, state, params);
+            return;
+        case OptimizerType::kAdam: {
+            // Bias corrections for the moments starting at zero
+            const double t = static_cast<double>(step);
+            const T step_size = static_cast<T>(optimizer.learning_rate
+                                / (1.0 - std::pow(optimizer.beta1, t)));
+            const T second_moment_correction = static_cast<T>(
+                                1.0 / (1.0 - std::pow(optimizer.beta2, t)));
+            kernels::AdamUpdate(n, step_size,
+                        static_cast<T>(optimizer.beta1),
+                        static_cast<T>(optimizer.beta2),
+                        static_cast<T>(optimizer.epsilon),
+                        second_moment_correction, gradient_scale, gradients,
+                        state, state + n, params);
+            return;
         }
     }
+}
 
-    return mean_dCost_dInput;
+template<typename T>
+void Layer<T>::ApplyGradients(const LayerWorkspace<T>& workspace,
+                              const OptimizerConfig& optimizer,
+                              const long& step, const int& batch_size) {
+    if (weight_state.size() != OptimizerStateSize(optimizer.type)
+                               * weights.size()) {
+        ResetOptimizerState(optimizer.type);
+    }
+
+    // Step against the mean gradient over the batch
+    const T gradient_scale = T(1) / static_cast<T>(batch_size);
+    UpdateParameters(optimizer, step, gradient_scale, weights.size(),
+                     workspace.weight_gradients, weight_state.data(),
+                     weights.data());
+    UpdateParameters(optimizer, step, gradient_scale, biases.size(),
+                     workspace.bias_gradients, bias_state.data(),
+                     biases.data());
+    // Undo any update to pruned weights
+    if (!weight_mask.empty()) {
+        kernels::Multiply(weights.size(), weight_mask.data(), weights.data());
+    }
 }
 
-std::vector<double> Neuron::Backwards(const double& mean_dCost_dOutpuy) {
-    if (latest_input.size() != weights.size()) {
-            throw std::runtime_error("Input size mismatch in Neuron::Backwards."
-                        " Input size is " + std::to_string(latest_input.size()) 
-                        + ", weight size is " + std::to_string(weights.size()));
+template<typename T>
+void NeuralNetwork<T>::ApplyGradientsHogwild(Workspace<T>& workspace,
+                                             const int& batch_size) {
+    const T step = static_cast<T>(optimizer_.learning_rate / batch_size);
+    for (size_t i = 0; i < layers.size(); i++) {
+        layers[i].ApplyGradientsHogwild(workspace.layers.at(i), step);
     }
+}
 
-    double delta = mean_dCost_dOutpuy * activation_.Derivative(latest_output);
+template<typename T>
+void Layer<T>::ApplyGradientsHogwild(LayerWorkspace<T>& workspace,
+                                     const T& step) {
+    // Pruned weights get no update
+    if (!weight_mask.empty()) {
+        kernels::Multiply(weights.size(), weight_mask.data(),
+                          workspace.weight_gradients);
+    }
+    kernels::HogwildUpdate(weights.size(), -step, workspace.weight_gradients,
+                           weights.data());
+    kernels::HogwildUpdate(biases.size(), -step, workspace.bias_gradients,
+                           biases.data());
+}
 
-    // Bias change: -(learning rate * error * activation function derivative)
-    bias -= LEARNING_RATE * delta;
+// =======================================
+// Pruning Methods
+// =======================================
 
-    // Weight change: -(learning rate * error *
-    //           activation function derivative * output of previous layer)
-    for (int i = 0; i < weights.size(); i++) {
-        weights.at(i) -= LEARNING_RATE * latest_input.at(i) * delta;
+template<typename T>
+void NeuralNetwork<T>::Prune(const PruningConfig& config) {
+    if (config.sparsity < 0.0 || config.sparsity >= 1.0) {
+        throw std::runtime_error("Invalid sparsity in NeuralNetwork::Prune. "
+                    "Sparsity is " + std::to_string(config.sparsity)
+                    + ", expected at least 0 and less than 1");
     }
+    for (Layer<T>& layer : layers) {
+        const LayerView<T> view = layer.View();
+        const size_t count = static_cast<size_t>(view.num_neurons)
+                             * view.num_inputs;
+        const size_t num_pruned = static_cast<size_t>(config.sparsity
+                                                      * count);
+        T threshold = static_cast<T>(config.threshold);
+        if (num_pruned > 0) {
+            std::vector<T> magnitudes(count);
+            for (size_t i = 0; i < count; i++) {
+                magnitudes[i] = std::fabs(view.weights[i]);
+            }
+            std::nth_element(magnitudes.begin(),
+                             magnitudes.begin() + (num_pruned - 1),
+                             magnitudes.end());
+            // Just above the largest magnitude pruned
+            threshold = std::max(threshold, std::nextafter(
+                                magnitudes[num_pruned - 1],
+                                std::numeric_limits<T>::infinity()));
+        }
+        layer.Prune(threshold);
+    }
+}
 
-    // Cost to previous layer: -(learning rate * error *
-    //           activation function derivative * weight)
-    std::vector<double> dCost_dInput;
-    for (const double& weight : weights) {
-        dCost_dInput.push_back(weight * delta);
+template<typename T>
+void Layer<T>::Prune(const T& threshold) {
+    if (weight_mask.empty()) {
+        weight_mask.assign(weights.size(), T(1));
     }
-    
-    return dCost_dInput;
+    for (size_t i = 0; i < weights.size(); i++) {
+        if (std::fabs(weights[i]) < threshold) {
+            weight_mask[i] = T(0);
+        }
+    }
+    kernels::Multiply(weights.size(), weight_mask.data(), weights.data());
+}
+
+template<typename T>
+double Layer<T>::Density() const {
+    size_t nonzero = 0;
+    for (const T& weight : weights) {
+        nonzero += weight != T(0);
+    }
+    return static_cast<double>(nonzero) / weights.size();
 }
 
 // =======================================
 // Network Interface Methods
 // =======================================
 
-std::vector<double> NeuralNetwork::CalculateError(const std::vector<double>&
-                                                  target) {
+template<typename T>
+const std::vector<T>& NeuralNetwork<T>::CalculateError(const std::vector<T>&
+                                                       target) {
     if (last_output.size() != target.size()) {
         throw std::runtime_error("Input size mismatch in NeuralNetwork::Calcula"
             "teError. Target size is " + std::to_string(target.size()) 
             + ", last output size is " + std::to_string(last_output.size()));
     }
 
-    std::vector<double> error;
+    last_error.resize(last_output.size());
+    if (loss_ == LossType::kSoftmaxCrossEntropy) {
+        // -target * log(softmax(output)), shifted by the largest output
+        const T max = *std::max_element(last_output.begin(),
+                                        last_output.end());
+        double exp_sum = 0.0;
+        for (const T& output : last_output) {
+            exp_sum += std::exp(output - max);
+        }
+        const double log_sum = std::log(exp_sum);
+        for (int i = 0; i < last_output.size(); i++) {
+            last_error[i] = -target.at(i) * (last_output.at(i) - max
+                                             - log_sum);
+        }
+        return last_error;
+    }
     for (int i = 0; i < last_output.size(); i++) {
         // Mean squared error
-        error.push_back(pow(last_output.at(i) - target.at(i), 2));
+        last_error[i] = pow(last_output.at(i) - target.at(i), 2);
     }
 
-    return error;
+    return last_error;
 }
 
-std::vector<double> NeuralNetwork::Calculate_dCostdOutput(const std::vector
-                                                          <double>& target) {
+template<typename T>
+const std::vector<T>& NeuralNetwork<T>::Calculate_dCostdOutput(
+                                            const std::vector<T>& target) {
     if (last_output.size() != target.size()) {
         throw std::runtime_error("Input size mismatch in NeuralNetwork::Calcula"
             "te_dCostdOutput. Target size is " + std::to_string(target.size()) 
             + ", last output size is " + std::to_string(last_output.size()));
     }
 
-    std::vector<double> dCost_dOutput;
-    for (int i = 0; i < last_output.size(); i++) {
-        // Mean squared error derivative
-        dCost_dOutput.push_back(2 * (last_output.at(i) - target.at(i)));
+    last_dCost_dOutput.resize(last_output.size());
+    BatchLoss(loss_, 1, num_outputs_, last_output.data(), target.data(),
+              last_dCost_dOutput.data());
+
+    return last_dCost_dOutput;
+}
+
+template<typename T>
+double NeuralNetwork<T>::CalculateBatchError(const T* targets) const {
+    return CalculateBatchError(targets, workspace_);
+}
+
+template<typename T>
+double NeuralNetwork<T>::CalculateBatchError(const T* targets,
+                                             const Workspace<T>& workspace)
+                                             const {
+    if (workspace.batch_size == 0) {
+        throw std::runtime_error("NeuralNetwork::CalculateBatchError called "
+                                 "before NeuralNetwork::ForwardsBatch");
+    }
+    METRICS_SCOPE(metrics::Counter::kLoss,
+                  3ull * workspace.batch_size * num_outputs_);
+
+    return BatchLoss(loss_, workspace.batch_size, num_outputs_,
+                     workspace.layers.back().outputs, targets,
+                     static_cast<T*>(nullptr));
+}
+
+// =======================================
+// Persistence Methods
+// =======================================
+
+template<typename T>
+void NeuralNetwork<T>::Save(const std::string& path) const {
+    std::vector<LayerView<T>> views;
+    for (const Layer<T>& layer : layers) {
+        views.push_back(layer.View());
     }
+    SaveModelFile(path, views);
+}
 
-    return dCost_dOutput;
+template<typename T>
+void NeuralNetwork<T>::LoadWeights(const std::vector<LayerView<T>>& views) {
+    if (views.size() != layers.size()) {
+        throw std::runtime_error("Cannot load weights of "
+                    + std::to_string(views.size()) + " layers into a network "
+                    + "of " + std::to_string(layers.size()) + " layers");
+    }
+    for (size_t i = 0; i < layers.size(); i++) {
+        layers[i].LoadWeights(views[i]);
+    }
 }
 
 // =======================================
 // Utility and Debug Methods
 // =======================================
 
-void NeuralNetwork::PrintNetwork() const {
+template<typename T>
+void NeuralNetwork<T>::PrintNetwork() const {
     printf("Neural Network Printout\n");
     printf("Number of Inputs: %d\n", num_inputs_);
     for (int i = 0; i < layers.size(); i++) {
         printf("Layer %d: ", i);
-        layers.at(i).PrintLayer();
+        layers.at(i).PrintLayer(workspace_.layers.at(i));
         printf("\n");
     }
     printf("Number of Outputs: %d\n", num_outputs_);
 }
 
-void Layer::PrintLayer() const {
-    for (int i = 0; i < neurons.size(); i++) {
+template<typename T>
+void Layer<T>::PrintLayer(const LayerWorkspace<T>& workspace) const {
+    for (int i = 0; i < num_neurons; i++) {
         printf("Neuron %d: ", i);
-        neurons.at(i).PrintNeuron();
+        GetNeuron(i, workspace).PrintNeuron();
         printf("\t");
     }
 }
 
-const void Neuron::PrintNeuron() const {
-    printf("(o = %.2f; b = %.2f", latest_output, bias);
-    for (int i = 0; i < weights.size(); i++) {
-        printf("; w_%d = %.2f", i, weights.at(i));
+template<typename T>
+const void Neuron<T>::PrintNeuron() const {
+    printf("(o = %.2f; b = %.2f", *latest_output, *bias);
+    for (int i = 0; i < num_inputs; i++) {
+        printf("; w_%d = %.2f", i, weights[i]);
     }
     printf(")");
-}
\ No newline at end of file
+}
+
+template struct LayerView<float>;
+template struct LayerView<double>;
+template class Neuron<float>;
+template class Neuron<double>;
+template struct Workspace<float>;
+template struct Workspace<double>;
+template class Layer<float>;
+template class Layer<double>;
+template class NeuralNetwork<float>;
+template class NeuralNetwork<double>;
\ No newline at end of file
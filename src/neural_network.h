@@ -1,105 +1,329 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
 #include <vector>
 #include <algorithm>
-#include <random>
 
 #include "activation_functions.h"
+#include "aligned_allocator.h"
+#include "loss.h"
+#include "optimizer.h"
+#include "pruning.h"
 
-/// @brief A single neuron in the neural network. Composes the Layer class.
-///        Contains bias, weights, and the activation function and activation
-///        function derivative.
+/// @brief A single neuron in the neural network. A lightweight view onto one
+///        row of its Layer's weight matrix, its entry in the Layer's bias
+///        vector, and its last output. Neurons do not own any storage and are
+///        created on demand by Layer::GetNeuron.
+template<typename T>
 class Neuron {
 private:
-    // Bias and weights, updated by the Backwards method
-    double bias = 0.0;
-    std::vector<double> weights;
-    // Activtion function
-    ActivationFunction activation_;
+    // Row of the owning layer's weight matrix and this neuron's bias
+    T* weights = nullptr;
+    T* bias = nullptr;
+    int num_inputs = 0;
 
-    // Store last input and output, required for back propagation
-    std::vector<double> latest_input;
-    double latest_output = 0.0;
+    // This neuron's output for the first sample of the last batch
+    const T* latest_output = nullptr;
 
 public:
     /// @brief Constructor
-    /// @param num_input_nodes number of neurons that input to this neuron
-    /// @param ActivationFunction for forward pass
-    /// @param ActivationFunctionDerivative for back propagation
-    Neuron(const int& num_input_nodes, ActivationFunction activation);
-
-    /// @brief Forward pass using the activation function provided during
-    ///        initialisation
-    /// @param inputs inputs to this neuron
-    /// @return activated output
-    double Forwards(const std::vector<double>& inputs);
-
-    /// @brief Backwards pass and back propagation. Will update the weights and
-    ///        bias. Assumes forward pass has run.
-    /// @param mean_dCost_dOutpuy the partial derivative of the cost to the
-    ///                           network relative to the last output of this
-    ///                           neuron
-    /// @return vector of network costs relative to the output of each neuron
-    ///         in the previous layer connected to this neuron
-    std::vector<double> Backwards(const double& mean_dCost_dOutpuy);
+    /// @param weights row of num_inputs weights owned by the layer
+    /// @param bias bias owned by the layer
+    /// @param num_inputs number of neurons that input to this neuron
+    /// @param latest_output this neuron's last output
+    Neuron(T* weights, T* bias, const int& num_inputs,
+           const T* latest_output);
 
     /// @brief Print a summary of this neuron to the console
     /// @return void
     const void PrintNeuron() const;
 };
 
-/// @brief A single layer in the neural network. Composed of Neurons and 
-///        composes the Neural Network class.
+/// @brief Buffers for one batch of samples passing through one Layer: the
+///        activations and cost gradients of every sample, and the weight and
+///        bias gradients summed over the batch. Points into the arena of the
+///        Workspace that owns it.
+template<typename T>
+struct LayerWorkspace {
+    // Activated output, max_batch_size x num_neurons
+    T* outputs = nullptr;
+    // Cost relative to the weighted sum of each neuron, max_batch_size x
+    // num_neurons
+    T* delta = nullptr;
+    // Cost relative to each input, max_batch_size x num_inputs
+    T* dCost_dInput = nullptr;
+    // Gradients of the cost relative to each weight and bias, summed over
+    // every sample since the gradients were last reset
+    T* weight_gradients = nullptr;
+    T* bias_gradients = nullptr;
+    // Largest number of samples per batch the buffers hold
+    int max_batch_size = 0;
+};
+
+/// @brief Buffers for one batch of samples passing forwards and backwards
+///        through a NeuralNetwork. Layers only hold weights and biases, so any
+///        number of threads can train the same network at once as long as
+///        each has its own Workspace. Created by
+///        NeuralNetwork::CreateWorkspace, which sizes every buffer from the
+///        topology and the largest batch and carves it out of a single
+///        arena, so passing batches through the network never allocates.
+template<typename T>
+struct Workspace {
+    // Every buffer below, each starting on a cache line. The weight and bias
+    // gradients of every layer come first, as one contiguous block.
+    AlignedVector<T> arena;
+    // Number of values in the gradient block at the start of the arena,
+    // including padding, which is always zero
+    size_t num_gradients = 0;
+    // One entry per layer, in layer order
+    std::vector<LayerWorkspace<T>> layers;
+    // Input of the last batch, batch_size x num_inputs. Not owned.
+    const T* inputs = nullptr;
+    // Cost relative to each network output, max_batch_size x num_outputs
+    T* dCost_dOutput = nullptr;
+    // Number of samples in the last batch
+    int batch_size = 0;
+    // Largest number of samples per batch the buffers hold
+    int max_batch_size = 0;
+    // Mean loss of the last batch, computed by AccumulateGradients along
+    // with dCost_dOutput
+    double loss = 0.0;
+
+    Workspace() = default;
+
+    // The layer buffers point into this object's arena
+    Workspace(const Workspace&) = delete;
+    Workspace& operator=(const Workspace&) = delete;
+    Workspace(Workspace&&) = default;
+    Workspace& operator=(Workspace&&) = default;
+
+    /// @brief Adds the accumulated weight and bias gradients of another
+    ///        workspace of the same network to this one
+    /// @param other workspace to add
+    void AddGradients(const Workspace<T>& other);
+
+    /// @brief Resets the accumulated weight and bias gradients to zero
+    void ResetGradients();
+};
+
+/// @brief Read-only view of the weights, biases and activation function of one
+///        layer. Does not own its storage, which may belong to a Layer, a
+///        CompiledNetwork or a memory mapped model file.
+template<typename T>
+struct LayerView {
+    // Weight matrix of num_neurons rows by num_inputs columns
+    const T* weights = nullptr;
+    // One bias per neuron
+    const T* biases = nullptr;
+    int num_inputs = 0;
+    int num_neurons = 0;
+    ActivationFunction<T> activation = Sigmoid<T>;
+
+    /// @brief Forwards pass over a batch of samples into a caller owned
+    ///        buffer. Does not allocate.
+    /// @param inputs batch_size x num_inputs row-major block
+    /// @param batch_size number of samples in the batch
+    /// @param outputs batch_size x num_neurons block receiving the outputs
+    void ForwardsBatch(const T* inputs, const int& batch_size,
+                       T* outputs) const;
+
+    /// @brief Forwards pass over a batch of samples into a layer workspace,
+    ///        see Layer::ForwardsBatch
+    /// @param inputs batch_size x num_inputs row-major block
+    /// @param batch_size number of samples in the batch, at most the
+    ///                   workspace's max_batch_size
+    /// @param workspace buffers receiving the outputs
+    /// @return batch_size x num_neurons block of outputs
+    const T* ForwardsBatch(const T* inputs, const int& batch_size,
+                           LayerWorkspace<T>& workspace) const;
+
+    /// @brief Backwards pass over the last batch with these weights, see
+    ///        Layer::BackwardsBatch
+    /// @param inputs batch_size x num_inputs block passed to ForwardsBatch
+    /// @param dCost_dOutput batch_size x num_neurons block of the cost
+    ///                      relative to each output
+    /// @param batch_size number of samples in the batch
+    /// @param workspace buffers of the forwards pass, receiving the gradients
+    /// @param compute_dCost_dInput whether to propagate the cost to the
+    ///                             previous layer
+    /// @return batch_size x num_inputs block of the cost relative to each
+    ///         input, or nullptr if not computed
+    const T* BackwardsBatch(const T* inputs, const T* dCost_dOutput,
+                            const int& batch_size,
+                            LayerWorkspace<T>& workspace,
+                            const bool& compute_dCost_dInput) const;
+};
+
+/// @brief A single layer in the neural network. Owns the weights and biases of
+///        its Neurons as a contiguous, row-major weight matrix and bias vector.
+///        Per batch buffers live in a LayerWorkspace, so the forwards and
+///        backwards passes do not modify the layer. Composes the Neural
+///        Network class.
+template<typename T>
 class Layer {
 private:
-    // Neurons in this layer. Index order is important, must be retained
-    // throughout operation
-    std::vector<Neuron> neurons;
     // Number of neurons in the previous layer. Number of inputs if this is the
     // first layer.
     int num_inputs = 0;
+    // Number of neurons in this layer
+    int num_neurons = 0;
+    // Activation function applied by every neuron in this layer
+    ActivationFunction<T> activation_;
+
+    // Weight matrix of num_neurons rows by num_inputs columns. Row order is
+    // the neuron order and must be retained throughout operation.
+    AlignedVector<T> weights;
+    // One bias per neuron
+    AlignedVector<T> biases;
+    // Optimizer state, OptimizerStateSize values per parameter. Each value is
+    // stored as a block laid out like the weights or biases, e.g. Adam's
+    // first moments of every weight followed by their second moments.
+    AlignedVector<T> weight_state;
+    AlignedVector<T> bias_state;
+    // Zero for each pruned weight and one for the rest, laid out like the
+    // weights. Empty until the layer is pruned.
+    AlignedVector<T> weight_mask;
     
 public:
-    /// @brief Constructor
+    /// @brief Constructor. Weights and biases start uniform in [-1, 1), each
+    ///        drawn from its own counter of the seed's weight init streams for
+    ///        this layer, so they depend only on the seed, the layer index and
+    ///        their position.
     /// @param num_input_nodes number of neurons in the previous layer or number
     ///                        of inputs if this is the first layer
     /// @param num_neurons number of neurons in this layer
-    /// @param ActivationFunction for each neuron used in forward pass
-    /// @param ActivationFunctionDerivative for each neuron used in back
-    ///                                     propagation
+    /// @param ActivationFunction for each neuron used in forward pass and back
+    ///                          propagation
+    /// @param seed seed of the initial weights and biases
+    /// @param layer_index position of this layer in its network
     Layer(const int& num_input_nodes, const int& num_neurons,
-          ActivationFunction activation);
+          ActivationFunction<T> activation, const uint64_t& seed = 0,
+          const int& layer_index = 0);
 
-    /// @brief Forwards pass
-    /// @param inputs to this layer
-    /// @return inputs to the next layer
-    std::vector<double> Forwards(const std::vector<double>& inputs);
-
-    /// @brief Backwards pass and back propagation. Will update weights and bias
-    ///        of each neuron in this layer. Assumes forward pass has run.
-    /// @param dCost_dOutput the partial derivative of the cost to the
-    ///                      network relative to the last output of each neuron
-    ///                      in this layer
-    /// @return vector of network costs relative to the output of each neuron
-    ///         in the previous layer
-    std::vector<double> Backwards(
-                        const std::vector<double>& dCost_dOutput);
+    /// @brief Returns a view of a single neuron in this layer
+    /// @param neuron_idx index of the neuron
+    /// @param workspace buffers holding the neuron's last output
+    /// @return view onto the neuron's weights, bias and output
+    const Neuron<T> GetNeuron(const int& neuron_idx,
+                              const LayerWorkspace<T>& workspace) const;
+
+    /// @brief Forwards pass over a batch of samples
+    /// @param inputs batch_size x num_inputs row-major block
+    /// @param batch_size number of samples in the batch, at most the
+    ///                   workspace's max_batch_size
+    /// @param workspace buffers receiving the outputs
+    /// @return batch_size x num_neurons block of outputs, the inputs to the
+    ///         next layer
+    const T* ForwardsBatch(const T* inputs, const int& batch_size,
+                                LayerWorkspace<T>& workspace) const;
+
+    /// @brief Backwards pass over the last batch. Adds the gradient of every
+    ///        sample to the weight and bias gradients in the workspace, but
+    ///        does not update the weights. Assumes ForwardsBatch has run with
+    ///        the same inputs and workspace.
+    /// @param inputs batch_size x num_inputs block passed to ForwardsBatch
+    /// @param dCost_dOutput batch_size x num_neurons block of the partial
+    ///                      derivative of the cost to the network relative to
+    ///                      the last output of each neuron in this layer
+    /// @param batch_size number of samples in the batch
+    /// @param workspace buffers of the forwards pass, receiving the gradients
+    /// @param compute_dCost_dInput whether to propagate the cost to the
+    ///                             previous layer. Not needed by the first
+    ///                             layer.
+    /// @return batch_size x num_inputs block of network costs relative to the
+    ///         output of each neuron in the previous layer, or nullptr if not
+    ///         computed
+    const T* BackwardsBatch(const T* inputs,
+                                 const T* dCost_dOutput,
+                                 const int& batch_size,
+                                 LayerWorkspace<T>& workspace,
+                                 const bool& compute_dCost_dInput) const;
+
+    /// @brief Updates the weights and biases with the mean of the accumulated
+    ///        gradients, in a single fused pass per buffer
+    /// @param workspace buffers holding the accumulated gradients
+    /// @param optimizer update rule and its hyperparameters, matching the
+    ///                  last call to ResetOptimizerState
+    /// @param step number of updates so far including this one, from 1
+    /// @param batch_size number of samples the gradients were accumulated over
+    void ApplyGradients(const LayerWorkspace<T>& workspace,
+                        const OptimizerConfig& optimizer, const long& step,
+                        const int& batch_size);
+
+    /// @brief Applies the accumulated gradients straight to the weights and
+    ///        biases with a lock-free SGD step, then resets them, see
+    ///        NeuralNetwork::ApplyGradientsHogwild
+    /// @param workspace buffers holding the accumulated gradients
+    /// @param step learning rate over the number of samples the gradients
+    ///             were accumulated over
+    void ApplyGradientsHogwild(LayerWorkspace<T>& workspace, const T& step);
+
+    /// @brief Sizes the optimizer state for an optimizer type and sets it to
+    ///        zero
+    /// @param type optimizer the state is for
+    void ResetOptimizerState(const OptimizerType& type);
+
+    /// @brief Zeroes every weight with a magnitude below threshold. Pruned
+    ///        weights are held at zero by later calls to ApplyGradients,
+    ///        until LoadWeights replaces them.
+    /// @param threshold smallest magnitude kept
+    void Prune(const T& threshold);
+
+    /// @brief Fraction of this layer's weights that are nonzero
+    double Density() const;
+
+    /// @brief Number of neurons in the previous layer
+    int NumInputs() const { return num_inputs; }
+
+    /// @brief Number of neurons in this layer
+    int NumNeurons() const { return num_neurons; }
+
+    /// @brief Read-only view of this layer's weights, biases and activation
+    ///        function. Valid while the layer is alive and not resized.
+    LayerView<T> View() const;
+
+    /// @brief Copies the weights and biases of another layer of the same shape
+    ///        and activation function into this one, clearing any pruning.
+    ///        Throws runtime_error if they differ.
+    /// @param view layer to copy from
+    void LoadWeights(const LayerView<T>& view);
                         
     /// @brief Print a summary of this layer to the console
+    /// @param workspace buffers holding the last output of each neuron
     /// @return void
-    void PrintLayer() const;
+    void PrintLayer(const LayerWorkspace<T>& workspace) const;
 };
 
 /// @brief a fully connected Neural Network composed of Layers, which is
 ///        composed of Neurons.
+template<typename T>
 class NeuralNetwork {
 private:
     // Layers in the network. Index order represents the layer order.
-    std::vector<Layer> layers;
-    // Last output generated by this network
-    std::vector<double> last_output;
+    std::vector<Layer<T>> layers;
+    // Last output generated by this network, and the error and cost
+    // derivative last calculated from it
+    std::vector<T> last_output;
+    std::vector<T> last_error;
+    std::vector<T> last_dCost_dOutput;
     // Number of inputs to this network
     int num_inputs_ = 0;
     // Number of outputs to this network
     int num_outputs_ = 0;
+
+    // Rule used to apply gradients, and the number of updates applied with it
+    OptimizerConfig optimizer_;
+    long optimizer_steps = 0;
+    // Cost minimised by training
+    LossType loss_ = LossType::kMeanSquaredError;
+
+    // Buffers used by the single threaded training methods, recreated when a
+    // larger batch is passed
+    Workspace<T> workspace_;
+    // Copy of the last batch input to the single threaded training methods,
+    // max_batch_size x num_inputs
+    AlignedVector<T> batch_input;
     
 public:
     /// @brief Constructor
@@ -108,33 +332,185 @@ public:
     ///                    in the final layer
     /// @param neurons_per_layer vector representing the number of neurons to
     ///                          create in each hidden layer
+    /// @param seed seed of the initial weights and biases. Networks of the
+    ///             same topology and seed start identical.
     NeuralNetwork(const int& num_inputs, const int& num_outputs, 
                   const std::vector<int>& neurons_per_layer,
-                  ActivationFunction hidden_layer_activation = Sigmoid,
-                  ActivationFunction output_layer_activation = Sigmoid);
+                  ActivationFunction<T> hidden_layer_activation = Sigmoid<T>,
+                  ActivationFunction<T> output_layer_activation = Sigmoid<T>,
+                  const uint64_t& seed = 0);
 
     /// @brief Forwards pass
     /// @param input inputs to the network
-    /// @return output of the network
-    std::vector<double> Forwards(const std::vector<double>& input);
+    /// @return output of the network. Valid until the next forwards pass.
+    const std::vector<T>& Forwards(const std::vector<T>& input);
 
     /// @brief Backwards pass and back propagation, will update weights and bias
     ///        of each neuron in the network. Assumes forward pass has run.
     /// @param target target results to train against
-    void Backwards(const std::vector<double>& target);
+    void Backwards(const std::vector<T>& target);
+
+    /// @brief Forwards pass over a batch of samples
+    /// @param inputs batch_size x num_inputs row-major block of samples
+    /// @param batch_size number of samples in the batch
+    /// @return batch_size x num_outputs block of network outputs. Valid until
+    ///         the next forwards pass.
+    const T* ForwardsBatch(const T* inputs, const int& batch_size);
+
+    /// @brief Backwards pass and back propagation over the last batch. The
+    ///        gradients of every sample are accumulated and the weights and
+    ///        bias of each neuron are updated once with their mean. Assumes
+    ///        ForwardsBatch has run.
+    /// @param targets batch_size x num_outputs block of target results
+    void BackwardsBatch(const T* targets);
+
+    /// @brief Creates a set of buffers for passing batches through this
+    ///        network, e.g. one per training thread. This is the only
+    ///        allocation made by the batch training methods.
+    /// @param batch_size largest number of samples per batch
+    /// @return workspace with every buffer allocated and gradients at zero
+    Workspace<T> CreateWorkspace(const int& batch_size = 1) const;
+
+    /// @brief Forwards pass over a batch of samples using external buffers.
+    ///        Does not modify the network, safe to call from several threads
+    ///        at once with different workspaces.
+    /// @param inputs batch_size x num_inputs row-major block of samples. Must
+    ///               remain valid until AccumulateGradients has run.
+    /// @param batch_size number of samples in the batch. Throws runtime_error
+    ///                   if larger than the workspace's max_batch_size.
+    /// @param workspace buffers receiving the activations
+    /// @return batch_size x num_outputs block of network outputs, owned by the
+    ///         workspace
+    const T* ForwardsBatch(const T* inputs, const int& batch_size,
+                                Workspace<T>& workspace) const;
+
+    /// @brief Backwards pass over the last batch in a workspace. Adds the
+    ///        gradients of every sample to those accumulated in the workspace,
+    ///        but does not update the weights. The mean loss of the batch is
+    ///        computed in the same pass as its gradient and stored in
+    ///        workspace.loss. Does not modify the network, safe to call from
+    ///        several threads at once with different workspaces.
+    /// @param targets batch_size x num_outputs block of target results
+    /// @param workspace buffers of the forwards pass
+    void AccumulateGradients(const T* targets, Workspace<T>& workspace) const;
+
+    /// @brief Sets the optimizer used to apply gradients, resetting its state.
+    ///        Defaults to OptimizerConfig().
+    /// @param optimizer update rule and its hyperparameters
+    void SetOptimizer(const OptimizerConfig& optimizer);
+
+    /// @brief Optimizer used to apply gradients
+    const OptimizerConfig& Optimizer() const { return optimizer_; }
 
-    /// @brief Calculates mean squared error of the last output compared to the
-    ///        target result.
+    /// @brief Sets the cost minimised by training and reported by the error
+    ///        methods. Defaults to LossType::kMeanSquaredError. Throws
+    ///        runtime_error for kSoftmaxCrossEntropy unless the output layer
+    ///        uses the identity activation.
+    /// @param loss loss type
+    void SetLoss(const LossType& loss);
+
+    /// @brief Cost minimised by training
+    const LossType& Loss() const { return loss_; }
+
+    /// @brief Magnitude pruning. Zeroes the weights of each layer with a
+    ///        magnitude below config.threshold, along with the config.sparsity
+    ///        fraction of its weights with the smallest magnitudes. Pruned
+    ///        weights stay at zero through later training, so the rest can be
+    ///        fine-tuned around them. Throws runtime_error if config.sparsity
+    ///        is not in [0, 1).
+    /// @param config pruning thresholds
+    void Prune(const PruningConfig& config);
+
+    /// @brief Updates the weights and bias of each neuron with the mean of the
+    ///        gradients accumulated in a workspace, using the optimizer set
+    ///        by SetOptimizer, then resets them
+    /// @param workspace buffers holding the accumulated gradients
+    /// @param batch_size number of samples the gradients were accumulated over
+    void ApplyGradients(Workspace<T>& workspace, const int& batch_size);
+
+    /// @brief Updates the weights and biases of a single layer with the mean
+    ///        of its gradients accumulated in a layer workspace, using the
+    ///        optimizer set by SetOptimizer, then resets them. For trainers
+    ///        where each thread owns some of the layers, e.g. PipelineTrainer,
+    ///        so only touches this layer and counts no update: the caller
+    ///        numbers its own updates. Safe to call from several threads at
+    ///        once for different layers.
+    /// @param layer index of the layer
+    /// @param workspace buffers holding the layer's accumulated gradients
+    /// @param step number of updates to this layer so far including this one,
+    ///             from 1
+    /// @param batch_size number of samples the gradients were accumulated over
+    void ApplyLayerGradients(const int& layer, LayerWorkspace<T>& workspace,
+                             const long& step, const int& batch_size);
+
+    /// @brief Lock-free asynchronous update for Hogwild training. Applies a
+    ///        plain SGD step with the mean of the gradients accumulated in a
+    ///        workspace, at the optimizer's learning rate, straight to the
+    ///        shared weights and biases, then resets the gradients. Only
+    ///        nonzero gradients are applied, each with a relaxed atomic read
+    ///        and write. Safe to call from several threads at once with
+    ///        different workspaces, while other threads run ForwardsBatch and
+    ///        AccumulateGradients: updates may overwrite one another, and a
+    ///        pass may see a mix of old and new weights. The optimizer type
+    ///        and state are not used. Pruned weights stay at zero.
+    /// @param workspace buffers holding the accumulated gradients
+    /// @param batch_size number of samples the gradients were accumulated over
+    void ApplyGradientsHogwild(Workspace<T>& workspace, const int& batch_size);
+
+    /// @brief Calculates the loss of each output of the last output compared
+    ///        to the target result: its squared error, or its term of the
+    ///        cross entropy for LossType::kSoftmaxCrossEntropy
     /// @param target desired result
-    /// @return mean squared error of each output
-    std::vector<double> CalculateError(const std::vector<double>& target);
+    /// @return loss of each output. Valid until the next call.
+    const std::vector<T>& CalculateError(const std::vector<T>& target);
 
     /// @brief Calculates the derivative of network cost relative to each
     ///        output from the network
     /// @param target desired result to train against
-    /// @return the derivative of network cost relative to each output
-    std::vector<double> Calculate_dCostdOutput(
-                                            const std::vector<double>& target);
+    /// @return the derivative of network cost relative to each output. Valid
+    ///         until the next call.
+    const std::vector<T>& Calculate_dCostdOutput(
+                                            const std::vector<T>& target);
+
+    /// @brief Calculates the loss of the last batch output compared to the
+    ///        target results, see BatchLoss
+    /// @param targets batch_size x num_outputs block of desired results
+    /// @return mean squared error of each output, or mean cross entropy of
+    ///         each sample
+    double CalculateBatchError(const T* targets) const;
+
+    /// @brief Calculates the loss of the last batch output in a workspace
+    ///        compared to the target results, see BatchLoss. After
+    ///        AccumulateGradients, workspace.loss already holds it.
+    /// @param targets batch_size x num_outputs block of desired results
+    /// @param workspace buffers of the forwards pass
+    /// @return mean squared error of each output, or mean cross entropy of
+    ///         each sample
+    double CalculateBatchError(const T* targets,
+                               const Workspace<T>& workspace) const;
+
+    /// @brief Number of inputs to this network
+    int NumInputs() const { return num_inputs_; }
+
+    /// @brief Number of outputs of this network
+    int NumOutputs() const { return num_outputs_; }
+
+    /// @brief Layers of this network in order, e.g. for building a
+    ///        CompiledNetwork
+    const std::vector<Layer<T>>& Layers() const { return layers; }
+
+    /// @brief Copies the weights and biases of a network of the same topology,
+    ///        e.g. a CompiledNetwork or StaticNetwork, into this one. Throws
+    ///        runtime_error if the number of layers, their shapes or their
+    ///        activation functions differ.
+    /// @param views layers to copy from, in order
+    void LoadWeights(const std::vector<LayerView<T>>& views);
+
+    /// @brief Saves the topology, activation functions, weights and biases
+    ///        of this network to a binary model file, see model_file.h.
+    ///        Throws runtime_error if the file cannot be written.
+    /// @param path file to write
+    void Save(const std::string& path) const;
 
     /// @brief Print a summary of this network to the console
     /// @return void
@@ -1,16 +1,41 @@
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+
 #include "neural_network.h"
 #include "load_data.h"
+#include "quantized.h"
+#include "evaluation.h"
+#include "trainer.h"
 #include "neural_network_demo.h"
+#include "data_parallel.h"
+#include "hogwild.h"
+#include "pipeline.h"
+#include "inference.h"
+#include "sparse_network.h"
+#include "batch_pipeline.h"
+#include "counter_rng.h"
+#include "thread_pool.h"
+#include "metrics.h"
 
-void SimpleExample(const int& epochs, const std::vector<int>& hidden_layers) {
-    NeuralNetwork nn(2, 1, hidden_layers);
+void SimpleExample(const int& epochs, const std::vector<int>& hidden_layers,
+                   const uint64_t& seed) {
+    NeuralNetwork<double> nn(2, 1, hidden_layers, Sigmoid<double>,
+                             Sigmoid<double>, seed);
 
     // Sample input and target output
     std::vector<double> input = {0.5, -0.3};
     std::vector<double> target = {0.7};
 
     for (int epoch = 0; epoch <= epochs; ++epoch) {
-        auto output = nn.Forwards(input);
+        const auto& output = nn.Forwards(input);
         nn.Backwards(target);
         if ((epoch) % 100 == 0) {
             double loss = nn.CalculateError(target).at(0);
@@ -19,95 +44,743 @@ void SimpleExample(const int& epochs, const std::vector<int>& hidden_layers) {
     }
 }
 
-void MnistExample(const int& epochs, const int& batch_size,
-                 const int& test_count, const std::vector<int>& hidden_layers) {
-    printf("Loading data...\n");
-    std::vector<std::vector<double>> images_train;
-    std::vector<int> labels_train;
-    std::vector<std::vector<double>> images_test;
-    std::vector<int> labels_test;
-    bool loaded = LoadData(images_train, labels_train,
-                            images_test, labels_test);
-    if (!loaded)
-    {
-        printf("Failed to load data.\n");
+template<typename T>
+void PrintMnistPredictions(const CompiledNetwork<T>& network,
+                           const MnistDataset& test, const int& test_count,
+                           const uint64_t& seed) {
+    InferenceSession<T> session(network);
+    CounterRng generator(seed, RandomStream(RandomDomain::kSamplePicks, 0));
+    std::uniform_int_distribution<int> pick(0, test.Size() - 1);
+    std::vector<T> image(test.ImageSize());
+    std::vector<T> output(MnistDataset::kNumClasses);
+
+    // Print a selection of random images to demonstrate learning
+    for (int i = 0; i < test_count; i++) {
+        int index = pick(generator);
+        test.NormaliseImage(index, image.data());
+        int label = test.Label(index);
+
+        session.Predict(image.data(), output.data());
+
+        int prediction = 0;
+        for (int j = 0; j < output.size(); j++)
+        {
+            if (output[j] > output[prediction])
+            {
+                prediction = j;
+            }
+        }
+
+        PrintAsciiImage(image);
+        printf("Label is: %d, Predicted: %d\n", label, prediction);
     }
-    printf("Loaded %d training samples and %d testing samples\n",
-            labels_train.size(), labels_test.size());
+}
 
-    NeuralNetwork network = NeuralNetwork(28 * 28, 10, hidden_layers);
+/// @brief Index of the largest of a set of outputs
+template<typename T>
+int Prediction(const T* output, const int& count) {
+    return static_cast<int>(std::max_element(output, output + count)
+                            - output);
+}
 
-    const int kEpoch = epochs;
-    const int kBatchSize = batch_size;
+/// @brief Quantizes a network to int8, calibrated on the start of the
+///        training set, and compares its accuracy and single threaded
+///        throughput with the original over the whole test set
+template<typename T>
+void EvaluateQuantizedMnist(const CompiledNetwork<T>& network,
+                            const MnistDataset& train,
+                            const MnistDataset& test,
+                            const QuantizationConfig& quantization) {
+    using Clock = std::chrono::steady_clock;
+    const int kImageSize = test.ImageSize();
+    const int kNumClasses = MnistDataset::kNumClasses;
 
-    printf("Beginning training...\n");
+    const int num_samples = std::min(quantization.calibration_samples,
+                                     train.Size());
+    std::vector<T> calibration(static_cast<size_t>(num_samples) * kImageSize);
+    for (int i = 0; i < num_samples; i++) {
+        train.NormaliseImage(i, &calibration[static_cast<size_t>(i)
+                                             * kImageSize]);
+    }
+    const QuantizedNetwork<T> quantized(network, calibration.data(),
+                                        num_samples, quantization.scheme);
 
-    for (int epoch = 0; epoch < kEpoch; epoch++) {
-        // Selecte a random batch of training sample
-        std::vector<int> training_indices;
-        for (int j = 0; j < kBatchSize; j++) {
-            training_indices.push_back(rand() % images_train.size());
-        }
+    size_t float_bytes = 0;
+    for (const LayerView<T>& layer : network.Layers()) {
+        float_bytes += static_cast<size_t>(layer.num_neurons)
+                       * layer.num_inputs * sizeof(T);
+    }
+    printf("Quantized weights to int8 (%s, calibrated on %d samples): "
+           "%.1f KB, from %.1f KB\n",
+           QuantizationSchemeName(quantization.scheme), num_samples,
+           quantized.WeightBytes() / 1024.0, float_bytes / 1024.0);
+
+    // Normalised once, so that only inference is timed
+    std::vector<T> images(static_cast<size_t>(test.Size()) * kImageSize);
+    for (int i = 0; i < test.Size(); i++) {
+        test.NormaliseImage(i, &images[static_cast<size_t>(i) * kImageSize]);
+    }
+    std::vector<T> output(kNumClasses);
+    std::vector<int> predictions(test.Size());
+
+    InferenceSession<T> session(network);
+    int float_correct = 0;
+    const Clock::time_point float_start = Clock::now();
+    for (int i = 0; i < test.Size(); i++) {
+        session.Predict(&images[static_cast<size_t>(i) * kImageSize],
+                        output.data());
+        predictions[i] = Prediction(output.data(), kNumClasses);
+        float_correct += predictions[i] == test.Label(i);
+    }
+    const double float_seconds = std::chrono::duration<double>(
+                                        Clock::now() - float_start).count();
+
+    QuantizedSession<T> quantized_session(quantized);
+    int int8_correct = 0;
+    int agreements = 0;
+    const Clock::time_point int8_start = Clock::now();
+    for (int i = 0; i < test.Size(); i++) {
+        quantized_session.Predict(&images[static_cast<size_t>(i)
+                                          * kImageSize], output.data());
+        const int prediction = Prediction(output.data(), kNumClasses);
+        int8_correct += prediction == test.Label(i);
+        agreements += prediction == predictions[i];
+    }
+    const double int8_seconds = std::chrono::duration<double>(
+                                        Clock::now() - int8_start).count();
+
+    printf("Test accuracy over %d samples: %s %.2f%%, int8 %.2f%%, same "
+           "prediction for %.2f%%\n", test.Size(),
+           sizeof(T) == sizeof(float) ? "float" : "double",
+           100.0 * float_correct / test.Size(),
+           100.0 * int8_correct / test.Size(),
+           100.0 * agreements / test.Size());
+    printf("Single threaded inference: %.0f samples/s, int8 %.0f samples/s "
+           "(%.2fx)\n", test.Size() / float_seconds,
+           test.Size() / int8_seconds, float_seconds / int8_seconds);
+}
+
+/// @brief Trains a network for a number of epochs, printing the success rate,
+///        loss and throughput of each
+/// @param label printed at the start of each epoch's line, e.g. "Epoch"
+/// @param run name of the run in the metrics sink
+/// @param end_of_epoch called with the epoch number after each epoch's line
+///                     is printed, or empty
+/// @tparam Trainer DataParallelTrainer or PipelineTrainer
+template<typename T, template<typename> class Trainer>
+void TrainMnist(Trainer<T>& trainer, const MnistDataset& train,
+                const int& epochs, const int& samples_per_epoch,
+                const int& mini_batch_size, const int& data_threads,
+                const char* label, const char* run, const uint64_t& seed,
+                const std::function<void(const int&)>& end_of_epoch) {
+    const int kImageSize = train.ImageSize();
+    const int kNumClasses = MnistDataset::kNumClasses;
 
-        double success_count = 0.0;
-        double mean_loss = 0.0;
+    // Mini-batches are assembled on background threads while the previous
+    // one trains. Pixels are normalised as each batch is assembled.
+    BatchPipeline<T> pipeline(train.Size(), epochs, samples_per_epoch,
+                mini_batch_size, kImageSize, kNumClasses,
+                [&](const int* indices, const int& count, T* inputs,
+                    T* targets) {
+                    train.FillBatch(indices, count, inputs, targets);
+                }, data_threads, seed);
 
-        for (const int& sample : training_indices) {
-            // Training is labelled with a single number rather
-            // than a vector, so create the target vector here
-            const int label = labels_train.at(sample);
-            std::vector<double> target;
-            target.resize(10, 0.0);
-            target.at(label) = 1.0;
+    double success_count = 0.0;
+    double mean_loss = 0.0;
+    metrics::EpochRecorder recorder(run);
+    while (pipeline.HasNext()) {
+        const typename BatchPipeline<T>::Batch& batch = pipeline.Next();
 
-            // Forward propagation
-            std::vector<double> output;
-            output = network.Forwards(images_train.at(sample));
-            
-            // Backwards propagation, including update weights and biases
-            network.Backwards(target);
+        // Forward and backwards propagation, including update weights
+        // and biases
+        const T* output = trainer.TrainBatch(batch.inputs, batch.targets,
+                                             batch.count);
 
-            // Keep track of the number of succsseful predictions
+        // Keep track of the number of succsseful predictions
+        for (int j = 0; j < batch.count; j++) {
+            const T* sample_output = &output[j * kNumClasses];
             int prediction = 0;
-            for (int j = 0; j < output.size(); j++)
+            for (int k = 0; k < kNumClasses; k++)
             {
-                if (output[j] > output[prediction])
+                if (sample_output[k] > sample_output[prediction])
                 {
-                    prediction = j;
+                    prediction = k;
                 }
             }
-            success_count += prediction == label;
-            
-            std::vector<double> loss = network.CalculateError(target);
-            auto const count = static_cast<float>(loss.size());
-            mean_loss += std::reduce(loss.begin(), loss.end()) / count
-                         / kBatchSize;
+            success_count += prediction == train.Label(batch.indices[j]);
         }
 
-        double success_rate = success_count / kBatchSize;
+        mean_loss += trainer.LastBatchError() * batch.count
+                     / samples_per_epoch;
 
-        printf("Epoch %d success rate: %.0f%% mean loss: %f\n",
-                epoch, success_rate*100, mean_loss);
+        if (batch.last_in_epoch) {
+            double success_rate = success_count / samples_per_epoch;
+
+            const metrics::EpochMetrics& epoch_metrics = recorder.EndEpoch(
+                                                batch.epoch, samples_per_epoch);
+            printf("%s %d success rate: %.0f%% mean loss: %f "
+                   "(%.0f samples/s, %.2f GFLOP/s)\n", label, batch.epoch,
+                   success_rate*100, mean_loss,
+                   epoch_metrics.samples_per_second,
+                   epoch_metrics.flops_per_second * 1e-9);
+            if (end_of_epoch) {
+                end_of_epoch(batch.epoch);
+                recorder.RestartEpoch();
+            }
+            success_count = 0.0;
+            mean_loss = 0.0;
+        }
     }
+}
 
-    // Print a selection of random images to demonstrate learning
-    for (int i = 0; i < test_count; i++) {
-        int index = rand() % images_test.size();
-        std::vector<double> image = images_test[index];
-        int label = labels_test[index];
+/// @brief Trains a network with Hogwild for a number of epochs, printing the
+///        loss and throughput of each
+/// @param label printed at the start of each epoch's line, e.g. "Epoch"
+/// @param run name of the run in the metrics sink
+/// @param end_of_epoch called with the epoch number after each epoch's line
+///                     is printed, or empty
+/// @return training throughput over every epoch in samples per second
+template<typename T>
+double TrainMnistHogwild(HogwildTrainer<T>& trainer, const MnistDataset& train,
+                         const int& epochs, const int& samples_per_epoch,
+                         const char* label, const char* run,
+                         const uint64_t& seed,
+                         const std::function<void(const int&)>& end_of_epoch) {
+    // Each epoch trains on a new permutation of the training set, depending
+    // only on the seed and the epoch number
+    std::vector<int> indices(train.Size());
+    const auto fill = [&](const int* sample_indices, const int& count,
+                          T* inputs, T* targets) {
+        train.FillBatch(sample_indices, count, inputs, targets);
+    };
 
-        std::vector<double> output = network.Forwards(image);
+    double seconds = 0.0;
+    metrics::EpochRecorder recorder(run);
+    for (int epoch = 0; epoch < epochs; epoch++) {
+        std::iota(indices.begin(), indices.end(), 0);
+        CounterRng generator(seed, RandomStream(RandomDomain::kEpochShuffle,
+                                                epoch));
+        std::shuffle(indices.begin(), indices.end(), generator);
+        recorder.RestartEpoch();
+        trainer.Train(indices.data(), samples_per_epoch, fill);
 
-        int prediction = 0;
-        for (int j = 0; j < output.size(); j++)
-        {
-            if (output[j] > output[prediction])
-            {
-                prediction = j;
+        const metrics::EpochMetrics& epoch_metrics = recorder.EndEpoch(
+                                                    epoch, samples_per_epoch);
+        seconds += epoch_metrics.seconds;
+        printf("%s %d mean loss: %f (%.0f samples/s, %.2f GFLOP/s)\n", label,
+               epoch, trainer.LastLoss(), epoch_metrics.samples_per_second,
+               epoch_metrics.flops_per_second * 1e-9);
+        if (end_of_epoch) {
+            end_of_epoch(epoch);
+        }
+    }
+    return seconds > 0.0 ? static_cast<double>(epochs) * samples_per_epoch
+                           / seconds : 0.0;
+}
+
+/// @brief Trains a network with Hogwild on a number of threads, after first
+///        training a copy of it with the same starting weights on a single
+///        thread, then compares the throughput and test accuracy of the two
+template<typename T>
+void HogwildMnist(NeuralNetwork<T>& network, const MnistDataset& train,
+                  MnistEvaluator<T>& test_evaluator, const int& epochs,
+                  const int& samples_per_epoch, const int& threads,
+                  const int& mini_batch_size, const uint64_t& seed,
+                  const std::function<void(const int&)>& end_of_epoch) {
+    if (network.Optimizer().type != OptimizerType::kSgd) {
+        printf("Hogwild applies plain SGD updates, ignoring the %s "
+               "optimizer\n", OptimizerName(network.Optimizer().type));
+    }
+    const std::vector<Layer<T>>& layers = network.Layers();
+    std::vector<int> hidden_layers;
+    for (size_t i = 0; i + 1 < layers.size(); i++) {
+        hidden_layers.push_back(layers[i].NumNeurons());
+    }
+    const CompiledNetwork<T> initial(network);
+    NeuralNetwork<T> baseline(network.NumInputs(), network.NumOutputs(),
+                              hidden_layers,
+                              initial.Layers().front().activation,
+                              initial.Layers().back().activation);
+    baseline.LoadWeights(initial.Layers());
+    baseline.SetOptimizer(network.Optimizer());
+    baseline.SetLoss(network.Loss());
+
+    HogwildTrainer<T> baseline_trainer(baseline, 1, mini_batch_size);
+    printf("Beginning single threaded Hogwild baseline...\n");
+    const double baseline_rate = TrainMnistHogwild(baseline_trainer, train,
+                epochs, samples_per_epoch, "Baseline epoch",
+                "mnist_hogwild_baseline", seed, nullptr);
+    const double baseline_accuracy = test_evaluator.Evaluate(
+                CompiledNetwork<T>(baseline)).Accuracy();
+
+    HogwildTrainer<T> trainer(network, threads, mini_batch_size);
+    printf("Beginning Hogwild training on %d threads...\n",
+           trainer.NumThreads());
+    const double rate = TrainMnistHogwild(trainer, train, epochs,
+                samples_per_epoch, "Epoch", "mnist_hogwild", seed,
+                end_of_epoch);
+    const double accuracy = test_evaluator.Evaluate(
+                CompiledNetwork<T>(network)).Accuracy();
+
+    printf("Hogwild on 1 thread: %.0f samples/s, test accuracy %.2f%%\n",
+           baseline_rate, 100 * baseline_accuracy);
+    printf("Hogwild on %d threads: %.0f samples/s, test accuracy %.2f%% "
+           "(%.2fx)\n", trainer.NumThreads(), rate, 100 * accuracy,
+           rate / baseline_rate);
+}
+
+/// @brief Builds a trainable network holding the weights of a compiled one
+template<typename T>
+NeuralNetwork<T> NetworkFromModel(const CompiledNetwork<T>& model) {
+    const std::vector<LayerView<T>>& views = model.Layers();
+    std::vector<int> hidden_layers;
+    for (size_t i = 0; i + 1 < views.size(); i++) {
+        hidden_layers.push_back(views[i].num_neurons);
+    }
+    NeuralNetwork<T> network(model.NumInputs(), model.NumOutputs(),
+                             hidden_layers, views.front().activation,
+                             views.back().activation);
+    network.LoadWeights(views);
+    return network;
+}
+
+/// @brief Prints the density of each layer of a network and the fraction of
+///        all its weights that are zero
+template<typename T>
+void PrintDensities(const NeuralNetwork<T>& network) {
+    size_t total = 0;
+    double nonzero = 0.0;
+    printf("Layer densities:");
+    for (const Layer<T>& layer : network.Layers()) {
+        const size_t count = static_cast<size_t>(layer.NumNeurons())
+                             * layer.NumInputs();
+        const double density = layer.Density();
+        printf(" %.1f%%", density * 100);
+        total += count;
+        nonzero += density * count;
+    }
+    printf(", %.1f%% of weights pruned\n", 100.0 * (1.0 - nonzero / total));
+}
+
+/// @brief Compares the sparse runtime with the dense one over the whole test
+///        set: the storage and kernels chosen for each layer, the weight
+///        memory, and the single threaded throughput one sample at a time and
+///        in batches
+template<typename T>
+void EvaluateSparseMnist(const CompiledNetwork<T>& network,
+                         const MnistDataset& test) {
+    using Clock = std::chrono::steady_clock;
+    const int kImageSize = test.ImageSize();
+    const int kNumClasses = MnistDataset::kNumClasses;
+    const int kBatchSize = 64;
+
+    const SparseNetwork<T> sparse(network);
+    size_t dense_bytes = 0;
+    for (size_t i = 0; i < sparse.Layers().size(); i++) {
+        const SparseLayer<T>& layer = sparse.Layers()[i];
+        printf("Layer %zu: %d x %d, density %.1f%%, %s kernels for single "
+               "samples, %s for batches\n", i, layer.num_neurons,
+               layer.num_inputs, layer.density * 100,
+               layer.sparse_gemv ? "sparse" : "dense",
+               layer.sparse_gemm ? "sparse" : "dense");
+        dense_bytes += static_cast<size_t>(layer.num_neurons)
+                       * layer.num_inputs * sizeof(T);
+    }
+    printf("Sparse weights: %.1f KB, from %.1f KB dense\n",
+           sparse.WeightBytes() / 1024.0, dense_bytes / 1024.0);
+
+    // Normalised once, so that only inference is timed
+    std::vector<T> images(static_cast<size_t>(test.Size()) * kImageSize);
+    for (int i = 0; i < test.Size(); i++) {
+        test.NormaliseImage(i, &images[static_cast<size_t>(i) * kImageSize]);
+    }
+    std::vector<T> outputs(static_cast<size_t>(test.Size()) * kNumClasses);
+
+    InferenceSession<T> dense_session(network, kBatchSize);
+    SparseSession<T> sparse_session(sparse, kBatchSize);
+    for (const int& batch_size : {1, kBatchSize}) {
+        auto run = [&](auto& session) {
+            const Clock::time_point start = Clock::now();
+            int correct = 0;
+            for (int i = 0; i < test.Size(); i += batch_size) {
+                const int count = std::min(batch_size, test.Size() - i);
+                T* output = &outputs[static_cast<size_t>(i) * kNumClasses];
+                session.PredictBatch(&images[static_cast<size_t>(i)
+                                             * kImageSize], count, output);
+                for (int j = 0; j < count; j++) {
+                    correct += Prediction(output + j * kNumClasses,
+                                          kNumClasses) == test.Label(i + j);
+                }
             }
+            const double seconds = std::chrono::duration<double>(
+                                        Clock::now() - start).count();
+            return std::make_pair(test.Size() / seconds,
+                                  100.0 * correct / test.Size());
+        };
+        const auto dense = run(dense_session);
+        const auto sparse_result = run(sparse_session);
+        printf("Batch %d: dense %.0f samples/s (%.2f%%), sparse %.0f "
+               "samples/s (%.2f%%), %.2fx\n", batch_size, dense.first,
+               dense.second, sparse_result.first, sparse_result.second,
+               sparse_result.first / dense.first);
+    }
+}
+
+/// @brief Magnitude prunes a network, then fine-tunes the remaining weights
+///        data parallel on a number of threads, reporting the test accuracy
+///        before and after each step
+template<typename T>
+void PruneMnist(NeuralNetwork<T>& network, const MnistDataset& train,
+                MnistEvaluator<T>& test_evaluator,
+                const PruningConfig& pruning, const int& samples_per_epoch,
+                const int& mini_batch_size, const int& threads,
+                const int& data_threads, const uint64_t& seed) {
+    auto accuracy = [&]() {
+        return test_evaluator.Evaluate(CompiledNetwork<T>(network))
+                             .Accuracy();
+    };
+    const double dense_accuracy = accuracy();
+    network.Prune(pruning);
+    PrintDensities(network);
+    printf("Test accuracy: %.2f%% dense, %.2f%% pruned\n",
+           100 * dense_accuracy, 100 * accuracy());
+
+    if (pruning.fine_tune_epochs > 0) {
+        DataParallelTrainer<T> trainer(network, threads, mini_batch_size);
+        TrainMnist<T>(trainer, train, pruning.fine_tune_epochs,
+                      samples_per_epoch, mini_batch_size, data_threads,
+                      "Fine-tuning epoch", "mnist_fine_tune", seed, nullptr);
+        printf("Test accuracy after fine-tuning: %.2f%%\n",
+               100 * accuracy());
+    }
+}
+
+/// @brief Outcome of one run of a sweep
+struct SweepResult {
+    double test_accuracy = 0.0;
+    // Mean loss of the training samples of the last epoch
+    double train_loss = 0.0;
+    double seconds = 0.0;
+    // Why the run failed, or empty
+    std::string error;
+};
+
+/// @brief Trains and tests the network of one sweep run on the calling
+///        thread. Batches are assembled inline from the same permutations as
+///        BatchPipeline, as every other thread is busy with its own run.
+template<typename T>
+SweepResult TrainSweepRun(const SweepRun& run, const MnistDataset& train,
+                          const MnistDataset& test) {
+    using Clock = std::chrono::steady_clock;
+    const Clock::time_point start = Clock::now();
+    const int kImageSize = train.ImageSize();
+    const int kNumClasses = MnistDataset::kNumClasses;
+    if (run.epochs <= 0 || run.batch_size <= 0 || run.mini_batch_size <= 0) {
+        throw std::runtime_error("Invalid sweep run. Epochs "
+                    + std::to_string(run.epochs) + ", batch size "
+                    + std::to_string(run.batch_size) + ", mini-batch size "
+                    + std::to_string(run.mini_batch_size));
+    }
+
+    const ActivationFunction<T> output_activation =
+                run.loss == LossType::kSoftmaxCrossEntropy ? Identity<T>
+                                                           : Sigmoid<T>;
+    NeuralNetwork<T> network(kImageSize, kNumClasses, run.hidden_layers,
+                             Sigmoid<T>, output_activation, run.seed);
+    network.SetOptimizer(run.optimizer);
+    network.SetLoss(run.loss);
+    DataParallelTrainer<T> trainer(network, 1, run.mini_batch_size);
+
+    SweepResult result;
+    const int samples_per_epoch = std::min(run.batch_size, train.Size());
+    std::vector<int> permutation(train.Size());
+    AlignedVector<T> inputs(static_cast<size_t>(run.mini_batch_size)
+                            * kImageSize);
+    AlignedVector<T> targets(static_cast<size_t>(run.mini_batch_size)
+                             * kNumClasses);
+    for (int epoch = 0; epoch < run.epochs; epoch++) {
+        std::iota(permutation.begin(), permutation.end(), 0);
+        CounterRng generator(run.seed, RandomStream(
+                    RandomDomain::kEpochShuffle, epoch));
+        std::shuffle(permutation.begin(), permutation.end(), generator);
+
+        double loss = 0.0;
+        for (int first = 0; first < samples_per_epoch;
+             first += run.mini_batch_size) {
+            const int count = std::min(run.mini_batch_size,
+                                       samples_per_epoch - first);
+            train.FillBatch(&permutation[first], count, inputs.data(),
+                            targets.data());
+            trainer.TrainBatch(inputs.data(), targets.data(), count);
+            loss += trainer.LastBatchError() * count;
         }
+        result.train_loss = loss / samples_per_epoch;
+    }
 
-        PrintAsciiImage(image);
-        printf("Label is: %d, Predicted: %d\n", label, prediction);
+    MnistEvaluator<T> evaluator(test, 1);
+    result.test_accuracy = evaluator.Evaluate(CompiledNetwork<T>(network))
+                                    .Accuracy();
+    result.seconds = std::chrono::duration<double>(Clock::now() - start)
+                                .count();
+    return result;
+}
+
+template<typename T>
+void MnistSweep(const std::vector<SweepRun>& runs, const int& threads) {
+    using Clock = std::chrono::steady_clock;
+    printf("Loading data...\n");
+    std::unique_ptr<MnistDataset> train;
+    std::unique_ptr<MnistDataset> test;
+    try {
+        train.reset(new MnistDataset("data/train-images-idx3-ubyte",
+                                     "data/train-labels-idx1-ubyte"));
+        test.reset(new MnistDataset("data/t10k-images-idx3-ubyte",
+                                    "data/t10k-labels-idx1-ubyte"));
+    }
+    catch (const std::runtime_error& error) {
+        printf("Failed to load data: %s\n", error.what());
+        return;
+    }
+    printf("Loaded %d training samples and %d testing samples\n",
+            train->Size(), test->Size());
+
+    // The most expensive runs start first, so that the last to finish are
+    // short and every thread stays busy until near the end
+    const int num_runs = static_cast<int>(runs.size());
+    std::vector<double> cost(num_runs);
+    for (int i = 0; i < num_runs; i++) {
+        int prev_size = train->ImageSize();
+        double weights = 0.0;
+        for (const int& neurons : runs[i].hidden_layers) {
+            weights += static_cast<double>(prev_size) * neurons;
+            prev_size = neurons;
+        }
+        weights += static_cast<double>(prev_size) * MnistDataset::kNumClasses;
+        cost[i] = weights * runs[i].epochs
+                  * std::min(runs[i].batch_size, train->Size());
+    }
+    std::vector<int> order(num_runs);
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](const int& a,
+                                                     const int& b) {
+        return cost[a] > cost[b];
+    });
+
+    // One run per hardware thread unless told otherwise
+    const int num_threads = threads > 0 ? threads
+                : std::max(1, static_cast<int>(
+                                std::thread::hardware_concurrency()));
+    ThreadPool pool(std::min(num_threads, num_runs));
+    printf("Training %d networks on %d threads...\n", num_runs,
+           pool.NumThreads());
+    std::vector<SweepResult> results(num_runs);
+    const Clock::time_point start = Clock::now();
+    pool.ParallelFor(num_runs, [&](const int& i) {
+        const int run = order[i];
+        // One failed run must not take down the others
+        try {
+            results[run] = TrainSweepRun<T>(runs[run], *train, *test);
+            printf("Run %d finished in %.1f s\n", run, results[run].seconds);
+        }
+        catch (const std::exception& error) {
+            results[run].error = error.what();
+            printf("Run %d failed\n", run);
+        }
+    });
+    const double seconds = std::chrono::duration<double>(Clock::now()
+                                                         - start).count();
+
+    printf("%4s  %13s  %10s  %8s  %s\n", "Run", "Test accuracy",
+           "Train loss", "Seconds", "Settings");
+    int best = -1;
+    for (int i = 0; i < num_runs; i++) {
+        const SweepResult& result = results[i];
+        if (!result.error.empty()) {
+            printf("%4d  failed: %s  %s\n", i, result.error.c_str(),
+                   runs[i].settings.c_str());
+            continue;
+        }
+        printf("%4d  %12.2f%%  %10.6f  %8.1f  %s\n", i,
+               100 * result.test_accuracy, result.train_loss, result.seconds,
+               runs[i].settings.c_str());
+        if (best < 0 || result.test_accuracy > results[best].test_accuracy) {
+            best = i;
+        }
+    }
+    if (best >= 0) {
+        printf("Best test accuracy: run %d, %s\n", best,
+               runs[best].settings.c_str());
     }
-}
\ No newline at end of file
+    printf("Swept %d runs in %.1f s on %d threads\n", num_runs, seconds,
+           pool.NumThreads());
+}
+
+template<typename T>
+void MnistExample(const int& epochs, const int& batch_size,
+                  const int& mini_batch_size, const int& threads,
+                  const int& data_threads, const int& test_count,
+                  const std::vector<int>& hidden_layers,
+                  const OptimizerConfig& optimizer, const LossType& loss,
+                  const TrainerType& trainer_type,
+                  const QuantizationConfig& quantization,
+                  const PruningConfig& pruning,
+                  const EvaluationConfig& evaluation,
+                  const std::string& save_model,
+                  const std::string& load_model, const uint64_t& seed) {
+    printf("Loading data...\n");
+    std::unique_ptr<MnistDataset> train;
+    std::unique_ptr<MnistDataset> test;
+    try {
+        train.reset(new MnistDataset("data/train-images-idx3-ubyte",
+                                     "data/train-labels-idx1-ubyte"));
+        test.reset(new MnistDataset("data/t10k-images-idx3-ubyte",
+                                    "data/t10k-labels-idx1-ubyte"));
+    }
+    catch (const std::runtime_error& error) {
+        printf("Failed to load data: %s\n", error.what());
+        return;
+    }
+    printf("Loaded %d training samples and %d testing samples\n",
+            train->Size(), test->Size());
+
+    const int kImageSize = train->ImageSize();
+    const int kNumClasses = MnistDataset::kNumClasses;
+    // Cross entropy is taken over the softmax of the raw outputs
+    const ActivationFunction<T> output_activation =
+                loss == LossType::kSoftmaxCrossEntropy ? Identity<T>
+                                                       : Sigmoid<T>;
+    NeuralNetwork<T> network(kImageSize, kNumClasses, hidden_layers,
+                             Sigmoid<T>, output_activation, seed);
+
+    MnistEvaluator<T> test_evaluator(*test, threads);
+    // Full reports over each dataset selected by the evaluation config
+    auto report = [&](const CompiledNetwork<T>& compiled) {
+        if (evaluation.test) {
+            test_evaluator.Evaluate(compiled).Print("Test set");
+        }
+        if (evaluation.train) {
+            MnistEvaluator<T>(*train, threads).Evaluate(compiled)
+                                              .Print("Training set");
+        }
+    };
+
+    if (!load_model.empty()) {
+        const CompiledNetwork<T> compiled = CompiledNetwork<T>::Load(
+                                                                load_model);
+        if (compiled.NumInputs() != test->ImageSize()
+            || compiled.NumOutputs() != MnistDataset::kNumClasses) {
+            throw std::runtime_error("Model \"" + load_model + "\" has "
+                        + std::to_string(compiled.NumInputs()) + " inputs and "
+                        + std::to_string(compiled.NumOutputs()) + " outputs, "
+                        "expected " + std::to_string(test->ImageSize())
+                        + " and " + std::to_string(MnistDataset::kNumClasses));
+        }
+        printf("Loaded model \"%s\"\n", load_model.c_str());
+        if (!pruning.Enabled()) {
+            PrintMnistPredictions(compiled, *test, test_count, seed);
+            report(compiled);
+            if (quantization.enabled) {
+                EvaluateQuantizedMnist(compiled, *train, *test, quantization);
+            }
+            return;
+        }
+        // Pruned and fine-tuned starting from the loaded weights
+        network = NetworkFromModel(compiled);
+    }
+    network.SetOptimizer(optimizer);
+    network.SetLoss(loss);
+
+    // Each epoch trains on a random permutation of the training set,
+    // truncated to batch_size samples
+    const int kSamplesPerEpoch = std::min(batch_size, train->Size());
+
+    if (load_model.empty()) {
+        std::function<void(const int&)> end_of_epoch;
+        if (evaluation.test) {
+            end_of_epoch = [&](const int& epoch) {
+                const ClassificationReport epoch_report =
+                        test_evaluator.Evaluate(CompiledNetwork<T>(network));
+                printf("Epoch %d test accuracy: %.2f%% (%.0f images/s)\n",
+                       epoch, 100 * epoch_report.Accuracy(),
+                       epoch_report.SamplesPerSecond());
+            };
+        }
+        if (trainer_type == TrainerType::kHogwild) {
+            HogwildMnist(network, *train, test_evaluator, epochs,
+                         kSamplesPerEpoch, threads, mini_batch_size, seed,
+                         end_of_epoch);
+        }
+        else if (trainer_type == TrainerType::kPipeline) {
+            // Each mini-batch is an update, and the pipeline is flushed
+            // once per kDefaultPipelineMicroBatches of them
+            const int flush_size = mini_batch_size
+                                   * kDefaultPipelineMicroBatches;
+            PipelineTrainer<T> pipeline(network, threads, mini_batch_size,
+                                        flush_size);
+            printf("Beginning pipelined training on %d threads, layers",
+                   pipeline.NumThreads());
+            for (int stage = 0; stage < pipeline.NumStages(); stage++) {
+                const std::pair<int, int> layers = pipeline.StageLayers(
+                                                                    stage);
+                printf(" %d-%d", layers.first, layers.second - 1);
+            }
+            printf("...\n");
+            TrainMnist(pipeline, *train, epochs, kSamplesPerEpoch,
+                       flush_size, data_threads, "Epoch", "mnist", seed,
+                       end_of_epoch);
+        }
+        else {
+            DataParallelTrainer<T> trainer(network, threads,
+                                           mini_batch_size);
+            printf("Beginning training on %d threads...\n",
+                   trainer.NumThreads());
+            TrainMnist(trainer, *train, epochs, kSamplesPerEpoch,
+                       mini_batch_size, data_threads, "Epoch", "mnist", seed,
+                       end_of_epoch);
+        }
+    }
+    if (pruning.Enabled()) {
+        PruneMnist(network, *train, test_evaluator, pruning,
+                   kSamplesPerEpoch, mini_batch_size, threads, data_threads,
+                   seed);
+    }
+
+    if (!save_model.empty()) {
+        network.Save(save_model);
+        printf("Saved model to \"%s\"\n", save_model.c_str());
+    }
+
+    const CompiledNetwork<T> compiled(network);
+    PrintMnistPredictions(compiled, *test, test_count, seed);
+    report(compiled);
+    if (quantization.enabled) {
+        EvaluateQuantizedMnist(compiled, *train, *test, quantization);
+    }
+    if (pruning.Enabled()) {
+        EvaluateSparseMnist(compiled, *test);
+    }
+}
+
+template void MnistExample<float>(const int&, const int&, const int&,
+                                  const int&, const int&, const int&,
+                                  const std::vector<int>&,
+                                  const OptimizerConfig&, const LossType&,
+                                  const TrainerType&,
+                                  const QuantizationConfig&,
+                                  const PruningConfig&,
+                                  const EvaluationConfig&,
+                                  const std::string&, const std::string&,
+                                  const uint64_t&);
+template void MnistExample<double>(const int&, const int&, const int&,
+                                   const int&, const int&, const int&,
+                                   const std::vector<int>&,
+                                   const OptimizerConfig&, const LossType&,
+                                   const TrainerType&,
+                                   const QuantizationConfig&,
+                                   const PruningConfig&,
+                                   const EvaluationConfig&,
+                                   const std::string&, const std::string&,
+                                   const uint64_t&);
+
+template void MnistSweep<float>(const std::vector<SweepRun>&, const int&);
+template void MnistSweep<double>(const std::vector<SweepRun>&, const int&);
\ No newline at end of file
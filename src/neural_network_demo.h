@@ -1,9 +1,73 @@
 /// @brief Demo training a neural network (2x2x1) on a static training data
 ///        point.
-void SimpleExample(const int& epochs, const std::vector<int>& hidden_layers);
+void SimpleExample(const int& epochs, const std::vector<int>& hidden_layers,
+                   const uint64_t& seed);
 
 /// @brief Loads the mnist dataset and trains a neural network (784x100x100x10)
 ///        to identify hand written digits. Prints epoch results and examples
-///        from the test dataset.
+///        from the test dataset. Each epoch trains on batch_size samples drawn
+///        without replacement, updating the weights once per mini_batch_size
+///        samples. Each mini-batch is split across threads, while the next
+///        ones are assembled on data_threads background threads. Training is
+///        skipped if a saved model is loaded.
+/// @tparam T float or double, the precision of the network
+/// @param optimizer rule used to update the weights
+/// @param loss cost to train against. kSoftmaxCrossEntropy gives the output
+///             layer the identity activation, its outputs being the logits.
+/// @param trainer_type how training is split across threads. kHogwild first
+///                     trains a copy of the network on a single thread, and
+///                     compares the throughput and test accuracy of the two.
+///                     kPipeline gives each thread a group of layers, and
+///                     passes mini-batches through them as micro-batches.
+/// @param quantization whether to quantize the network to int8 afterwards,
+///                     comparing its accuracy and speed on the test set
+/// @param pruning whether to prune and fine-tune the network afterwards, or
+///                the loaded model, comparing its sparse and dense inference
+/// @param evaluation datasets to classify in full with batched inference
+///                   split across threads, reporting the accuracy, confusion
+///                   matrix, per-class recall and throughput. The test set is
+///                   also checked after every epoch.
+/// @param save_model model file to save the trained network to, or empty
+/// @param load_model model file to load instead of training, or empty
+/// @param seed seed of the initial weights, the order samples are trained in
+///             and the test samples printed. Runs with the same seed and
+///             config train identically for any number of data_threads.
+template<typename T>
 void MnistExample(const int& epochs, const int& batch_size,
-                 const int& test_count, const std::vector<int>& hidden_layers);
\ No newline at end of file
+                  const int& mini_batch_size, const int& threads,
+                  const int& data_threads, const int& test_count,
+                  const std::vector<int>& hidden_layers,
+                  const OptimizerConfig& optimizer, const LossType& loss,
+                  const TrainerType& trainer_type,
+                  const QuantizationConfig& quantization,
+                  const PruningConfig& pruning,
+                  const EvaluationConfig& evaluation,
+                  const std::string& save_model,
+                  const std::string& load_model, const uint64_t& seed);
+
+/// @brief Settings of one network trained by MnistSweep
+struct SweepRun {
+    // Swept keys and their values for this run, e.g. "learning_rate=0.1"
+    std::string settings;
+    int epochs = 0;
+    int batch_size = 0;
+    int mini_batch_size = 0;
+    std::vector<int> hidden_layers;
+    OptimizerConfig optimizer;
+    LossType loss = LossType::kMeanSquaredError;
+    uint64_t seed = 0;
+};
+
+/// @brief Loads the mnist dataset once, then trains a network for every run
+///        at once, one run per thread, all reading the same dataset. Each run
+///        trains on a single thread with the batches MnistExample would draw
+///        with the same seed, and is then classified over the full test set.
+///        Prints a summary table of the test accuracy, the mean training loss
+///        of the last epoch and the wall time of each run.
+/// @tparam T float or double, the precision of the networks
+/// @param runs settings of each network
+/// @param threads runs trained at once, including the calling thread, or
+///                zero for one per hardware thread. Limited to the number of
+///                runs.
+template<typename T>
+void MnistSweep(const std::vector<SweepRun>& runs, const int& threads);
\ No newline at end of file
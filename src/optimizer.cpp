@@ -0,0 +1,41 @@
+#include <stdexcept>
+#include <string>
+
+#include "optimizer.h"
+
+OptimizerType ParseOptimizerType(const std::string& name) {
+    if (name == "sgd") {
+        return OptimizerType::kSgd;
+    }
+    if (name == "momentum") {
+        return OptimizerType::kMomentum;
+    }
+    if (name == "nesterov") {
+        return OptimizerType::kNesterov;
+    }
+    if (name == "adam") {
+        return OptimizerType::kAdam;
+    }
+    throw std::runtime_error("Unknown optimizer \"" + name + "\", expected "
+                             "sgd, momentum, nesterov or adam");
+}
+
+const char* OptimizerName(const OptimizerType& type) {
+    switch (type) {
+        case OptimizerType::kSgd: return "sgd";
+        case OptimizerType::kMomentum: return "momentum";
+        case OptimizerType::kNesterov: return "nesterov";
+        case OptimizerType::kAdam: return "adam";
+    }
+    return "unknown";
+}
+
+int OptimizerStateSize(const OptimizerType& type) {
+    switch (type) {
+        case OptimizerType::kSgd: return 0;
+        case OptimizerType::kMomentum: return 1;
+        case OptimizerType::kNesterov: return 1;
+        case OptimizerType::kAdam: return 2;
+    }
+    return 0;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <string>
+
+/// @brief Rule used to update the weights and biases from their gradients
+enum class OptimizerType {
+    // Plain stochastic gradient descent, p -= learning_rate * g
+    kSgd,
+    // Heavy ball momentum
+    kMomentum,
+    // Nesterov accelerated gradient
+    kNesterov,
+    // Adam, per parameter step sizes from running moments of the gradient
+    kAdam,
+};
+
+/// @brief Optimizer and its hyperparameters, e.g. loaded from config.ini.
+///        Members not used by the chosen optimizer are ignored.
+struct OptimizerConfig {
+    OptimizerType type = OptimizerType::kSgd;
+    double learning_rate = 0.025;
+    // Decay of the velocity of kMomentum and kNesterov
+    double momentum = 0.9;
+    // Decay of the first and second moments of kAdam
+    double beta1 = 0.9;
+    double beta2 = 0.999;
+    double epsilon = 1e-8;
+};
+
+/// @brief Looks up an optimizer by its config name: sgd, momentum, nesterov
+///        or adam. Throws runtime_error for unknown names.
+/// @param name name of the optimizer
+/// @return the optimizer type
+OptimizerType ParseOptimizerType(const std::string& name);
+
+/// @brief Config name of an optimizer, e.g. "adam"
+const char* OptimizerName(const OptimizerType& type);
+
+/// @brief Number of values of optimizer state kept per parameter
+/// @param type optimizer type
+/// @return 0 for kSgd, 1 for momentum and 2 for kAdam
+int OptimizerStateSize(const OptimizerType& type);
@@ -0,0 +1,292 @@
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include "pipeline.h"
+#include "metrics.h"
+
+namespace {
+
+/// @brief Number of stages a network can be split into, one layer at least
+template<typename T>
+int NumPipelineStages(const NeuralNetwork<T>& network,
+                      const int& num_stages) {
+    if (num_stages <= 0) {
+        throw std::runtime_error("Invalid number of stages in PipelineTrainer"
+                    ". Number of stages is " + std::to_string(num_stages));
+    }
+    return std::min(num_stages,
+                    static_cast<int>(network.Layers().size()));
+}
+
+/// @brief Pushes onto a queue, waiting for space. The pipeline never has more
+///        micro-batches in flight than the queues hold, so this only waits if
+///        the consumer is still popping.
+void Push(SpscQueue<int>& queue, const int& micro_batch) {
+    while (!queue.TryPush(micro_batch)) {
+        std::this_thread::yield();
+    }
+}
+
+} // namespace
+
+template<typename T>
+PipelineTrainer<T>::PipelineTrainer(NeuralNetwork<T>& network,
+                                    const int& num_stages,
+                                    const int& micro_batch_size,
+                                    const int& max_batch_size) :
+                                    network_(network),
+                                    pool(NumPipelineStages(network,
+                                                           num_stages)),
+                                    micro_batch_size_(micro_batch_size) {
+    if (micro_batch_size <= 0) {
+        throw std::runtime_error("Invalid micro-batch size in PipelineTrainer"
+                    ". Micro-batch size is "
+                    + std::to_string(micro_batch_size));
+    }
+
+    // Each stage ends at the layer boundary closest to an equal share of the
+    // total cost, leaving at least one layer for each later stage
+    const std::vector<Layer<T>>& layers = network_.Layers();
+    const int num_layers = static_cast<int>(layers.size());
+    const int count = pool.NumThreads();
+    std::vector<double> cost_before(num_layers + 1, 0.0);
+    for (int i = 0; i < num_layers; i++) {
+        cost_before[i + 1] = cost_before[i]
+                             + static_cast<double>(layers[i].NumNeurons())
+                             * layers[i].NumInputs();
+    }
+    stages.resize(count);
+    int first_layer = 0;
+    for (int stage = 0; stage < count; stage++) {
+        int end_layer = num_layers;
+        if (stage + 1 < count) {
+            const double target = cost_before[num_layers] * (stage + 1)
+                                  / count;
+            end_layer = first_layer + 1;
+            const int last_end = num_layers - (count - stage - 1);
+            while (end_layer < last_end
+                   && std::fabs(cost_before[end_layer + 1] - target)
+                      < std::fabs(cost_before[end_layer] - target)) {
+                end_layer++;
+            }
+        }
+        stages[stage].first_layer = first_layer;
+        stages[stage].end_layer = end_layer;
+        stages[stage].max_in_flight = count - stage;
+        first_layer = end_layer;
+    }
+
+    // Each stashed block starts on a cache line, like the workspace buffers
+    const size_t block = kCacheLineSize / sizeof(T);
+    auto block_size = [&](const size_t& count) {
+        return (count + block - 1) / block * block;
+    };
+    for (Stage& stage : stages) {
+        if (stage.max_in_flight > 1) {
+            for (int i = stage.first_layer; i < stage.end_layer; i++) {
+                const size_t num_neurons = layers[i].NumNeurons();
+                stage.stash_offsets.push_back(stage.stash_slot_size);
+                stage.stash_slot_size += block_size(num_neurons
+                                                    * layers[i].NumInputs());
+                stage.stash_offsets.push_back(stage.stash_slot_size);
+                stage.stash_slot_size += block_size(num_neurons);
+            }
+            stage.stash.assign(stage.stash_slot_size * stage.max_in_flight,
+                               T(0));
+        }
+    }
+
+    // Stage 0 starts micro-batch i + count only once micro-batch i has
+    // passed backwards through every stage, so count workspaces and queues
+    // of count items are never overrun
+    for (int i = 0; i < count; i++) {
+        workspaces.push_back(network_.CreateWorkspace(micro_batch_size));
+    }
+    for (int i = 0; i + 1 < count; i++) {
+        forward_queues.emplace_back(count);
+        backward_queues.emplace_back(count);
+    }
+    outputs.resize(static_cast<size_t>(std::max(max_batch_size, 1))
+                   * network_.NumOutputs());
+}
+
+template<typename T>
+const T* PipelineTrainer<T>::TrainBatch(const T* inputs, const T* targets,
+                                        const int& batch_size) {
+    if (batch_size <= 0) {
+        throw std::runtime_error("Invalid batch size in PipelineTrainer::"
+                    "TrainBatch. Batch size is " + std::to_string(batch_size));
+    }
+    const size_t num_outputs = static_cast<size_t>(batch_size)
+                               * network_.NumOutputs();
+    if (outputs.size() < num_outputs) {
+        outputs.resize(num_outputs);
+    }
+
+    inputs_ = inputs;
+    targets_ = targets;
+    batch_size_ = batch_size;
+    num_micro_batches = (batch_size + micro_batch_size_ - 1)
+                        / micro_batch_size_;
+    loss_sum = 0.0;
+
+    // Every stage runs at once, one per thread
+    pool.ParallelFor(NumStages(), [&](const int& stage) {
+        RunStage(stage);
+    });
+
+    return outputs.data();
+}
+
+template<typename T>
+void PipelineTrainer<T>::RunStage(const int& stage) {
+    const Stage& current = stages[stage];
+    const bool last = stage + 1 == NumStages();
+    int forwards = 0;
+    int backwards = 0;
+    while (backwards < num_micro_batches) {
+        int micro_batch = 0;
+        // Backwards first, finishing micro-batches and freeing their buffers
+        if (!last && backward_queues[stage].TryPop(micro_batch)) {
+            Backwards(stage, micro_batch);
+            backwards++;
+            if (stage > 0) {
+                Push(backward_queues[stage - 1], micro_batch);
+            }
+            continue;
+        }
+
+        const bool can_start = forwards < num_micro_batches
+                    && forwards - backwards < current.max_in_flight;
+        if (can_start && (stage == 0 ? (micro_batch = forwards, true)
+                          : forward_queues[stage - 1].TryPop(micro_batch))) {
+            Forwards(stage, micro_batch);
+            forwards++;
+            if (!last) {
+                Push(forward_queues[stage], micro_batch);
+                continue;
+            }
+            Backwards(stage, micro_batch);
+            backwards++;
+            if (stage > 0) {
+                Push(backward_queues[stage - 1], micro_batch);
+            }
+            continue;
+        }
+
+        // Waiting on a neighbouring stage
+        std::this_thread::yield();
+    }
+}
+
+template<typename T>
+size_t PipelineTrainer<T>::StashSlot(const Stage& stage,
+                                     const int& micro_batch) const {
+    // The micro-batches in flight in a stage are consecutive, so each has
+    // its own slot
+    const int slot = micro_batch % stage.max_in_flight;
+    return static_cast<size_t>(slot) * stage.stash_slot_size;
+}
+
+template<typename T>
+LayerView<T> PipelineTrainer<T>::StageLayer(const Stage& stage,
+                                            const int& micro_batch,
+                                            const int& layer) const {
+    LayerView<T> view = network_.Layers()[layer].View();
+    if (!stage.stash.empty()) {
+        const T* slot = stage.stash.data() + StashSlot(stage, micro_batch);
+        const size_t index = 2 * static_cast<size_t>(layer
+                                                     - stage.first_layer);
+        view.weights = slot + stage.stash_offsets[index];
+        view.biases = slot + stage.stash_offsets[index + 1];
+    }
+    return view;
+}
+
+template<typename T>
+void PipelineTrainer<T>::Forwards(const int& stage, const int& micro_batch) {
+    Stage& current = stages[stage];
+    Workspace<T>& workspace = workspaces[micro_batch % NumStages()];
+    const int start = micro_batch * micro_batch_size_;
+    if (stage == 0) {
+        workspace.inputs = inputs_ + static_cast<size_t>(start)
+                                     * network_.NumInputs();
+        workspace.batch_size = std::min(micro_batch_size_,
+                                        batch_size_ - start);
+    }
+    const int count = workspace.batch_size;
+
+    const T* next_input = current.first_layer > 0
+                ? workspace.layers[current.first_layer - 1].outputs
+                : workspace.inputs;
+    for (int i = current.first_layer; i < current.end_layer; i++) {
+        // Stash the latest weights for this micro-batch's backwards pass
+        if (!current.stash.empty()) {
+            const LayerView<T> latest = network_.Layers()[i].View();
+            T* slot = current.stash.data() + StashSlot(current, micro_batch);
+            const size_t index = 2 * static_cast<size_t>(i
+                                                 - current.first_layer);
+            std::copy(latest.weights, latest.weights
+                      + static_cast<size_t>(latest.num_neurons)
+                      * latest.num_inputs,
+                      slot + current.stash_offsets[index]);
+            std::copy(latest.biases, latest.biases + latest.num_neurons,
+                      slot + current.stash_offsets[index + 1]);
+        }
+        next_input = StageLayer(current, micro_batch, i).ForwardsBatch(
+                    next_input, count, workspace.layers[i]);
+    }
+
+    if (stage + 1 == NumStages()) {
+        const int num_outputs = network_.NumOutputs();
+        const size_t offset = static_cast<size_t>(start) * num_outputs;
+        METRICS_SCOPE(metrics::Counter::kLoss, 3ull * count * num_outputs);
+        workspace.loss = BatchLoss(network_.Loss(), count, num_outputs,
+                                   next_input, targets_ + offset,
+                                   workspace.dCost_dOutput);
+        std::copy(next_input, next_input
+                  + static_cast<size_t>(count) * num_outputs,
+                  outputs.begin() + offset);
+        loss_sum += workspace.loss * count;
+    }
+}
+
+template<typename T>
+void PipelineTrainer<T>::Backwards(const int& stage, const int& micro_batch) {
+    Stage& current = stages[stage];
+    Workspace<T>& workspace = workspaces[micro_batch % NumStages()];
+    const int count = workspace.batch_size;
+
+    const T* dCost_dOutput = stage + 1 == NumStages()
+                ? workspace.dCost_dOutput
+                : workspace.layers[current.end_layer].dCost_dInput;
+    for (int i = current.end_layer - 1; i >= current.first_layer; i--) {
+        const T* inputs = i > 0 ? workspace.layers[i - 1].outputs
+                                : workspace.inputs;
+        // The cost relative to the network input is not needed
+        dCost_dOutput = StageLayer(current, micro_batch, i).BackwardsBatch(
+                    inputs, dCost_dOutput, count, workspace.layers[i], i > 0);
+    }
+
+    current.steps++;
+    for (int i = current.first_layer; i < current.end_layer; i++) {
+        network_.ApplyLayerGradients(i, workspace.layers[i], current.steps,
+                                     count);
+    }
+}
+
+template<typename T>
+double PipelineTrainer<T>::LastBatchError() const {
+    return batch_size_ > 0 ? loss_sum / batch_size_ : 0.0;
+}
+
+template<typename T>
+std::pair<int, int> PipelineTrainer<T>::StageLayers(const int& stage) const {
+    return {stages.at(stage).first_layer, stages.at(stage).end_layer};
+}
+
+template class PipelineTrainer<float>;
+template class PipelineTrainer<double>;
@@ -0,0 +1,157 @@
+#pragma once
+
+#include <deque>
+#include <utility>
+#include <vector>
+
+#include "neural_network.h"
+#include "spsc_queue.h"
+#include "thread_pool.h"
+
+// Default micro-batches per TrainBatch call of a PipelineTrainer. The
+// pipeline fills and drains once per call, so more micro-batches per call
+// leave the stages idle for a smaller fraction of it.
+constexpr int kDefaultPipelineMicroBatches = 32;
+
+/// @brief Trains a NeuralNetwork with pipeline parallelism. The layers are
+///        split into contiguous stages of roughly equal cost, each owned by
+///        one thread, and each batch is split into micro-batches that flow
+///        forwards through the stages and back again, passed between them
+///        through lock-free single producer, single consumer queues. Stages
+///        work on different micro-batches at once, so a deep network keeps
+///        one thread busy per stage even when the micro-batches are small.
+///
+///        Each stage updates its own layers after the backwards pass of every
+///        micro-batch, without waiting for the other stages (PipeDream style
+///        asynchronous updates). Stage s has at most num_stages - s
+///        micro-batches in flight, so its weights may change between the
+///        forwards and backwards pass of a micro-batch. Weight stashing keeps
+///        the gradient consistent: the forwards pass runs on a copy of the
+///        stage's latest weights, kept for that micro-batch's backwards pass,
+///        while the updates go to the network. The last stage runs the
+///        backwards pass straight after the forwards pass, so it needs no
+///        copies. With one stage this is NeuralNetwork::BackwardsBatch once
+///        per micro-batch.
+///
+///        The pipeline fills and drains once per TrainBatch call, so every
+///        update of a call is applied when it returns. Buffers are allocated
+///        by the constructor, so training does not allocate.
+///        Example usage:
+///
+///    PipelineTrainer<float> trainer(network, 3, micro_batch_size,
+///                                   batch_size);
+///    const float* outputs = trainer.TrainBatch(inputs, targets, count);
+///    double loss = trainer.LastBatchError();
+template<typename T>
+class PipelineTrainer {
+private:
+    // Layers owned by one thread
+    struct Stage {
+        // Range of layers [first_layer, end_layer)
+        int first_layer = 0;
+        int end_layer = 0;
+        // Largest number of micro-batches between their forwards and
+        // backwards pass in this stage
+        int max_in_flight = 0;
+        // Weights and biases used by the forwards pass of each micro-batch
+        // in flight, max_in_flight slots each holding the weights then the
+        // biases of every layer in the stage, each block starting on a cache
+        // line. Optimizer state is not copied. Empty if the stage never has
+        // more than one micro-batch in flight.
+        AlignedVector<T> stash;
+        // Offset of each layer's weights within a slot, then of its biases
+        std::vector<size_t> stash_offsets;
+        // Values in each slot of the stash
+        size_t stash_slot_size = 0;
+        // Updates applied to the stage's layers so far
+        long steps = 0;
+    };
+
+    // Network being trained. Must outlive the trainer.
+    NeuralNetwork<T>& network_;
+    ThreadPool pool;
+    int micro_batch_size_ = 0;
+
+    std::vector<Stage> stages;
+    // Activations and gradients of each micro-batch in flight in the
+    // pipeline, micro-batch i uses workspace i % num_stages. Each stage only
+    // writes the buffers of its own layers.
+    std::vector<Workspace<T>> workspaces;
+    // Indices of micro-batches passed forwards from stage i to stage i + 1,
+    // and backwards from stage i + 1 to stage i
+    std::deque<SpscQueue<int>> forward_queues;
+    std::deque<SpscQueue<int>> backward_queues;
+
+    // Network outputs of the last batch gathered from every micro-batch,
+    // batch_size x num_outputs
+    AlignedVector<T> outputs;
+    // Loss of the last batch summed over its samples
+    double loss_sum = 0.0;
+    // Batch of the current TrainBatch call
+    const T* inputs_ = nullptr;
+    const T* targets_ = nullptr;
+    int batch_size_ = 0;
+    int num_micro_batches = 0;
+
+    /// @brief Runs one stage until every micro-batch of the current batch has
+    ///        passed backwards through it, preferring backwards passes
+    /// @param stage index of the stage
+    void RunStage(const int& stage);
+
+    /// @brief Forwards pass of one micro-batch through a stage's layers. The
+    ///        last stage also computes the loss and the gradient of its
+    ///        outputs.
+    void Forwards(const int& stage, const int& micro_batch);
+
+    /// @brief Backwards pass of one micro-batch through a stage's layers,
+    ///        then one update of each layer with its gradients
+    void Backwards(const int& stage, const int& micro_batch);
+
+    /// @brief Offset in a stage's stash of the slot used by a micro-batch
+    size_t StashSlot(const Stage& stage, const int& micro_batch) const;
+
+    /// @brief Weights the passes of a micro-batch run on: the stashed copy
+    ///        for the micro-batch, or the network's own layer if the stage
+    ///        keeps no copies
+    LayerView<T> StageLayer(const Stage& stage, const int& micro_batch,
+                            const int& layer) const;
+
+public:
+    /// @brief Constructor. Splits the layers into stages of roughly equal
+    ///        cost, one weight per multiply-add.
+    /// @param network network to train
+    /// @param num_stages threads to split the layers across, including the
+    ///                   calling thread. Limited to the number of layers.
+    /// @param micro_batch_size samples per micro-batch, and per update
+    /// @param max_batch_size largest batch passed to TrainBatch, used to size
+    ///                       the outputs up front
+    PipelineTrainer(NeuralNetwork<T>& network, const int& num_stages,
+                    const int& micro_batch_size, const int& max_batch_size);
+
+    /// @brief Passes a batch through the pipeline as micro-batches of
+    ///        micro_batch_size samples, each stage updating its layers once
+    ///        per micro-batch. Returns once every update has been applied.
+    /// @param inputs batch_size x num_inputs row-major block of samples
+    /// @param targets batch_size x num_outputs block of target results
+    /// @param batch_size number of samples in the batch
+    /// @return batch_size x num_outputs block of network outputs from the
+    ///         forwards passes. Valid until the next call.
+    const T* TrainBatch(const T* inputs, const T* targets,
+                        const int& batch_size);
+
+    /// @brief Loss of the outputs of the last batch, computed along with the
+    ///        gradients
+    /// @return mean over the batch of the network's loss, see
+    ///         NeuralNetwork::CalculateBatchError
+    double LastBatchError() const;
+
+    /// @brief Range of layers [first, end) owned by a stage
+    /// @param stage index of the stage
+    std::pair<int, int> StageLayers(const int& stage) const;
+
+    /// @brief Number of stages, one per thread
+    int NumStages() const { return static_cast<int>(stages.size()); }
+
+    /// @brief Threads the layers are split across
+    int NumThreads() const { return pool.NumThreads(); }
+};
@@ -0,0 +1,16 @@
+#pragma once
+
+/// @brief Magnitude pruning settings, e.g. loaded from config.ini. Pruning is
+///        enabled when either threshold or sparsity is positive.
+struct PruningConfig {
+    // Weights with a smaller magnitude are zeroed
+    double threshold = 0.0;
+    // Fraction of each layer's weights zeroed, smallest magnitudes first,
+    // from 0 up to but excluding 1
+    double sparsity = 0.0;
+    // Training epochs run after pruning, with the pruned weights held at zero
+    int fine_tune_epochs = 0;
+
+    /// @brief Whether any weights are pruned
+    bool Enabled() const { return threshold > 0.0 || sparsity > 0.0; }
+};
@@ -0,0 +1,209 @@
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+
+#include "quantized.h"
+#include "kernels/kernels.h"
+
+// Calibration samples passed through the float network at once
+constexpr int kCalibrationBatchSize = 256;
+// Largest magnitude of a quantized value
+constexpr double kInt8Max = 127.0;
+
+QuantizationScheme ParseQuantizationScheme(const std::string& name) {
+    if (name == "per_layer") {
+        return QuantizationScheme::kPerLayer;
+    }
+    if (name == "per_channel") {
+        return QuantizationScheme::kPerChannel;
+    }
+    throw std::runtime_error("Unknown quantization scheme \"" + name + "\", "
+                             "expected per_layer or per_channel");
+}
+
+const char* QuantizationSchemeName(const QuantizationScheme& scheme) {
+    switch (scheme) {
+        case QuantizationScheme::kPerLayer: return "per_layer";
+        case QuantizationScheme::kPerChannel: return "per_channel";
+    }
+    return "unknown";
+}
+
+/// @brief Largest magnitude of a block of values
+template<typename T>
+double MaxAbs(const T* values, const size_t& count) {
+    double max_abs = 0.0;
+    for (size_t i = 0; i < count; i++) {
+        max_abs = std::max(max_abs, std::fabs(static_cast<double>(values[i])));
+    }
+    return max_abs;
+}
+
+/// @brief Value of one quantization step for values up to max_abs
+double QuantizationScale(const double& max_abs) {
+    return max_abs > 0.0 ? max_abs / kInt8Max : 1.0;
+}
+
+// =======================================
+// QuantizedNetwork
+// =======================================
+
+template<typename T>
+QuantizedNetwork<T>::QuantizedNetwork(const CompiledNetwork<T>& network,
+                                      const T* calibration_inputs,
+                                      const int& num_samples,
+                                      const QuantizationScheme& scheme) {
+    if (num_samples <= 0) {
+        throw std::runtime_error("Invalid number of calibration samples in "
+                    "QuantizedNetwork. Number of samples is "
+                    + std::to_string(num_samples));
+    }
+    const std::vector<LayerView<T>>& views = network.Layers();
+
+    // Largest input to each layer over the calibration samples, passed
+    // through the float network a batch at a time
+    std::vector<double> input_max(views.size(), 0.0);
+    const size_t buffer_size = static_cast<size_t>(kCalibrationBatchSize)
+                               * network.MaxLayerSize();
+    AlignedVector<T> buffer_a(buffer_size);
+    AlignedVector<T> buffer_b(buffer_size);
+    for (int start = 0; start < num_samples; start += kCalibrationBatchSize) {
+        const int count = std::min(kCalibrationBatchSize,
+                                   num_samples - start);
+        const T* inputs = calibration_inputs
+                          + static_cast<size_t>(start) * network.NumInputs();
+        for (size_t i = 0; i < views.size(); i++) {
+            const LayerView<T>& view = views[i];
+            input_max[i] = std::max(input_max[i], MaxAbs(inputs,
+                        static_cast<size_t>(count) * view.num_inputs));
+            T* outputs = inputs == buffer_a.data() ? buffer_b.data()
+                                                   : buffer_a.data();
+            view.ForwardsBatch(inputs, count, outputs);
+            inputs = outputs;
+        }
+    }
+
+    // One allocation for the weights and one for the scales and biases, each
+    // block starting on a cache line
+    auto block_size = [](const size_t& count, const size_t& element_size) {
+        const size_t block = kCacheLineSize / element_size;
+        return (count + block - 1) / block * block;
+    };
+    size_t total_weights = 0;
+    size_t total_scales = 0;
+    for (const LayerView<T>& view : views) {
+        total_weights += block_size(static_cast<size_t>(view.num_neurons)
+                                    * view.num_inputs, sizeof(int8_t));
+        total_scales += 2 * block_size(view.num_neurons, sizeof(T));
+    }
+    weight_storage.assign(total_weights, 0);
+    scale_storage.assign(total_scales, T(0));
+
+    size_t weight_offset = 0;
+    size_t scale_offset = 0;
+    for (size_t i = 0; i < views.size(); i++) {
+        const LayerView<T>& view = views[i];
+        const size_t num_inputs = view.num_inputs;
+        int8_t* weights = weight_storage.data() + weight_offset;
+        T* output_scales = scale_storage.data() + scale_offset;
+        scale_offset += block_size(view.num_neurons, sizeof(T));
+        T* biases = scale_storage.data() + scale_offset;
+        scale_offset += block_size(view.num_neurons, sizeof(T));
+        weight_offset += block_size(view.num_neurons * num_inputs,
+                                    sizeof(int8_t));
+
+        const double input_scale = QuantizationScale(input_max[i]);
+        const double layer_scale = QuantizationScale(MaxAbs(view.weights,
+                                            view.num_neurons * num_inputs));
+        for (int neuron = 0; neuron < view.num_neurons; neuron++) {
+            const T* row = view.weights + neuron * num_inputs;
+            const double weight_scale =
+                        scheme == QuantizationScheme::kPerChannel
+                        ? QuantizationScale(MaxAbs(row, num_inputs))
+                        : layer_scale;
+            kernels::QuantizeInt8(num_inputs, row,
+                                  static_cast<T>(1.0 / weight_scale),
+                                  weights + neuron * num_inputs);
+            output_scales[neuron] = static_cast<T>(weight_scale
+                                                   * input_scale);
+        }
+        std::copy(view.biases, view.biases + view.num_neurons, biases);
+
+        QuantizedLayer<T> layer;
+        layer.weights = weights;
+        layer.output_scales = output_scales;
+        layer.biases = biases;
+        layer.input_inv_scale = static_cast<T>(1.0 / input_scale);
+        layer.num_inputs = view.num_inputs;
+        layer.num_neurons = view.num_neurons;
+        layer.activation = view.activation;
+        layers.push_back(layer);
+    }
+
+    num_inputs_ = network.NumInputs();
+    num_outputs_ = network.NumOutputs();
+    max_layer_size = std::max(network.MaxLayerSize(), num_inputs_);
+}
+
+template<typename T>
+size_t QuantizedNetwork<T>::WeightBytes() const {
+    size_t bytes = 0;
+    for (const QuantizedLayer<T>& layer : layers) {
+        bytes += static_cast<size_t>(layer.num_neurons) * layer.num_inputs
+                 * sizeof(int8_t);
+    }
+    return bytes;
+}
+
+// =======================================
+// QuantizedSession
+// =======================================
+
+template<typename T>
+QuantizedSession<T>::QuantizedSession(const QuantizedNetwork<T>& network) :
+                                      network_(network),
+                                      quantized_input(network.MaxLayerSize()),
+                                      buffer_a(network.MaxLayerSize()),
+                                      buffer_b(network.MaxLayerSize()) {
+}
+
+template<typename T>
+void QuantizedSession<T>::Predict(const T* input, T* output) {
+    const std::vector<QuantizedLayer<T>>& layers = network_.Layers();
+    const T* next_input = input;
+    T* next_output = buffer_a.data();
+    for (size_t i = 0; i < layers.size(); i++) {
+        const QuantizedLayer<T>& layer = layers[i];
+        // The last layer writes straight into the caller's buffer
+        T* layer_output = i + 1 == layers.size() ? output : next_output;
+
+        kernels::QuantizeInt8(layer.num_inputs, next_input,
+                              layer.input_inv_scale, quantized_input.data());
+        kernels::QuantizedGemv(layer.num_neurons, layer.num_inputs,
+                               layer.weights, layer.num_inputs,
+                               quantized_input.data(), layer.output_scales,
+                               layer.biases, layer_output);
+        layer.activation.ForwardsBatch(layer_output, layer_output,
+                                       layer.num_neurons);
+
+        next_input = layer_output;
+        next_output = next_output == buffer_a.data() ? buffer_b.data()
+                                                     : buffer_a.data();
+    }
+}
+
+template<typename T>
+void QuantizedSession<T>::PredictBatch(const T* inputs, const int& batch_size,
+                                       T* outputs) {
+    for (int sample = 0; sample < batch_size; sample++) {
+        Predict(inputs + static_cast<size_t>(sample) * network_.NumInputs(),
+                outputs + static_cast<size_t>(sample)
+                          * network_.NumOutputs());
+    }
+}
+
+template class QuantizedNetwork<float>;
+template class QuantizedNetwork<double>;
+template class QuantizedSession<float>;
+template class QuantizedSession<double>;
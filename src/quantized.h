@@ -0,0 +1,152 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "inference.h"
+#include "aligned_allocator.h"
+
+/*
+    Post-training int8 quantization for inference. Weights are rounded to
+    int8 with a scale per layer or per neuron, and the input to each layer is
+    rounded to int8 with a scale calibrated from the largest activation seen
+    over a sample of the dataset. Weighted sums are accumulated in int32 and
+    converted back to floating point, along with the bias and activation
+    function, so only the matrix-vector products run in int8.
+*/
+
+/// @brief Granularity of the weight scales
+enum class QuantizationScheme {
+    // One scale for every weight in a layer
+    kPerLayer,
+    // One scale for the weights of each neuron, tracking its own range
+    kPerChannel,
+};
+
+/// @brief Post-training quantization settings, e.g. loaded from config.ini
+struct QuantizationConfig {
+    bool enabled = false;
+    QuantizationScheme scheme = QuantizationScheme::kPerChannel;
+    // Samples the activation ranges are calibrated on
+    int calibration_samples = 1000;
+};
+
+/// @brief Looks up a quantization scheme by its config name: per_layer or
+///        per_channel. Throws runtime_error for unknown names.
+/// @param name name of the scheme
+/// @return the scheme
+QuantizationScheme ParseQuantizationScheme(const std::string& name);
+
+/// @brief Config name of a quantization scheme, e.g. "per_channel"
+const char* QuantizationSchemeName(const QuantizationScheme& scheme);
+
+/// @brief Read-only view of one quantized layer. Points into the storage of
+///        its QuantizedNetwork.
+template<typename T>
+struct QuantizedLayer {
+    // Weight matrix of num_neurons rows by num_inputs columns
+    const int8_t* weights = nullptr;
+    // Value of one unit of each neuron's int32 weighted sum, the scale of
+    // its weights times the scale of the input
+    const T* output_scales = nullptr;
+    // One bias per neuron
+    const T* biases = nullptr;
+    // Reciprocal of the value of one step of the quantized input
+    T input_inv_scale = T(1);
+    int num_inputs = 0;
+    int num_neurons = 0;
+    ActivationFunction<T> activation = Sigmoid<T>;
+};
+
+/// @brief Read-only int8 copy of a CompiledNetwork for inference, using a
+///        quarter (float) or an eighth (double) of the weight memory. Any
+///        number of threads can run predictions against one
+///        QuantizedNetwork, each through its own QuantizedSession.
+///        Example usage:
+///
+///    const QuantizedNetwork<float> quantized(compiled, samples, count,
+///                                            QuantizationScheme::kPerChannel);
+///    QuantizedSession<float> session(quantized);
+///    session.Predict(input, output);
+template<typename T>
+class QuantizedNetwork {
+private:
+    // Layers in order, pointing into the storage below
+    std::vector<QuantizedLayer<T>> layers;
+    // Quantized weights of every layer, each block aligned to a cache line
+    AlignedVector<int8_t> weight_storage;
+    // Output scales and biases of every layer
+    AlignedVector<T> scale_storage;
+
+    int num_inputs_ = 0;
+    int num_outputs_ = 0;
+    // Largest number of inputs or neurons in any layer, sizes the session
+    // buffers
+    int max_layer_size = 0;
+
+public:
+    /// @brief Constructor. Throws runtime_error if num_samples is not
+    ///        positive.
+    /// @param network network to quantize
+    /// @param calibration_inputs num_samples x num_inputs block of samples
+    ///                           representative of the inputs at inference,
+    ///                           used to find the range of every layer's input
+    /// @param num_samples number of calibration samples
+    /// @param scheme granularity of the weight scales
+    QuantizedNetwork(const CompiledNetwork<T>& network,
+                     const T* calibration_inputs, const int& num_samples,
+                     const QuantizationScheme& scheme);
+
+    // The layers point into this object's storage
+    QuantizedNetwork(const QuantizedNetwork&) = delete;
+    QuantizedNetwork& operator=(const QuantizedNetwork&) = delete;
+    QuantizedNetwork(QuantizedNetwork&&) = default;
+    QuantizedNetwork& operator=(QuantizedNetwork&&) = default;
+
+    /// @brief Layers of the network in order
+    const std::vector<QuantizedLayer<T>>& Layers() const { return layers; }
+
+    /// @brief Number of inputs to the network
+    int NumInputs() const { return num_inputs_; }
+
+    /// @brief Number of outputs of the network
+    int NumOutputs() const { return num_outputs_; }
+
+    /// @brief Largest number of inputs or neurons in any layer
+    int MaxLayerSize() const { return max_layer_size; }
+
+    /// @brief Bytes of int8 weights, excluding scales and biases
+    size_t WeightBytes() const;
+};
+
+/// @brief Scratch buffers for running predictions against a QuantizedNetwork.
+///        Every buffer is allocated by the constructor, so predicting does not
+///        allocate. A session must only be used by one thread at a time.
+template<typename T>
+class QuantizedSession {
+private:
+    // Network to predict with. Must outlive the session.
+    const QuantizedNetwork<T>& network_;
+    // Input of the current layer rounded to int8
+    AlignedVector<int8_t> quantized_input;
+    // Activations alternate between the two buffers layer by layer
+    AlignedVector<T> buffer_a;
+    AlignedVector<T> buffer_b;
+
+public:
+    /// @brief Constructor
+    /// @param network network to predict with
+    explicit QuantizedSession(const QuantizedNetwork<T>& network);
+
+    /// @brief Forwards pass over a single sample
+    /// @param input num_inputs values
+    /// @param output receives num_outputs values
+    void Predict(const T* input, T* output);
+
+    /// @brief Forwards pass over a batch of samples, one at a time
+    /// @param inputs batch_size x num_inputs row-major block of samples
+    /// @param batch_size number of samples
+    /// @param outputs receives the batch_size x num_outputs block of results
+    void PredictBatch(const T* inputs, const int& batch_size, T* outputs);
+};
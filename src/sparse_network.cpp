@@ -0,0 +1,235 @@
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+#include "sparse_network.h"
+#include "kernels/kernels.h"
+
+// =======================================
+// SparseNetwork
+// =======================================
+
+template<typename T>
+SparseNetwork<T>::SparseNetwork(const CompiledNetwork<T>& network,
+                                const double& max_gemv_density,
+                                const double& max_gemm_density) {
+    const std::vector<LayerView<T>>& views = network.Layers();
+
+    // Every block of values starts on a cache line
+    const size_t block = kCacheLineSize / sizeof(T);
+    auto block_size = [&](const size_t& count) {
+        return (count + block - 1) / block * block;
+    };
+
+    // Measure the density of every layer to size the storage
+    std::vector<size_t> nonzeros(views.size(), 0);
+    size_t total_values = 0;
+    size_t total_indices = 0;
+    for (size_t i = 0; i < views.size(); i++) {
+        const LayerView<T>& view = views[i];
+        const size_t count = static_cast<size_t>(view.num_neurons)
+                             * view.num_inputs;
+        for (size_t j = 0; j < count; j++) {
+            nonzeros[i] += view.weights[j] != T(0);
+        }
+        const bool sparse_gemv = nonzeros[i] <= max_gemv_density * count;
+        const bool sparse_gemm = nonzeros[i] <= max_gemm_density * count;
+        if (sparse_gemv || sparse_gemm) {
+            total_values += block_size(nonzeros[i]);
+            total_indices += nonzeros[i] + view.num_neurons + 1;
+        }
+        if (!sparse_gemv || !sparse_gemm) {
+            total_values += block_size(count);
+        }
+        total_values += block_size(view.num_neurons);
+    }
+    value_storage.assign(total_values, T(0));
+    index_storage.assign(total_indices, 0);
+
+    size_t value_offset = 0;
+    size_t index_offset = 0;
+    for (size_t i = 0; i < views.size(); i++) {
+        const LayerView<T>& view = views[i];
+        const size_t count = static_cast<size_t>(view.num_neurons)
+                             * view.num_inputs;
+
+        SparseLayer<T> layer;
+        layer.num_inputs = view.num_inputs;
+        layer.num_neurons = view.num_neurons;
+        layer.activation = view.activation;
+        layer.density = static_cast<double>(nonzeros[i]) / count;
+        layer.sparse_gemv = nonzeros[i] <= max_gemv_density * count;
+        layer.sparse_gemm = nonzeros[i] <= max_gemm_density * count;
+
+        if (layer.sparse_gemv || layer.sparse_gemm) {
+            T* values = value_storage.data() + value_offset;
+            value_offset += block_size(nonzeros[i]);
+            int* columns = index_storage.data() + index_offset;
+            index_offset += nonzeros[i];
+            int* row_offsets = index_storage.data() + index_offset;
+            index_offset += view.num_neurons + 1;
+
+            int k = 0;
+            for (int row = 0; row < view.num_neurons; row++) {
+                row_offsets[row] = k;
+                const T* weights = view.weights
+                                   + static_cast<size_t>(row)
+                                     * view.num_inputs;
+                for (int column = 0; column < view.num_inputs; column++) {
+                    if (weights[column] != T(0)) {
+                        values[k] = weights[column];
+                        columns[k] = column;
+                        k++;
+                    }
+                }
+            }
+            row_offsets[view.num_neurons] = k;
+
+            layer.values = values;
+            layer.columns = columns;
+            layer.row_offsets = row_offsets;
+        }
+        if (!layer.sparse_gemv || !layer.sparse_gemm) {
+            T* weights = value_storage.data() + value_offset;
+            std::copy(view.weights, view.weights + count, weights);
+            value_offset += block_size(count);
+            layer.weights = weights;
+        }
+
+        T* biases = value_storage.data() + value_offset;
+        std::copy(view.biases, view.biases + view.num_neurons, biases);
+        value_offset += block_size(view.num_neurons);
+        layer.biases = biases;
+
+        layers.push_back(layer);
+    }
+
+    num_inputs_ = network.NumInputs();
+    num_outputs_ = network.NumOutputs();
+    max_layer_size = std::max(network.MaxLayerSize(), num_inputs_);
+}
+
+template<typename T>
+size_t SparseNetwork<T>::WeightBytes() const {
+    size_t bytes = 0;
+    for (const SparseLayer<T>& layer : layers) {
+        if (layer.values) {
+            const size_t nonzeros = layer.row_offsets[layer.num_neurons];
+            bytes += nonzeros * (sizeof(T) + sizeof(int))
+                     + (layer.num_neurons + 1) * sizeof(int);
+        }
+        if (layer.weights) {
+            bytes += static_cast<size_t>(layer.num_neurons)
+                     * layer.num_inputs * sizeof(T);
+        }
+    }
+    return bytes;
+}
+
+// =======================================
+// SparseSession
+// =======================================
+
+template<typename T>
+SparseSession<T>::SparseSession(const SparseNetwork<T>& network,
+                                const int& max_batch_size) :
+                                network_(network),
+                                max_batch_size_(max_batch_size) {
+    if (max_batch_size <= 0) {
+        throw std::runtime_error("Invalid batch size in SparseSession. "
+                    "Batch size is " + std::to_string(max_batch_size));
+    }
+    const size_t size = static_cast<size_t>(max_batch_size)
+                        * network.MaxLayerSize();
+    buffer_a.resize(size);
+    buffer_b.resize(size);
+}
+
+template<typename T>
+void SparseSession<T>::Predict(const T* input, T* output) {
+    PredictBatch(input, 1, output);
+}
+
+template<typename T>
+void SparseSession<T>::PredictBatch(const T* inputs, const int& batch_size,
+                                    T* outputs) {
+    if (batch_size <= 0 || batch_size > max_batch_size_) {
+        throw std::runtime_error("Invalid batch size in SparseSession::"
+                    "PredictBatch. Batch size is " + std::to_string(batch_size)
+                    + ", maximum is " + std::to_string(max_batch_size_));
+    }
+
+    const std::vector<SparseLayer<T>>& layers = network_.Layers();
+    const size_t samples = static_cast<size_t>(batch_size);
+    // A single sample is laid out the same either way, otherwise switch to
+    // one row per feature
+    const T* next_input = inputs;
+    T* next_output = buffer_a.data();
+    if (batch_size > 1) {
+        kernels::TransposeMatrix(batch_size, network_.NumInputs(), inputs,
+                                 network_.NumInputs(), buffer_a.data(),
+                                 batch_size);
+        next_input = buffer_a.data();
+        next_output = buffer_b.data();
+    }
+
+    for (size_t i = 0; i < layers.size(); i++) {
+        const SparseLayer<T>& layer = layers[i];
+        // The last layer of a single sample writes straight into the caller's
+        // buffer
+        T* layer_output = batch_size == 1 && i + 1 == layers.size()
+                          ? outputs : next_output;
+
+        // Weighted sum of every neuron for every sample, starting from the
+        // bias
+        if (batch_size == 1) {
+            std::copy(layer.biases, layer.biases + layer.num_neurons,
+                      layer_output);
+        }
+        else {
+            for (int neuron = 0; neuron < layer.num_neurons; neuron++) {
+                T* row = layer_output + neuron * samples;
+                std::fill(row, row + samples, layer.biases[neuron]);
+            }
+        }
+        if (layer.sparse_gemv && batch_size == 1) {
+            kernels::SparseGemv(layer.num_neurons, layer.row_offsets,
+                                layer.columns, layer.values, next_input,
+                                layer_output);
+        }
+        else if (layer.sparse_gemm && batch_size > 1) {
+            kernels::SparseGemm(layer.num_neurons, batch_size,
+                                layer.row_offsets, layer.columns,
+                                layer.values, next_input, batch_size,
+                                layer_output, batch_size);
+        }
+        else if (batch_size == 1) {
+            kernels::Gemv(kernels::Transpose::kNo, layer.num_neurons,
+                          layer.num_inputs, T(1), layer.weights,
+                          layer.num_inputs, next_input, T(1), layer_output);
+        }
+        else {
+            kernels::Gemm(kernels::Transpose::kNo, kernels::Transpose::kNo,
+                          layer.num_neurons, batch_size, layer.num_inputs,
+                          T(1), layer.weights, layer.num_inputs, next_input,
+                          batch_size, T(1), layer_output, batch_size);
+        }
+        layer.activation.ForwardsBatch(layer_output, layer_output,
+                                       samples * layer.num_neurons);
+
+        next_input = layer_output;
+        next_output = next_output == buffer_a.data() ? buffer_b.data()
+                                                     : buffer_a.data();
+    }
+
+    if (batch_size > 1) {
+        kernels::TransposeMatrix(network_.NumOutputs(), batch_size,
+                                 next_input, batch_size, outputs,
+                                 network_.NumOutputs());
+    }
+}
+
+template class SparseNetwork<float>;
+template class SparseNetwork<double>;
+template class SparseSession<float>;
+template class SparseSession<double>;
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <vector>
+
+#include "inference.h"
+#include "aligned_allocator.h"
+
+/*
+    Sparse inference for pruned networks. The density of every layer, the
+    fraction of its weights that are nonzero, is measured when the network is
+    built. Single samples and batches each have their own density cutoff, as
+    the sparse kernels overtake the dense ones at different densities. A
+    layer at or below a cutoff runs that case with the sparse kernels from a
+    compressed sparse row copy of its weights, and above it with the dense
+    kernels from a dense copy. Layers between the two cutoffs keep both.
+*/
+
+// Default density cutoffs. Measured on the 100 x 784 MNIST layer with AVX2,
+// the sparse matrix-vector product overtakes the dense one below about 15%
+// density in float and 30% in double, and the sparse matrix product below
+// about 40%.
+constexpr double kDefaultMaxSparseGemvDensity = 0.15;
+constexpr double kDefaultMaxSparseGemmDensity = 0.40;
+
+/// @brief Read-only view of one layer of a SparseNetwork. Points into the
+///        storage of its network.
+template<typename T>
+struct SparseLayer {
+    // Compressed sparse row weights if either case is sparse, see kernels.h:
+    // the nonzero values of each row, their columns, and the num_neurons + 1
+    // offsets of each row's first nonzero
+    const T* values = nullptr;
+    const int* columns = nullptr;
+    const int* row_offsets = nullptr;
+    // Dense weight matrix of num_neurons rows by num_inputs columns if either
+    // case is dense
+    const T* weights = nullptr;
+    // One bias per neuron
+    const T* biases = nullptr;
+    int num_inputs = 0;
+    int num_neurons = 0;
+    // Fraction of the weights that are nonzero
+    double density = 1.0;
+    // Whether single samples and batches run with the sparse kernels
+    bool sparse_gemv = false;
+    bool sparse_gemm = false;
+    ActivationFunction<T> activation = Sigmoid<T>;
+};
+
+/// @brief Read-only copy of a CompiledNetwork for inference, storing each
+///        sparse enough layer in compressed sparse row form. Any number of
+///        threads can run predictions against one SparseNetwork, each through
+///        its own SparseSession. Example usage:
+///
+///    const SparseNetwork<float> sparse(compiled);
+///    SparseSession<float> session(sparse);
+///    session.Predict(input, output);
+template<typename T>
+class SparseNetwork {
+private:
+    // Layers in order, pointing into the storage below
+    std::vector<SparseLayer<T>> layers;
+    // Nonzero values of the sparse layers, weights of the dense layers and
+    // biases of every layer, each block aligned to a cache line
+    AlignedVector<T> value_storage;
+    // Columns and row offsets of the sparse layers
+    std::vector<int> index_storage;
+
+    int num_inputs_ = 0;
+    int num_outputs_ = 0;
+    // Largest number of inputs or neurons in any layer, sizes the session
+    // buffers
+    int max_layer_size = 0;
+
+public:
+    /// @brief Constructor
+    /// @param network network to copy the weights and biases from
+    /// @param max_gemv_density layers with at most this fraction of nonzero
+    ///                         weights run single samples sparse
+    /// @param max_gemm_density layers with at most this fraction of nonzero
+    ///                         weights run batches sparse
+    explicit SparseNetwork(const CompiledNetwork<T>& network,
+                           const double& max_gemv_density =
+                                            kDefaultMaxSparseGemvDensity,
+                           const double& max_gemm_density =
+                                            kDefaultMaxSparseGemmDensity);
+
+    // The layers point into this object's storage
+    SparseNetwork(const SparseNetwork&) = delete;
+    SparseNetwork& operator=(const SparseNetwork&) = delete;
+    SparseNetwork(SparseNetwork&&) = default;
+    SparseNetwork& operator=(SparseNetwork&&) = default;
+
+    /// @brief Layers of the network in order
+    const std::vector<SparseLayer<T>>& Layers() const { return layers; }
+
+    /// @brief Number of inputs to the network
+    int NumInputs() const { return num_inputs_; }
+
+    /// @brief Number of outputs of the network
+    int NumOutputs() const { return num_outputs_; }
+
+    /// @brief Largest number of inputs or neurons in any layer
+    int MaxLayerSize() const { return max_layer_size; }
+
+    /// @brief Bytes of weights, including the column indices and row offsets
+    ///        of the sparse copies but excluding biases
+    size_t WeightBytes() const;
+};
+
+/// @brief Scratch buffers for running predictions against a SparseNetwork.
+///        Every buffer is allocated by the constructor, so predicting does not
+///        allocate. A session must only be used by one thread at a time.
+template<typename T>
+class SparseSession {
+private:
+    // Network to predict with. Must outlive the session.
+    const SparseNetwork<T>& network_;
+    // Largest batch passed to PredictBatch
+    int max_batch_size_ = 0;
+
+    // Activations alternate between the two buffers layer by layer, each
+    // max_layer_size x max_batch_size. Batches are held with one row per
+    // feature and one column per sample, so that the sparse kernels read
+    // contiguous rows.
+    AlignedVector<T> buffer_a;
+    AlignedVector<T> buffer_b;
+
+public:
+    /// @brief Constructor
+    /// @param network network to predict with
+    /// @param max_batch_size largest batch passed to PredictBatch
+    explicit SparseSession(const SparseNetwork<T>& network,
+                           const int& max_batch_size = 1);
+
+    /// @brief Forwards pass over a single sample
+    /// @param input num_inputs values
+    /// @param output receives num_outputs values
+    void Predict(const T* input, T* output);
+
+    /// @brief Forwards pass over a batch of samples
+    /// @param inputs batch_size x num_inputs row-major block of samples
+    /// @param batch_size number of samples, at most max_batch_size
+    /// @param outputs receives the batch_size x num_outputs block of results
+    void PredictBatch(const T* inputs, const int& batch_size, T* outputs);
+
+    /// @brief Largest batch passed to PredictBatch
+    int MaxBatchSize() const { return max_batch_size_; }
+};
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+#include "aligned_allocator.h"
+
+/// @brief Bounded lock-free queue between exactly one producer thread and one
+///        consumer thread. Items are copied into a fixed ring allocated by
+///        the constructor, so pushing and popping never allocate or block.
+///        Everything the producer wrote before a push is visible to the
+///        consumer once it pops that item.
+///        Example usage:
+///
+///    SpscQueue<int> queue(4);
+///    // Producer
+///    while (!queue.TryPush(item)) {}
+///    // Consumer
+///    int item;
+///    if (queue.TryPop(item)) { ... }
+template<typename T>
+class SpscQueue {
+private:
+    std::vector<T> ring;
+    // Number of items ever popped, only written by the consumer
+    alignas(kCacheLineSize) std::atomic<size_t> head{0};
+    // Number of items ever pushed, only written by the producer
+    alignas(kCacheLineSize) std::atomic<size_t> tail{0};
+
+public:
+    /// @brief Constructor
+    /// @param capacity largest number of items held at once, at least one
+    explicit SpscQueue(const size_t& capacity) :
+                       ring(capacity > 0 ? capacity : 1) {
+    }
+
+    // Producer and consumer hold on to the queue's address
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    /// @brief Appends an item unless the queue is full. Producer only.
+    /// @param item item to copy into the queue
+    /// @return whether the item was pushed
+    bool TryPush(const T& item) {
+        const size_t current_tail = tail.load(std::memory_order_relaxed);
+        if (current_tail - head.load(std::memory_order_acquire)
+            >= ring.size()) {
+            return false;
+        }
+        ring[current_tail % ring.size()] = item;
+        tail.store(current_tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    /// @brief Removes the oldest item unless the queue is empty. Consumer
+    ///        only.
+    /// @param item receives the item
+    /// @return whether an item was popped
+    bool TryPop(T& item) {
+        const size_t current_head = head.load(std::memory_order_relaxed);
+        if (current_head == tail.load(std::memory_order_acquire)) {
+            return false;
+        }
+        item = ring[current_head % ring.size()];
+        head.store(current_head + 1, std::memory_order_release);
+        return true;
+    }
+
+    /// @brief Largest number of items held at once
+    size_t Capacity() const { return ring.size(); }
+};
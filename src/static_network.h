@@ -0,0 +1,260 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "neural_network.h"
+#include "model_file.h"
+
+/// @brief A fully connected layer of a StaticNetwork
+/// @tparam Neurons number of neurons in the layer
+/// @tparam Activation activation function of every neuron in the layer
+template<int Neurons, ActivationType Activation>
+struct Dense {
+    static_assert(Neurons > 0, "A layer needs at least one neuron");
+    static constexpr int kNeurons = Neurons;
+    static constexpr ActivationType kActivation = Activation;
+};
+
+/// @brief Weights and biases of one layer of a StaticNetwork, laid out like a
+///        Layer: a row-major weight matrix of Neurons rows by Inputs columns
+///        and one bias per neuron.
+/// @tparam T float or double
+/// @tparam Inputs number of inputs to the layer
+/// @tparam LayerType Dense layer description
+template<typename T, int Inputs, typename LayerType>
+struct StaticLayer {
+    static constexpr int kInputs = Inputs;
+    static constexpr int kNeurons = LayerType::kNeurons;
+    static constexpr ActivationType kActivation = LayerType::kActivation;
+
+    alignas(64) std::array<T, kNeurons * kInputs> weights {};
+    alignas(64) std::array<T, kNeurons> biases {};
+
+    /// @brief Activation function, resolved at compile time so it is inlined
+    ///        into the forwards pass. Always uses the exact exponential.
+    static T Activate(const T& x) {
+        if constexpr (kActivation == ActivationType::kSigmoid) {
+            return T(1) / (T(1) + std::exp(-x));
+        }
+        else if constexpr (kActivation == ActivationType::kTanh) {
+            return std::tanh(x);
+        }
+        else if constexpr (kActivation == ActivationType::kRelu) {
+            return x > 0 ? x : T(0);
+        }
+        else {
+            static_assert(kActivation == ActivationType::kIdentity,
+                          "Unsupported activation type");
+            return x;
+        }
+    }
+
+    /// @brief Forwards pass over a single sample. Every loop bound is a
+    ///        compile time constant, so small layers are fully unrolled.
+    /// @param input kInputs values
+    /// @param output receives kNeurons values
+    void Forwards(const T* input, T* output) const {
+        for (int n = 0; n < kNeurons; n++) {
+            const T* row = weights.data() + n * kInputs;
+            T sum = biases[n];
+            for (int i = 0; i < kInputs; i++) {
+                sum += row[i] * input[i];
+            }
+            output[n] = sum;
+        }
+        // Kept apart from the weighted sums so that loop vectorises
+        for (int n = 0; n < kNeurons; n++) {
+            output[n] = Activate(output[n]);
+        }
+    }
+
+    /// @brief Read-only view of this layer, for exporting its weights
+    LayerView<T> View() const {
+        LayerView<T> view;
+        view.weights = weights.data();
+        view.biases = biases.data();
+        view.num_inputs = kInputs;
+        view.num_neurons = kNeurons;
+        view.activation = GetActivation<T>(kActivation);
+        return view;
+    }
+
+    /// @brief Copies the weights and biases of a layer of the same shape and
+    ///        activation function. Throws runtime_error if they differ.
+    /// @param view layer to copy from
+    void LoadWeights(const LayerView<T>& view) {
+        if (view.num_inputs != kInputs || view.num_neurons != kNeurons) {
+            throw std::runtime_error("Cannot load a layer of "
+                        + std::to_string(view.num_inputs) + " inputs x "
+                        + std::to_string(view.num_neurons) + " neurons into a "
+                        + "static layer of " + std::to_string(kInputs)
+                        + " inputs x " + std::to_string(kNeurons)
+                        + " neurons");
+        }
+        if (view.activation.type != kActivation) {
+            throw std::runtime_error("Cannot load a layer with activation "
+                        "type " + std::to_string(static_cast<uint32_t>(
+                                                    view.activation.type))
+                        + " into a static layer with activation type "
+                        + std::to_string(static_cast<uint32_t>(kActivation)));
+        }
+        std::copy(view.weights, view.weights + weights.size(),
+                  weights.begin());
+        std::copy(view.biases, view.biases + biases.size(), biases.begin());
+    }
+};
+
+/// @brief Chain of StaticLayers, each taking the outputs of the one before.
+///        Implementation detail of StaticNetwork.
+template<typename T, int Inputs, typename... LayerTypes>
+struct StaticLayerChain;
+
+template<typename T, int Inputs, typename LayerType, typename... Rest>
+struct StaticLayerChain<T, Inputs, LayerType, Rest...> {
+    using First = StaticLayer<T, Inputs, LayerType>;
+    using Next = StaticLayerChain<T, LayerType::kNeurons, Rest...>;
+
+    static constexpr int kNumLayers = 1 + sizeof...(Rest);
+    static constexpr int kOutputs = Next::kOutputs;
+
+    First layer;
+    Next rest;
+
+    /// @brief Forwards pass, alternating between two scratch buffers
+    ///        layer by layer
+    void Forwards(const T* input, T* output, T* buffer_a, T* buffer_b) const {
+        if constexpr (sizeof...(Rest) == 0) {
+            layer.Forwards(input, output);
+        }
+        else {
+            layer.Forwards(input, buffer_a);
+            rest.Forwards(buffer_a, output, buffer_b, buffer_a);
+        }
+    }
+
+    void AppendViews(std::vector<LayerView<T>>& views) const {
+        views.push_back(layer.View());
+        rest.AppendViews(views);
+    }
+
+    void LoadWeights(const LayerView<T>* views) {
+        layer.LoadWeights(views[0]);
+        rest.LoadWeights(views + 1);
+    }
+};
+
+template<typename T, int Inputs>
+struct StaticLayerChain<T, Inputs> {
+    static constexpr int kNumLayers = 0;
+    static constexpr int kOutputs = Inputs;
+
+    void AppendViews(std::vector<LayerView<T>>&) const {}
+    void LoadWeights(const LayerView<T>*) {}
+};
+
+/// @brief Fully connected network with its topology fixed at compile time.
+///        Layer sizes are constants and the weights live in std::arrays
+///        inside the object, so the compiler can unroll and vectorise the
+///        small layers of the tank model and inline the activation
+///        functions. Inference only: train a NeuralNetwork of the same
+///        topology and copy its weights across with LoadWeights, or copy
+///        these weights back with NeuralNetwork::LoadWeights(Views()).
+///        Large networks should be allocated on the heap, as the object holds
+///        every weight.
+///        Example usage:
+///
+///    StaticNetwork<float, 5, Dense<16, ActivationType::kSigmoid>,
+///                  Dense<1, ActivationType::kSigmoid>> tank_network;
+///    tank_network.LoadWeights(trained_network);
+///    tank_network.Predict(input, output);
+/// @tparam T float or double
+/// @tparam Inputs number of inputs to the network
+/// @tparam LayerTypes Dense layer descriptions in order, the last being the
+///                    output layer
+template<typename T, int Inputs, typename... LayerTypes>
+class StaticNetwork {
+    static_assert(Inputs > 0, "A network needs at least one input");
+    static_assert(sizeof...(LayerTypes) > 0,
+                  "A network needs at least one layer");
+
+private:
+    using Chain = StaticLayerChain<T, Inputs, LayerTypes...>;
+
+    Chain chain;
+
+public:
+    static constexpr int kInputs = Inputs;
+    static constexpr int kOutputs = Chain::kOutputs;
+    static constexpr int kNumLayers = Chain::kNumLayers;
+    /// @brief Largest number of neurons in any layer
+    static constexpr int kMaxLayerSize = std::max({LayerTypes::kNeurons...});
+
+    /// @brief Forwards pass over a single sample. Does not allocate, and is
+    ///        safe to call from any number of threads at once.
+    /// @param input kInputs values
+    /// @param output receives kOutputs values
+    void Predict(const T* input, T* output) const {
+        std::array<T, kMaxLayerSize> buffer_a;
+        std::array<T, kMaxLayerSize> buffer_b;
+        chain.Forwards(input, output, buffer_a.data(), buffer_b.data());
+    }
+
+    /// @brief Forwards pass over a batch of samples, one at a time
+    /// @param inputs batch_size x kInputs row-major block of samples
+    /// @param batch_size number of samples
+    /// @param outputs receives the batch_size x kOutputs block of results
+    void PredictBatch(const T* inputs, const int& batch_size,
+                      T* outputs) const {
+        for (int sample = 0; sample < batch_size; sample++) {
+            Predict(inputs + static_cast<size_t>(sample) * kInputs,
+                    outputs + static_cast<size_t>(sample) * kOutputs);
+        }
+    }
+
+    /// @brief Read-only views of the layers in order, for exporting the
+    ///        weights to a NeuralNetwork or a model file. Valid while this
+    ///        network is alive.
+    std::vector<LayerView<T>> Views() const {
+        std::vector<LayerView<T>> views;
+        views.reserve(kNumLayers);
+        chain.AppendViews(views);
+        return views;
+    }
+
+    /// @brief Copies the weights and biases of a network of the same topology.
+    ///        Throws runtime_error if the number of layers, their shapes or
+    ///        their activation functions differ.
+    /// @param views layers to copy from, in order
+    void LoadWeights(const std::vector<LayerView<T>>& views) {
+        if (views.size() != static_cast<size_t>(kNumLayers)) {
+            throw std::runtime_error("Cannot load weights of "
+                        + std::to_string(views.size()) + " layers into a "
+                        + "static network of " + std::to_string(kNumLayers)
+                        + " layers");
+        }
+        chain.LoadWeights(views.data());
+    }
+
+    /// @brief Copies the weights and biases of a trained NeuralNetwork of the
+    ///        same topology. Throws runtime_error if the topology differs.
+    /// @param network network to copy from
+    void LoadWeights(const NeuralNetwork<T>& network) {
+        std::vector<LayerView<T>> views;
+        for (const Layer<T>& layer : network.Layers()) {
+            views.push_back(layer.View());
+        }
+        LoadWeights(views);
+    }
+
+    /// @brief Saves this network to a binary model file, see model_file.h.
+    ///        Throws runtime_error if the file cannot be written.
+    /// @param path file to write
+    void Save(const std::string& path) const {
+        SaveModelFile(path, Views());
+    }
+};
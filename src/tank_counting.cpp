@@ -1,50 +1,128 @@
 #include <random>
 #include <algorithm>
+#include <stdexcept>
+#include <string>
 #include <vector>
 
-auto random_source = std::mt19937{std::random_device{}()};
+#include "tank_counting.h"
+#include "metrics.h"
 
-struct TankPopulationExercise {
-    const int true_population;
-    const std::vector<int> population_peeks;
-};
+// Each thread has its own source, so the free functions below are safe to
+// call from several threads at once. Seeded from the system, so unlike a
+// TankExerciseGenerator these are not reproducible.
+thread_local CounterRng random_source{
+            (static_cast<uint64_t>(std::random_device{}()) << 32)
+            | std::random_device{}(),
+            RandomStream(RandomDomain::kTankExercises, 0)};
 
-std::vector<int> GenerateRandomTankPopulation(const int& min, const int& max) {
-    // Decide the total number of tanks
+namespace {
+
+// Throws unless every population in min - max has at least number_of_peeks
+// distinct serials to draw, which DrawTankPeeks relies on
+void CheckTankExercise(const int& min_population, const int& max_population,
+                       const int& number_of_peeks) {
+    if (number_of_peeks <= 0 || min_population < number_of_peeks
+        || max_population < min_population) {
+        throw std::runtime_error("Invalid tank exercise. Population "
+                    + std::to_string(min_population) + " - "
+                    + std::to_string(max_population) + " with "
+                    + std::to_string(number_of_peeks) + " peeks");
+    }
+}
+
+// Draws a population size between min and max, and number_of_peeks distinct
+// serial numbers from 1 to the population size in random order
+int DrawTankPeeks(CounterRng& source, const int& min, const int& max,
+                  const int& number_of_peeks, int* peeks) {
     std::uniform_int_distribution<> dist(min, max);
-    const int population_count = dist(random_source);
+    const int population_count = dist(source);
+
+    // Floyd's algorithm: for each j in the last number_of_peeks serials, pick
+    // a serial from 1 to j, taking j itself if the pick was already taken.
+    // Every subset is equally likely. The peeks are few, so a linear search
+    // is cheaper than a hash set.
+    int taken = 0;
+    for (int j = population_count - number_of_peeks + 1;
+         j <= population_count; j++) {
+        const int pick = std::uniform_int_distribution<>(1, j)(source);
+        const bool seen = std::find(peeks, peeks + taken, pick)
+                          != peeks + taken;
+        peeks[taken++] = seen ? j : pick;
+    }
+
+    // Floyd's algorithm favours j late in the order, shuffle the peeks so
+    // their order carries no information
+    std::shuffle(peeks, peeks + number_of_peeks, source);
+
+    return population_count;
+}
+
+}  // namespace
 
-    // Create the population with serially increasing assigned numbers
-    // TODO: Extension - what if some tanks get destroyed early?
-    // TODO: Extension - what if the serial number doesn't start at zero?
-    // TODO: Extension - what if the serial numbers are encoded? With a private
-    //                   key?
+// =======================================
+// TankExerciseGenerator
+// =======================================
 
-    std::vector<int> tank_population(population_count);
-    std::iota(tank_population.begin(), tank_population.end(), 1);
+TankExerciseGenerator::TankExerciseGenerator(const int& min_population,
+                                             const int& max_population,
+                                             const int& number_of_peeks,
+                                             const uint64_t& seed,
+                                             const uint64_t& stream) :
+                                             random_source(seed,
+                                                RandomStream(
+                                                RandomDomain::kTankExercises,
+                                                stream)),
+                                             min_population(min_population),
+                                             max_population(max_population),
+                                             number_of_peeks(number_of_peeks),
+                                             scratch_peeks(number_of_peeks) {
+    CheckTankExercise(min_population, max_population, number_of_peeks);
+}
 
-    // Pre-shuffle the population
-    std::shuffle(tank_population.begin(), tank_population.end(), random_source);
+int TankExerciseGenerator::Generate(int* peeks) {
+    return DrawTankPeeks(random_source, min_population, max_population,
+                         number_of_peeks, peeks);
+}
 
-    return tank_population;
+TankPopulationExercise TankExerciseGenerator::CreateExercise() {
+    std::vector<int> peeks(number_of_peeks);
+    const int population = Generate(peeks.data());
+    return {population, peeks};
 }
 
-std::vector<int> PeekTankSerialNumbers(const std::vector<int>& tank_population,
-                                       const int& number_of_peeks) { 
-    return std::vector<int>(tank_population.begin(),
-                            tank_population.begin() + number_of_peeks);
+template<typename T>
+void TankExerciseGenerator::FillBatch(const int& count, T* inputs,
+                                      T* targets) {
+    METRICS_SCOPE(metrics::Counter::kBatchAssembly);
+    for (int j = 0; j < count; j++) {
+        const int population = Generate(scratch_peeks.data());
+
+        // Convert population peeks from ints to a percentage of the max pop
+        T* sample = inputs + static_cast<size_t>(j) * number_of_peeks;
+        for (int k = 0; k < number_of_peeks; k++) {
+            sample[k] = static_cast<T>(scratch_peeks[k]) / max_population;
+        }
+
+        // Same for population count
+        targets[j] = static_cast<T>(population) / max_population;
+    }
 }
 
+// =======================================
+// Free Functions
+// =======================================
+
 TankPopulationExercise CreateTankPopulationExercise(const int& min_population,
                                                     const int& max_population,
                                                     const int& number_of_peeks) {
-    auto tank_population = GenerateRandomTankPopulation(min_population,
-                                                        max_population);
-    auto population_peeks = PeekTankSerialNumbers(tank_population,
-                                                  number_of_peeks);
+    CheckTankExercise(min_population, max_population, number_of_peeks);
+
+    std::vector<int> population_peeks(number_of_peeks);
+    const int population_count = DrawTankPeeks(random_source, min_population,
+                                               max_population, number_of_peeks,
+                                               population_peeks.data());
 
-    TankPopulationExercise x = {static_cast<int>(tank_population.size()),
-                                population_peeks};
+    TankPopulationExercise x = {population_count, population_peeks};
 
     return x;
 }
@@ -57,4 +135,9 @@ int FrequentistPrediction(const std::vector<int> tank_population) {
     const int k = static_cast<int>(tank_population.size());
     
     return m + m / k - 1;
-}
\ No newline at end of file
+}
+
+template void TankExerciseGenerator::FillBatch<float>(const int&, float*,
+                                                      float*);
+template void TankExerciseGenerator::FillBatch<double>(const int&, double*,
+                                                       double*);
\ No newline at end of file
@@ -1,7 +1,11 @@
-#include <random>
+#pragma once
+
 #include <algorithm>
+#include <cstdint>
 #include <vector>
 
+#include "counter_rng.h"
+
 /// @brief Stores a number of observations of the serial number population 
 ///        (population_peeks) and the true population count (true_population).
 ///        Does not store all serial numbers.
@@ -10,26 +14,66 @@ struct TankPopulationExercise {
     const std::vector<int> population_peeks;
 };
 
-/// @brief Returns a shuffled list of serial numbers starting from one and
-///        linearly increasing to a random number between min and max.
-/// @param min the lowest population size
-/// @param max the highest population size
-/// @return shuffled serial number population
-std::vector<int> GenerateRandomTankPopulation(const int& min, const int& max);
-
-/// @brief Return the first x elements of the population, where x is the number 
-///        of peeks requested. Will not return duplicate peeks of the same
-///        serial number. Assumed population is pre-shuffled.
-/// @param tank_population a pre-shuffled population of tank serial numbers
-/// @param number_of_peeks number of peeks to perform
-/// @return a vector of integers representing the serial numbers peeked
-std::vector<int> PeekTankSerialNumbers(const std::vector<int>& tank_population,
-                                       const int& number_of_peeks);
-
-/// @brief Generates a set of observations for a set of serial numbers.
+/// @brief Generates German tank problem exercises without materialising the
+///        serial number population. Each of the number_of_peeks distinct
+///        serials is drawn with Floyd's algorithm, so an exercise costs
+///        number_of_peeks random draws however large the population. Every
+///        generator owns its random number stream; give each thread its own
+///        generator with a different stream number.
+///        Example usage:
+///
+///    TankExerciseGenerator generator(100, 1000, 5, seed, thread_idx);
+///    generator.FillBatch(mini_batch_size, inputs, targets);
+class TankExerciseGenerator {
+private:
+    CounterRng random_source;
+    int min_population = 0;
+    int max_population = 0;
+    int number_of_peeks = 0;
+    // Serials of the exercise being converted by FillBatch
+    std::vector<int> scratch_peeks;
+
+public:
+    /// @brief Constructor
+    /// @param min_population the lowest population size
+    /// @param max_population the highest population size
+    /// @param number_of_peeks number of observations per exercise, at most
+    ///                        min_population
+    /// @param seed seed shared by every stream
+    /// @param stream index of this generator's random number stream
+    TankExerciseGenerator(const int& min_population,
+                          const int& max_population,
+                          const int& number_of_peeks, const uint64_t& seed,
+                          const uint64_t& stream = 0);
+
+    /// @brief Draws a population size and number_of_peeks distinct serial
+    ///        numbers from it, in random order
+    /// @param peeks receives number_of_peeks serial numbers
+    /// @return true population size
+    int Generate(int* peeks);
+
+    /// @brief Generates a set of observations for a set of serial numbers
+    /// @return struct containing the set of observations and true population
+    ///         size
+    TankPopulationExercise CreateExercise();
+
+    /// @brief Generates a batch of exercises as network inputs and targets,
+    ///        each normalised to a fraction of max_population
+    /// @tparam T float or double
+    /// @param count number of exercises
+    /// @param inputs receives the count x number_of_peeks block of serials
+    /// @param targets receives the count true population sizes
+    template<typename T>
+    void FillBatch(const int& count, T* inputs, T* targets);
+};
+
+/// @brief Generates a set of observations for a set of serial numbers. Uses a
+///        random number stream private to the calling thread, seeded from
+///        std::random_device, so the exercises are not reproducible.
 /// @param min_population the lowest population size
 /// @param max_population the highest population size
-/// @param number_of_peeks number of observations to generate
+/// @param number_of_peeks number of observations to generate, at most
+///                        min_population
 /// @return struct containing the set of observations and true population size
 TankPopulationExercise CreateTankPopulationExercise(const int& min_population,
                                                     const int& max_population,
@@ -0,0 +1,77 @@
+#include "thread_pool.h"
+
+ThreadPool::ThreadPool(const int& num_threads) {
+    for (int i = 1; i < num_threads; i++) {
+        workers.emplace_back(&ThreadPool::WorkerLoop, this);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    job_ready.notify_all();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+void ThreadPool::Run(const Job& new_job) {
+    if (new_job.count <= 0) {
+        return;
+    }
+
+    next_index.store(0, std::memory_order_relaxed);
+    if (workers.empty() || new_job.count == 1) {
+        RunIndices(new_job);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        job = new_job;
+        active_workers = static_cast<int>(workers.size());
+        generation++;
+    }
+    job_ready.notify_all();
+
+    RunIndices(new_job);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    job_done.wait(lock, [this] { return active_workers == 0; });
+}
+
+void ThreadPool::RunIndices(const Job& current) {
+    for (int index = next_index.fetch_add(1, std::memory_order_relaxed);
+         index < current.count;
+         index = next_index.fetch_add(1, std::memory_order_relaxed)) {
+        current.invoke(current.context, index);
+    }
+}
+
+void ThreadPool::WorkerLoop() {
+    unsigned long seen_generation = 0;
+    while (true) {
+        Job current;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            job_ready.wait(lock, [&] {
+                return stopping || generation != seen_generation;
+            });
+            if (stopping) {
+                return;
+            }
+            seen_generation = generation;
+            current = job;
+        }
+
+        RunIndices(current);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            active_workers--;
+        }
+        job_done.notify_one();
+    }
+}
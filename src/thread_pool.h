@@ -0,0 +1,89 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+/// @brief Fixed set of worker threads for running data parallel loops. The
+///        calling thread takes part in every loop, so a pool of one thread
+///        starts no workers and runs everything inline. Running a loop does
+///        not allocate.
+///        Example usage:
+///
+///    ThreadPool pool(4);
+///    pool.ParallelFor(num_slices, [&](const int& slice) {
+///        ProcessSlice(slice);
+///    });
+class ThreadPool {
+private:
+    // Type erased loop body: invoke(context, index)
+    struct Job {
+        void (*invoke)(void*, const int&) = nullptr;
+        void* context = nullptr;
+        int count = 0;
+    };
+
+    std::vector<std::thread> workers;
+
+    std::mutex mutex;
+    std::condition_variable job_ready;
+    std::condition_variable job_done;
+    Job job;
+    // Incremented for each new loop so sleeping workers can tell it apart
+    // from the last one
+    unsigned long generation = 0;
+    // Workers still running the current loop
+    int active_workers = 0;
+    bool stopping = false;
+
+    // Next loop index to claim
+    std::atomic<int> next_index{0};
+
+    /// @brief Main loop of each worker thread
+    void WorkerLoop();
+
+    /// @brief Claims and runs loop indices until none remain
+    void RunIndices(const Job& current);
+
+    /// @brief Runs a type erased loop on every thread, returns when complete
+    void Run(const Job& new_job);
+
+    template<typename Task>
+    static void Invoke(void* context, const int& index) {
+        (*static_cast<Task*>(context))(index);
+    }
+
+public:
+    /// @brief Constructor
+    /// @param num_threads total threads running each loop, including the
+    ///                    calling thread. Values below one are treated as one.
+    explicit ThreadPool(const int& num_threads);
+
+    /// @brief Stops and joins every worker
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /// @brief Calls task(i) once for every i in [0, count), spread across the
+    ///        pool. Returns once every call has completed. Not reentrant.
+    /// @tparam Task callable taking the loop index
+    /// @param count number of loop indices
+    /// @param task loop body
+    template<typename Task>
+    void ParallelFor(const int& count, Task&& task) {
+        using TaskType = std::remove_reference_t<Task>;
+        Job new_job;
+        new_job.invoke = &Invoke<TaskType>;
+        new_job.context = const_cast<void*>(
+                            static_cast<const void*>(&task));
+        new_job.count = count;
+        Run(new_job);
+    }
+
+    /// @brief Total threads running each loop, including the calling thread
+    int NumThreads() const { return static_cast<int>(workers.size()) + 1; }
+};
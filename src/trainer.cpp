@@ -0,0 +1,27 @@
+#include <stdexcept>
+#include <string>
+
+#include "trainer.h"
+
+TrainerType ParseTrainerType(const std::string& name) {
+    if (name == "data_parallel") {
+        return TrainerType::kDataParallel;
+    }
+    if (name == "hogwild") {
+        return TrainerType::kHogwild;
+    }
+    if (name == "pipeline") {
+        return TrainerType::kPipeline;
+    }
+    throw std::runtime_error("Unknown trainer \"" + name + "\", expected "
+                             "data_parallel, hogwild or pipeline");
+}
+
+const char* TrainerName(const TrainerType& type) {
+    switch (type) {
+        case TrainerType::kDataParallel: return "data_parallel";
+        case TrainerType::kHogwild: return "hogwild";
+        case TrainerType::kPipeline: return "pipeline";
+    }
+    return "unknown";
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <string>
+
+/// @brief How a network is trained across threads
+enum class TrainerType {
+    // Each mini-batch is split across the threads and its summed gradient
+    // applied once, see DataParallelTrainer
+    kDataParallel,
+    // Each thread trains on its own samples and applies its own updates
+    // without locks or barriers, see HogwildTrainer
+    kHogwild,
+    // Each thread owns a group of layers, and micro-batches flow through
+    // the groups in turn, see PipelineTrainer
+    kPipeline,
+};
+
+/// @brief Looks up a trainer by its config name: data_parallel, hogwild or
+///        pipeline. Throws runtime_error for unknown names.
+/// @param name name of the trainer
+/// @return the trainer type
+TrainerType ParseTrainerType(const std::string& name);
+
+/// @brief Config name of a trainer, e.g. "hogwild"
+const char* TrainerName(const TrainerType& type);